@@ -0,0 +1,67 @@
+#ifndef EventBuilder_h
+#define EventBuilder_h
+
+#include <stdio.h>
+
+#include "TCutG.h"
+
+#include "SortingStructures.h"
+#include "INLCorrection.h"
+
+/* Builds events from the time-ordered GEB stream of unpackGRETINA.
+
+   Every GEB header read by the main loop is handed to Add(): its payload
+   is unpacked into the open event while it is less than the build window
+   (-ebWindow) after the first header of the event, otherwise the open
+   event is analysed and written (ProcessEvent()) and a new one starts with
+   it.  Headers without a timestamp are skipped.  Close() ends the last
+   event of a run.
+
+   With -ebLookBack the time ordering in front of the builder only holds
+   items for that many TS units: the in-process HFC pass is given the
+   look-back (OpenHFCStream()), and with -noHFC Open() puts such an HFC
+   stream between the plain input and the builder.
+
+   Over all runs the builder counts the built events and their TS span
+   (first to furthest header), printed by PrintStatistics() as the share
+   of the window in use. */
+
+class EventBuilder {
+public:
+    EventBuilder(controlVariables* ctrl, counterVariables* cnt, INLCorrection* inlCor,
+                 TCutG* incomingBeam, TCutG* outgoingBeam);
+
+    Int_t Open(FILE** inf);
+    void Add(FILE* inf, UShort_t junk[]);
+    Bool_t Close();
+
+    void PrintStatistics();
+
+    Int_t BuiltEvents() { return builtEvents; }
+    Int_t TSErrors() { return TSerrors; }
+
+private:
+    void EndEvent(Bool_t stopOnError);
+
+    controlVariables *ctrl;
+    counterVariables *cnt;
+    INLCorrection *inlCor;
+    TCutG *incomingBeam;
+    TCutG *outgoingBeam;
+
+    Long64_t window;
+    Long64_t lookBack;
+
+    /* The open event of this run */
+    long long int currTS;
+    long long int lastTS;
+    Int_t TSerrors;
+    Long64_t eventSpan;
+
+    /* Window occupancy over all runs */
+    Int_t builtEvents;
+    Long64_t spanSum;
+    Long64_t spanMax;
+};
+
+#endif // EventBuilder_h
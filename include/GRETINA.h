@@ -114,13 +114,40 @@ struct mode3DataPacket {
     unsigned short waveform[MAX_TRACE_LENGTH];
 };
 
+/* Lossless packing of a trace for the output tree.
+
+   Each sample is stored as its difference from the one before (the first
+   from 0), zigzag-mapped to an unsigned value (0, -1, 1, -2, ... ->
+   0, 1, 2, 3, ...), and the differences are bit-packed in blocks of 16
+   with one width byte per block: the bits needed by the largest value in
+   the block, 0 to 17.  The sample count goes first as a base-128
+   varint.  A block of a flat baseline with a few ADC of noise takes
+   4-5 bits a sample instead of 16; the rising edge only costs its own
+   block. */
+
+class g3TraceCodec {
+public:
+    static void Encode(const std::vector<Short_t> &raw, std::vector<UChar_t> &packed);
+    /* false if 'packed' is not a valid encoding; raw is then cleared */
+    static Bool_t Decode(const std::vector<UChar_t> &packed, std::vector<Short_t> &raw);
+};
+
+/* The tree stores raw as it is, so wf.raw can be drawn and read by any
+   tool, and packed stays empty.  With -packTraces, g3OUT::PackTraces()
+   moves raw into packed before each Fill(); a read rule
+   (LinkDefGRETINA.h) decodes packed back into raw when an entry is read
+   with this library, but TTree::Draw and readers without it only see
+   packed.  Version 2 trees always hold packed traces. */
+
 class g3Waveform : public TObject {
 public:
     std::vector<Short_t> raw;
+    std::vector<UChar_t> packed;
     std::vector<Float_t> pz;
 
 public:
     void Clear();
+    void Pack() { g3TraceCodec::Encode(raw, packed);  raw.clear(); }
     Int_t LEDLevel(Int_t index, Int_t thresh, Int_t filterK);
     Int_t LED(Int_t index, Int_t thresh, Int_t filterK);
     Float_t CFD(Int_t startSample);
@@ -142,7 +169,128 @@ public:
 			                 Int_t lengthBase, Int_t startIndexTop,
 			                 Int_t lengthTop, Float_t smallStep);
 
-    ClassDef(g3Waveform, 1);
+    ClassDef(g3Waveform, 3);
+};
+
+/* Timing of all the traces of a Mode3 record in one go.
+
+   Add() copies each trace to the end of one buffer; Run() then does the
+   CFD of g3Waveform::CFD() for all of them, and RunLED() the LED of
+   g3Waveform::LED(), one pass per trace (filters, CFD signal and maximum
+   together) with scratch sized to the longest trace.  The buffers are
+   kept from record to record, so once they have grown nothing is
+   allocated.
+
+   The results are those of the g3Waveform functions, which use the same
+   kernels: the same float operations in the same order, so the times
+   are identical, not just close. */
+
+class g3TimingBatch {
+public:
+    void Clear();
+    void Add(const std::vector<Short_t> &raw, Int_t tag);
+    void Run(Int_t startSample);
+    void RunLED(Int_t index, Int_t thresh, Int_t filterK);
+    Int_t size() { return (Int_t)start.size(); }
+
+    std::vector<Int_t> tag;     /* per trace, as given to Add() */
+    std::vector<Float_t> cfd;   /* per trace, after Run() */
+    std::vector<Int_t> led;     /* per trace, after RunLED() */
+
+private:
+    std::vector<Short_t> traces;
+    std::vector<Int_t> start, length;
+    std::vector<Short_t> scratch;
+};
+
+/* Fit of nStart*exp(-(i - startIndex)/tau) + baseline to the tail of a
+   trace, for a fixed tau.
+
+   With tau fixed the model is linear in nStart and the baseline, so the
+   least-squares minimum -- what the Levenberg-Marquardt loop that
+   g3Waveform::LSFitExpo() used to run converges to -- is one pass over
+   the samples (sums of y, y*exp and y*y) and a 2x2 solve.  What depends
+   only on tau and the number of points (the exp(-k/tau) table, the
+   inverse curvature matrix) is made once per (tau, nPoints) and kept, so
+   a fit makes no exp() calls.
+
+   Fit() fits one trace.  Add() and Run() fit a batch with the same tau and
+   nPoints, as g3TimingBatch does for timing; ScanTau() fits a list of
+   candidate taus and keeps the one with the smallest chi-square. */
+
+class g3TailFit {
+public:
+    g3TailFit() { batchPoints = 0; }
+
+    struct result {
+        Double_t nStart, baseline;
+        Double_t nStartError, baselineError;
+        Double_t chiSq;
+    };
+
+    /* y[0..nPoints-1] is the tail, y[0] at startIndex */
+    result Fit(const Short_t *y, Int_t nPoints, Double_t tau);
+    result ScanTau(const Short_t *y, Int_t nPoints, const std::vector<Double_t> &taus,
+                   Double_t &bestTau);
+
+    void Clear();
+    /* nPoints must be the same for all traces of a batch */
+    void Add(const std::vector<Short_t> &raw, Int_t startIndex, Int_t nPoints);
+    void Run(Double_t tau);
+    Int_t size() { return (Int_t)start.size(); }
+
+    std::vector<result> fit;    /* per trace, after Run() */
+
+private:
+    struct table {
+        Double_t tau;
+        Int_t n;
+        std::vector<Double_t> e;            /* exp(-k/tau), k < n */
+        Double_t inv00, inv01, inv11;       /* inverse curvature matrix */
+    };
+    const table& Table(Double_t tau, Int_t nPoints);
+    result Solve(const table &t, const Short_t *y);
+
+    std::vector<table> tables;
+    std::vector<Short_t> tails;
+    std::vector<Int_t> start;
+    Int_t batchPoints;
+};
+
+/* Cheap checks of a Mode3 trace, made in getMode3() (with -screen) as soon
+   as the trace is unpacked and before anything is done with it.  A trace
+   is flagged
+
+     TRUNCATED    if the record ends before the samples its header claims,
+     SATURATED    if at least railSamples samples are at |y| >= rail,
+     PILEUP_FPGA  if the digitizer set its pile-up bit,
+     PILEUP       if a second leading edge follows the first: the mean of
+                  the edgeGap samples from i + edgeGap less that of the
+                  edgeGap samples from i goes above edge, stays below
+                  edge/2 for edgeGap steps -- the first rise is over -- and
+                  goes above edge again.
+
+   Each check is one pass over the samples in integers, far less than
+   the CFD, and the pulses are taken to be positive-going, as
+   the segment traces are once their sign is flipped.  getMode3() does
+   not give flagged traces to the CFD (their calcTime is -10, as for a
+   trace where the CFD finds no crossing) nor to the superpulses; the
+   flags are kept in g3ChannelEvent::screen. */
+
+class g3TraceScreen {
+public:
+    g3TraceScreen() { rail = 8191;  railSamples = 3;  edge = 50;  edgeGap = 8; }
+
+    enum { TRUNCATED = 0x1, SATURATED = 0x2, PILEUP_FPGA = 0x4, PILEUP = 0x8 };
+
+    /* y[0..n-1] are the samples in the record, 'expected' the number the
+       header claims; returns the flags, 0 for a clean trace */
+    UChar_t Check(const Short_t *y, Int_t n, Int_t expected, Bool_t fpgaPileup);
+
+    Int_t rail;          /* ADC value of the digitizer rail */
+    Int_t railSamples;
+    Int_t edge;          /* ADC; 0 turns the second-edge search off */
+    Int_t edgeGap;       /* samples */
 };
 
 class g3ChannelEvent : public TObject {
@@ -162,6 +310,7 @@ public:
     long long int CFDtimestamp;
     Float_t baseline;
     Float_t riseTime;
+    UChar_t screen;      /* g3TraceScreen flags, 0 if clean or not screened */
     g3Waveform wf;
 
 public:
@@ -174,7 +323,7 @@ public:
     Int_t pileUp() { return ((hdr7 & 0x8000) >> 15); }
 
 public:
-    ClassDef(g3ChannelEvent, 3);
+    ClassDef(g3ChannelEvent, 4);
 };
 
 class g3CrystalEvent : public TObject {
@@ -234,6 +383,7 @@ public:
     void Reset();
     UInt_t crystalMult();
     Float_t calorimeterE();
+    void PackTraces();
 
 private:
     ClassDef(g3OUT, 1);
@@ -619,6 +769,20 @@ public:
     ClassDef(gHistos, 1);
 };
 
+/* The traces and the averaged traces of one crystal in a superpulse
+   analysis, about 1.6 MB.  SuperPulse::Crystal() makes one the first time
+   a crystal's traces are used, so only the crystals hit in a -superPulse
+   sort have them, and a sort without -superPulse has none. */
+
+class spCrystal {
+public:
+    spCrystal();
+
+    Int_t waves[40][2048];
+    Float_t averageTrace[40][4096];
+    Int_t averageTraceINT[40][4096];
+};
+
 /* \class SuperPulse
    \brief Class containing the parameters required to perform a superpulse
    analysis.
@@ -658,13 +822,21 @@ public:
     Int_t data4net[MAXCRYSTALS][36];
 
     Float_t gain[MAXCRYSTALS][40];
-    Int_t waves[MAXCRYSTALS][40][2048];
-    Float_t averageTrace[MAXCRYSTALS][40][4096];
-    Int_t averageTraceINT[MAXCRYSTALS][40][4096];
+    spCrystal *xtal[MAXCRYSTALS]; //! NULL until Crystal() makes it
 
 public:
-    SuperPulse() { ; }
-    ~SuperPulse() { ; }
+    SuperPulse() { for (Int_t i=0; i<MAXCRYSTALS; i++) { xtal[i] = NULL; } }
+    ~SuperPulse() { for (Int_t i=0; i<MAXCRYSTALS; i++) { delete xtal[i]; } }
+
+    spCrystal* Crystal(Int_t i) {
+      if (!xtal[i]) { xtal[i] = new spCrystal(); }
+      return xtal[i];
+    }
+    /*! \fn spCrystal* Crystal(Int_t i)
+        \brief The traces and averages of crystal i, made the first time they are asked for.
+        \param i Int_t crystal number, within the numbering scheme of the unpacking code.
+        \return spCrystal* -- never NULL.
+    */
 
     void Initialize(controlVariables* ctrl, GRETINAVariables* gVar);
     /*! \fn void Initialize(controlVariables* ctrl, GRETINAVariables* gVar)
@@ -759,7 +931,11 @@ public:
     */
 
 private:
-    ClassDef(SuperPulse, 1);
+    /* The crystals in xtal are owned, so not copied */
+    SuperPulse(const SuperPulse&);
+    SuperPulse& operator=(const SuperPulse&);
+
+    ClassDef(SuperPulse, 2);
 };
 
 
@@ -775,6 +951,8 @@ public:
     g2CrystalEvent g2X; g2IntPt pt;
     g3CrystalEvent g3X; g3ChannelEvent g3ch;
     std::vector<g3ChannelEvent> g3Temp;
+    g3TimingBatch timing; //! CFD of the traces in getMode3()
+    g3TraceScreen screen; //! with -screen, the checks of the traces in getMode3()
     historyEvent gH;
 
     unsigned char gBuf[32*32*1024];
@@ -72,6 +72,19 @@ public:
     std::vector<Double_t> waveE;
     std::vector<Double_t> waveCE;
 
+    /* GregorichTrapFilter() scratch, kept from call to call, and its
+       exp(n/tau) by channel id, made again when tau or the trace
+       length change */
+    std::vector<Double_t> trapScratch; //!
+    std::vector<Double_t> expcorr[MAXCHANNELS]; //!
+    Float_t expcorrTau[MAXCHANNELS]; //!
+
+    /* ANLEnergy2() decay exp(-(M+K)/tau) by channel id, and the tau and
+       M+K it was made for */
+    Double_t anlDecay[MAXCHANNELS]; //!
+    Float_t anlDecayTau[MAXCHANNELS]; //!
+    Int_t anlDecayMK[MAXCHANNELS]; //!
+
 public:
     GRETINAWF();
     ~GRETINAWF() { ; }
@@ -118,7 +131,51 @@ public:
     Int_t TimeSeg(Int_t len, Int_t cNum, Int_t chNum);
 
 private:
+    const Double_t* ExpCorrection(Int_t id);
+    Double_t ANLDecay(Int_t id);
+
     ClassDef(GRETINAWF, 1);
 };
 
+/* Trapezoid energy filter for many channels at once.
+
+   Load() puts the traces into one buffer sample by sample (all channels
+   of sample 0, then all of sample 1, ...) and Run() runs the recursive
+   trapezoid of Jordanov and Knoll, with pole-zero correction, down it:
+   constant work per sample and channel, and no dependence from one
+   channel to the next, so the channel loop can be vectorised.
+
+   The trapezoid differences and their running sum are integers, as in
+   the digitizer FPGA, and so exact; only the pole-zero term is floating
+   point, with its constant worked out per channel in Setup().  Samples
+   before the start of a trace are taken to equal the first one.
+
+   energy[ch] is the trapezoid at sample 'pick' (the FPGA samples the flat
+   top at a fixed delay), maximum[ch] its largest value; both have a gain
+   of 1 for a pulse decaying with the channel's tau.  goddessBench checks
+   energy[] against the trapezoid summed directly, to 1e-11. */
+
+class trapFilterBank {
+public:
+    trapFilterBank() { nCh = 0;  length = 0;  k = 0;  l = 0; }
+
+    /* rise, flat top, trace length and tau[ch] in samples */
+    void Setup(Int_t rise, Int_t flat, Int_t length, Int_t nChannels, const Float_t *tau);
+    /* A shorter trace is padded with its last sample */
+    void Load(Int_t ch, const std::vector<Short_t> &trace);
+    void Run(Int_t pick);
+
+    std::vector<Double_t> energy;
+    std::vector<Double_t> maximum;
+
+private:
+    Int_t nCh, length;
+    Int_t k, l;                    /* rise, rise + flat top */
+    std::vector<Int_t> x;          /* x[n*nCh + ch] */
+    std::vector<Double_t> mPZ;     /* 1/(exp(1/tau) - 1) */
+    std::vector<Double_t> gain;
+    std::vector<Int_t> p;          /* per channel, the running sums; |p| < rise*65536 */
+    std::vector<Double_t> s;
+};
+
 #endif // GRETINAWavefunction_h
@@ -10,6 +10,16 @@
 #pragma link C++ struct mode3DataPacket+;
 #pragma link C++ class g3ChannelEvent+;
 #pragma link C++ class g3Waveform+;
+
+/* g3Waveform::raw is decoded from packed when the trace was packed
+   (-packTraces, always in version 2), and read as written otherwise */
+#pragma read sourceClass="g3Waveform" targetClass="g3Waveform" version="[2]" \
+  source="std::vector<unsigned char> packed" target="raw" \
+  code="{ g3TraceCodec::Decode(onfile.packed, raw); }"
+#pragma read sourceClass="g3Waveform" targetClass="g3Waveform" version="[3-]" \
+  source="std::vector<short> raw; std::vector<unsigned char> packed" target="raw" \
+  code="{ if (onfile.packed.empty()) { raw = onfile.raw; } else { g3TraceCodec::Decode(onfile.packed, raw); } }"
+
 #pragma link C++ class g3CrystalEvent+;
 #pragma link C++ class g3OUT+;
 #pragma link C++ class vector<g3ChannelEvent>+;
@@ -0,0 +1,72 @@
+#ifndef MemoryReport_h
+#define MemoryReport_h
+
+#include <string>
+#include <vector>
+
+/* Where the memory goes.
+
+   The big tables (GRETINAVariables::dnlLU, INLCorrection inl/enl,
+   SuperPulse traces, GRETINAWF his, ...) are registered as components;
+   Snapshot() records, for each of them, how much is actually resident
+   (mincore() on its pages -- a table that is never touched costs address
+   space, not memory) and the process VmRSS / VmHWM.  Names with dots nest:
+   "GRETINA.var.dnlLU" is part of "GRETINA".
+
+   Sample() measures the same without keeping a column; it is called at
+   stage boundaries (every 100 MB of GEB data, the end of the ORRUBA
+   unpack, the merge matching, ...), and the largest resident size seen
+   per component, in a snapshot or a sample, is reported as its peak.
+   Registering a name again points it at the new memory and keeps its
+   peak; a NULL pointer marks memory that is gone (a freed vector).
+
+   Linking MemoryReport.cpp also replaces the global operator new.  With a
+   metrics file (gCountAllocs set) every allocation is then counted on the
+   thread that makes it (see AllocCounters() in StageMetrics.h), and each
+   StageTimer scope adds its allocation count and bytes to its stage;
+   otherwise new only tests that flag before malloc().  malloc() called
+   directly is not counted.
+
+   Print() writes the report at the end of a sort, WriteJSON() the same as
+   one JSON document to the file given, if any. */
+
+class MemoryReport {
+public:
+    MemoryReport(std::string job, std::string fileName = "");
+
+    void Component(std::string name, const void *p, size_t bytes);
+    void Snapshot(std::string label);
+    void Sample();
+
+    void Print();
+    void WriteJSON();
+
+    const std::string& FileName() { return fileName; }
+
+private:
+    struct snapshot {
+        std::string label;
+        long long rssKB;
+        long long peakKB;
+        std::vector<long long> resident;  /* per component, bytes */
+    };
+
+    struct component {
+        std::string name;
+        const void *p;
+        size_t bytes;
+        long long peak;                   /* largest resident, bytes */
+    };
+
+    long long Measure(component &c);
+
+    std::string job;
+    std::string fileName;
+    std::vector<component> components;
+    std::vector<snapshot> snapshots;
+    long long peakKB;                     /* VmHWM at the last sample */
+};
+
+extern MemoryReport *gMemReport;
+
+#endif // MemoryReport_h
@@ -20,6 +20,10 @@ public:
     ~RunList();
 
     std::vector<fileListStruct> GetListOfRuns() {return listOfRuns;}
+    std::string GetMetricsFile() {return metricsFile;}
+    double GetMetricsPeriod() {return metricsPeriod;}
+    std::string GetTraceFile() {return traceFile;}
+    std::string GetMemReportFile() {return memReportFile;}
 
 private:
     void CompileListOfRuns();
@@ -40,6 +44,10 @@ private:
     bool unpackGRETINA;
     bool withTracked;
     bool mergeTrees;
+    std::string metricsFile;
+    double metricsPeriod;
+    std::string traceFile;
+    std::string memReportFile;
 };
 
 #endif // RunList_h
@@ -21,6 +21,7 @@
 class controlVariables : public TObject {
 public:
     Int_t doTRACK;
+    Int_t trackThreads;
     Int_t withWAVE;
     Int_t withSEG;
 
@@ -41,6 +42,16 @@ public:
     Int_t compressedFile;
     Int_t compressedFileB;
     Int_t noHFC;
+    Int_t hfcMemMB;
+    Int_t useIndex;
+    Long64_t tsStart, tsEnd;
+    Int_t nSlices;
+    TString sliceTypes;
+    Long64_t ebWindow, ebLookBack;
+    TString metricsFile;
+    Float_t metricsPeriod;
+    TString traceFile;
+    TString memReportFile;
     Int_t suppressTS;
     Int_t pgh;
     Int_t noEB;
@@ -82,6 +93,13 @@ public:
     Bool_t BASIC_ENERGY;
     Bool_t INL_CORRECT;
 
+    /* Screening of the Mode3 traces before their analysis (g3TraceScreen) */
+    Bool_t screenTraces;
+    Int_t screenRail, screenEdge;
+
+    /* Mode3 traces written packed to the tree (g3Waveform::packed) */
+    Bool_t packTraces;
+
     /* Analysis of Mode2 and Mode3 together */
     Bool_t analyze2AND3;
     TString fileName2;
@@ -176,6 +194,13 @@ public:
 
     Int_t tossed4Time;
 
+    /* Trace screening (-screen): traces checked, flagged per reason (a
+       trace can have several), and the work not done for them */
+    Int_t screenChecked, screenFlagged;
+    Int_t screenTruncated, screenSaturated, screenPileupFPGA, screenPileup;
+    long long int screenSkippedSamples;   /* samples not given to the CFD */
+    Int_t screenSkippedSP;                /* traces kept out of the superpulses */
+
     long long int lastBdTS[MAXCRYSTALS*4];
 
     /* Mode2 analysis variables */
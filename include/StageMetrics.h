@@ -0,0 +1,131 @@
+#ifndef StageMetrics_h
+#define StageMetrics_h
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+/* Per-stage throughput and latency metrics.
+
+   Every instrumented stage (GEB loop, GetData per GEB type, analyzeMode3,
+   tracking, TTree::Fill, merge matching, writing, ...) accumulates calls,
+   wall time and bytes.  With a metrics file given, the totals are written
+   every 'period' seconds and once more at the end:
+
+     - as JSON lines (one object per record) by default, or
+     - in Prometheus text format when the file name ends with ".prom"
+       (file is replaced atomically, as the node_exporter textfile
+       collector expects).
+
+   Without a metrics file gMetrics is NULL, and without a trace file (see
+   Trace.h) gTrace is NULL too; a StageTimer then costs two pointer
+   tests. */
+
+class StageMetrics {
+public:
+    StageMetrics(std::string fileName, double period, std::string job);
+    ~StageMetrics();
+
+    /* Stage ids are global and stable, so call sites can keep them in a
+       function-level static: static int id = StageMetrics::Id("Fill"); */
+    static int Id(const std::string& name);
+    static const std::string& Name(int id);
+
+    void Add(int id, double seconds, long long count = 1, long long bytes = 0);
+    /* Counts without time, e.g. bytes read or events built */
+    void Count(int id, long long count, long long bytes = 0);
+    /* operator new calls made inside the stage (see MemoryReport.h) */
+    void AddAllocations(int id, long long allocs, long long allocBytes);
+
+    /* Per stage: calls, allocations and bytes per call */
+    void PrintAllocations();
+    void WriteAllocationsJSON(FILE *out);
+
+    /* Writes a record if the period is over; cheap enough per event */
+    void Poll();
+    void Write();
+
+    const std::string& FileName() { return fileName; }
+
+private:
+    struct Stage {
+        long long count;
+        long long bytes;
+        double seconds;
+        long long lastCount;
+        long long lastBytes;
+        double lastSeconds;
+        long long allocs;
+        long long allocBytes;
+    };
+
+    Stage& At(int id);
+
+    void WriteJSON(double elapsed, double interval);
+    void WritePrometheus(double elapsed);
+
+    std::string fileName;
+    std::string job;
+    bool prometheus;
+    double period;
+    FILE *out;
+
+    std::vector<Stage> stages;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastWrite;
+    unsigned int polls;
+};
+
+extern StageMetrics *gMetrics;
+
+/* Allocations made by the calling thread so far; only counted when
+   MemoryReport.cpp is linked in and gCountAllocs is set (by the
+   StageMetrics constructor -- without a metrics file nobody reads them) */
+struct allocCounters {
+    long long count;
+    long long bytes;
+};
+allocCounters& AllocCounters();
+extern bool gCountAllocs;
+
+/* metrics.jsonl + "_gretina" -> metrics_gretina.jsonl, for the files of
+   child processes */
+std::string SiblingFileName(const std::string& fileName, const std::string& tag);
+
+/* Times the enclosing scope (or up to Stop()) as one call of stage 'id',
+   and as one trace event */
+class StageTimer {
+public:
+    StageTimer(int id, long long bytes = 0) : stageId(id), stageBytes(bytes), running(true) {
+        if(gMetrics || gTrace) { t0 = std::chrono::steady_clock::now(); }
+        if(gMetrics) { alloc0 = AllocCounters(); }
+    }
+    ~StageTimer() { Stop(); }
+    void SetBytes(long long bytes) { stageBytes = bytes; }
+
+    void Stop() {
+        if(!running) { return; }
+        running = false;
+        if(gMetrics || gTrace) {
+            std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+            if(gMetrics) {
+                allocCounters a = AllocCounters();
+                gMetrics->Add(stageId, dt.count(), 1, stageBytes);
+                gMetrics->AddAllocations(stageId, a.count - alloc0.count, a.bytes - alloc0.bytes);
+            }
+            if(gTrace) { gTrace->Complete(stageId, Trace::Micro(t0), 1e6*dt.count()); }
+        }
+    }
+
+private:
+    int stageId;
+    long long stageBytes;
+    bool running;
+    std::chrono::steady_clock::time_point t0;
+    allocCounters alloc0;
+};
+
+#endif // StageMetrics_h
@@ -0,0 +1,63 @@
+#ifndef SyntheticData_h
+#define SyntheticData_h
+
+#include <stdio.h>
+#include <vector>
+
+#include <Rtypes.h>
+#include <TRandom3.h>
+
+/* Synthetic detector data, in the formats the unpackers read.
+
+   Everything is drawn from one TRandom3 with a fixed seed, so the same
+   seed gives the same bytes on every machine -- used by goddessBench to
+   feed the real decoding code repeatable input.
+
+     - Pulse():       a digitized preamp pulse (baseline, rise, decay, noise)
+     - Mode2():       one decomposed crystal, mode2ABCD6789 as written by the
+                      decomposition (GEB type DECOMP payload)
+     - Mode3():       one digitizer channel packet, 0xAAAA header, 14 header
+                      words and the trace, big endian (GEB type RAW payload)
+     - S800Event():   one S800 event, trigger and timestamp subpackets
+                      (GEB type S800 payload)
+     - ORRUBAEvent(): one ORRUBA event as .ldf words (file byte order)
+     - WriteLDF():    packs such events into 8194-word DATA buffers
+     - WriteGEB():    one GEB record, globalHeader and payload */
+
+class SyntheticData {
+public:
+    SyntheticData(UInt_t seed = 4357);
+
+    void Pulse(std::vector<Short_t> &trace, Int_t length, Float_t amplitude,
+               Float_t t0, Float_t riseTime, Float_t tau, Float_t baseline,
+               Float_t noise);
+
+    /* Appends the payload; nIntPts is capped at MAX_INTPTS */
+    void Mode2(std::vector<UChar_t> &payload, Int_t crystalID, Long64_t timestamp,
+               Float_t energy, Int_t nIntPts);
+
+    /* Appends the payload.  Channel 9 is the central contact (positive
+       energy and trace), the others are segments; traceLength is rounded
+       up to an even number of samples. */
+    void Mode3(std::vector<UChar_t> &payload, Int_t module, Int_t channel,
+               Long64_t timestamp, Float_t energy, Int_t traceLength);
+
+    /* Appends the payload, in host byte order as getAndProcessS800() reads it */
+    void S800Event(std::vector<UChar_t> &payload, Long64_t timestamp);
+
+    /* Appends nHits silicon channels (distinct, 1-700), the timestamp
+       channels 1000-1002 and the end-of-event word 0xffffffff */
+    void ORRUBAEvent(std::vector<UInt_t> &words, ULong64_t timestamp, Int_t nHits);
+
+    /* Writes the events in 'words' as .ldf DATA buffers; an event never
+       spans two buffers.  Returns the number of buffers written. */
+    Int_t WriteLDF(FILE *out, const std::vector<UInt_t> &words);
+
+    /* Returns the number of bytes written, or -1 */
+    static Int_t WriteGEB(FILE *out, Int_t type, Long64_t timestamp,
+                          const std::vector<UChar_t> &payload);
+
+    TRandom3 rand;
+};
+
+#endif // SyntheticData_h
@@ -0,0 +1,62 @@
+#ifndef Trace_h
+#define Trace_h
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Timeline of the instrumented stages, in Chrome trace event format.
+
+   Every StageTimer scope (see StageMetrics.h) becomes one complete ("X")
+   event with the stage name, process and thread, so the file opened in
+   ui.perfetto.dev or chrome://tracing shows where each thread spends its
+   wall time, nested as the scopes are.  Times are CLOCK_MONOTONIC in us,
+   so traces of processes started together (goddessSort, unpackGRETINA,
+   time slices) line up when loaded side by side.
+
+   Events are buffered and written in blocks; after TRACE_MAX_EVENTS the
+   rest are dropped, to keep the file small enough to load.  Without a
+   trace file gTrace is NULL and nothing is recorded. */
+
+class Trace {
+public:
+    Trace(std::string fileName, std::string process);
+    ~Trace();
+
+    /* Microseconds on the trace clock */
+    static double Now();
+    static double Micro(std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::micro>(t.time_since_epoch()).count();
+    }
+
+    /* One event of stage 'id' (StageMetrics::Id) on the calling thread */
+    void Complete(int id, double start, double duration);
+
+    const std::string& FileName() { return fileName; }
+
+private:
+    struct Event {
+        int id;
+        int tid;
+        double start;
+        double duration;
+    };
+
+    void Flush();
+
+    std::string fileName;
+    std::string process;
+    FILE *out;
+    int pid;
+    long long recorded;
+    long long dropped;
+    std::vector<Event> events;
+    std::vector<int> threads;   /* named so far */
+    std::mutex lock;
+};
+
+extern Trace *gTrace;
+
+#endif // Trace_h
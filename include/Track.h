@@ -76,6 +76,7 @@ public:
     Float_t eSum;
     Int_t trackNum;
     Int_t bestPermutation;
+    Int_t nPermEval; /* Complete permutations evaluated by doTrack() */
     Int_t processed;
 
     TrackClusterIP intpts[MAXNUMDET];
@@ -90,7 +91,7 @@ public:
     void Clear();
     void PrintCluster();
 
-    ClassDef(TrackCluster, 1);
+    ClassDef(TrackCluster, 2);
 };
 
 class TrackShell : public TObject {
@@ -101,7 +102,7 @@ public:
     Float_t normChiSq[MAXSHELLHITS];
     long long int timestamp[MAXSHELLHITS];
     Int_t crystalID[MAXSHELLHITS];
-    TVector3 xyz[MAXSHELLHITS];
+    Double_t x[MAXSHELLHITS], y[MAXSHELLHITS], z[MAXSHELLHITS]; /* Lab position, cm */
     Float_t eDet[MAXSHELLHITS];
     Float_t eSum[MAXSHELLHITS];
     Int_t origPos[MAXSHELLHITS];
@@ -119,7 +120,13 @@ public:
     Int_t knownNumClusters;
     Int_t knownClusterNum[MAXSHELLHITS];
 
+    Int_t nUsed; //! Hits filled since the last Reset()
+
 public:
+    TrackShell() { nUsed = MAXSHELLHITS; }
+    TVector3 XYZ(Int_t i) { return TVector3(x[i], y[i], z[i]); }
+    void SetXYZ(Int_t i, Double_t xi, Double_t yi, Double_t zi) { x[i] = xi;  y[i] = yi;  z[i] = zi; }
+    void Reset();
     Double_t xx(Int_t i);
     Double_t yy(Int_t i);
     Double_t zz(Int_t i);
@@ -132,7 +139,7 @@ public:
     void Print();
     void PrintClusters();
 
-    ClassDef(TrackShell, 1);
+    ClassDef(TrackShell, 2);
 };
 
 class TrackCtrl : public TObject {
@@ -203,6 +210,11 @@ public:
     Int_t trackOps[MAXNUMSEG];
     Int_t jumpGroupLength[MAXNUMSEG];
 
+    /* Full tracking search: branch and bound (exact), optionally
+       keeping only the beamWidth best continuations (0 = all) */
+    Int_t branchAndBound;
+    Int_t beamWidth;
+
     Float_t badTheoAngPenalty;
 
 public:
@@ -212,7 +224,18 @@ public:
     void PrintPartial();
     Int_t trackOpt(Int_t i);
 
-    ClassDef(TrackCtrl, 1);
+    ClassDef(TrackCtrl, 2);
+};
+
+/* The TrackStat counters doTrack() updates, kept per call so clusters
+   can be tracked on several threads (see TrackPool.h) */
+struct TrackCounts {
+    UInt_t trackingCalls;
+    long nPerm;
+    long long permClusters[MAXNUMSEG];
+    long long permEval[MAXNUMSEG];
+
+    void Zero();
 };
 
 class TrackStat : public TObject {
@@ -242,6 +265,8 @@ public:
     UInt_t nClusters;
     long notTracked;
     long nPerm;
+    long long permClusters[MAXNUMSEG]; /* Full searches, by nDet */
+    long long permEval[MAXNUMSEG]; /* Permutations they evaluated */
     long doubleSegHits;
     long segHits;
     long numInputDataLines;
@@ -259,8 +284,10 @@ public:
 
 public:
     void Zero();
+    void Add(const TrackCounts &c);
+    void PrintPermutations(Int_t *nPerm);
 
-    ClassDef(TrackStat, 1);
+    ClassDef(TrackStat, 2);
 };
 
 class TrackPerm : public TObject {
@@ -274,6 +301,8 @@ public:
     ClassDef(TrackPerm, 1);
 };
 
+class TrackPool;
+
 class Track : public TObject {
 public:
     TrackShell shell;
@@ -288,15 +317,23 @@ public:
 
     long long faculty[MAXFACULTY];
 
+    TrackPool *pool; //! First tracking pass on threads, NULL = serial
+    Int_t clustUsed; //! Clusters written since the last resetClusters()
+
 public:
-    Track() { ; }
-    ~Track() { ; }
-    void Initialize();
+    Track() { pool = NULL;  clustUsed = MAXCLUSTERHITS; }
+    ~Track();
+    void Initialize(TString chatFile = "track.chat");
+    void SetThreads(Int_t nThreads);
+    void resetClusters();
+    void useClusters(Int_t n) { if (n > clustUsed) { clustUsed = n; } }
     Int_t findTargetPos();
     Int_t findClusters();
     Int_t transferClusters();
     Int_t trackEvent();
     Int_t doTrack(Int_t mode, Int_t iClust);
+    Int_t doTrack(Int_t mode, Int_t iClust, TrackCounts &counts);
+    Float_t searchPermutations(Int_t iClust, TrackCounts &counts);
     Int_t reCluster(Int_t ii, Int_t m);
     Int_t splitCluster(Int_t ii, Int_t m);
     Int_t combineCluster (Int_t focusC);
@@ -0,0 +1,59 @@
+#ifndef TrackPool_h
+#define TrackPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Track.h"
+
+/* Worker threads for the first tracking pass of Track::trackEvent().
+
+   The clusters of an event are independent: doTrack() writes only its
+   own TrackCluster and a TrackCounts, and reads the shared ctrl, perm
+   and faculty tables.  Run() hands the clusters to the workers and the
+   calling thread, each taking the next one not yet tracked, and returns
+   when all are done; trackEvent() then adds the counters in cluster
+   order, so the clusters, the g1OUT gammas made from them and the
+   statistics are the same as with serial tracking.
+
+   Waking the workers costs several microseconds, more than a few small
+   clusters take, so an event whose clusters would need fewer than
+   TRACKPOOL_MINWORK permutations in a full search is tracked on the
+   calling thread. */
+
+class TrackPool {
+public:
+    TrackPool(Track *track, int nThreads);
+    ~TrackPool();
+
+    static int HardwareThreads();
+
+    /* doTrack() on clust[iClust[k]], k < n; status and counters per k */
+    void Run(int n, const int *iClust, int *status, TrackCounts *counts);
+
+private:
+    void Worker();
+    void Work();
+
+    Track *track;
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake;      /* workers: a new job */
+    std::condition_variable finished;  /* Run(): last worker left */
+
+    /* The current job */
+    int n;
+    const int *iClust;
+    int *status;
+    TrackCounts *counts;
+    std::atomic<int> next;  /* next k to take */
+    long long job;          /* job number, changes for each Run() */
+    int helpers;            /* workers that may still join the job */
+    int active;             /* workers inside Work() */
+    bool stop;
+};
+
+#endif // TrackPool_h
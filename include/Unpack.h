@@ -2,7 +2,9 @@
 #define Unpack_h
 
 #include "GRETINA.h"
+#include "MemoryReport.h"
 #include "RunList.h"
+#include "StageMetrics.h"
 #include "TypeDef.h"
 #include "UnpackGRETINA.h"
 #include "UnpackORRUBA.h"
@@ -36,6 +38,12 @@ class Unpack {
 public:
     Unpack();
 
+    // Matches every ORRUBA timestamp to the closest GRETINA one within timeThreshold (both lists sorted by timestamp)
+    static std::vector<matchedEvents> MatchTimeStamps(const std::vector<std::pair<Int_t, Long64_t> >& orrubaTimeStamps_,
+                                                      const std::vector<std::pair<Int_t, Long64_t> >& gretinaTimeStamps_,
+                                                      Long64_t timeThreshold, Long64_t timeNotFoundBreak,
+                                                      Long64_t& nentriesMatched, bool showProgress = true);
+
 private:
     void CombineReader(fileListStruct run);
     void CombineReader2(fileListStruct run);
@@ -1,5 +1,14 @@
 #ifndef UnpackGRETINARaw
 #define UnpackGRETINARaw
 
+#include <stdio.h>
 
-#endif // UnpackGRETINARaw
\ No newline at end of file
+#include "SortingStructures.h"
+#include "INLCorrection.h"
+
+/* Reading the GEB payload that follows gHeader (UnpackGRETINARaw.cpp) */
+void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
+            INLCorrection *inlCor, UShort_t junk[]);
+void SkipData(FILE* inf, UShort_t junk[]);
+
+#endif // UnpackGRETINARaw
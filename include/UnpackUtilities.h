@@ -41,6 +41,68 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber);
     integer value to indicate success or failure.
 */
 
+FILE* OpenGEBInput(TString fileName, Bool_t compressed, controlVariables* ctrl);
+/*! \fn FILE* OpenGEBInput(TString fileName, Bool_t compressed, controlVariables* ctrl)
+    \brief Opens a GEB file, applying the type and time selection.
+    \param fileName TString with the path of the GEB file.
+    \param compressed Bool_t, kTRUE for a .gz, .bz2 or .gebz file, which is then
+           decompressed in-process (see src/hfc/GEBZip.h).
+    \param ctrl controlVariables* -- useIndex, tsStart and tsEnd are used.
+    \return FILE* -- the (selected) GEB stream, NULL if the file can't be opened.
+
+    Without -index/-tsStart/-tsEnd this is a plain open.  Otherwise plain files
+    are read through the sidecar index <fileName>.idx (built here if missing or
+    stale, see src/hfc/GEBIndex.h), so only the selected GEB records are read.
+    Compressed files are filtered while decoding; .gebz archives also skip
+    whole chunks outside the time window.
+*/
+
+FILE* OpenHFCStream(TString fileName, Bool_t compressed, controlVariables* ctrl);
+/*! \fn FILE* OpenHFCStream(TString fileName, Bool_t compressed, controlVariables* ctrl)
+    \brief Opens a GEB file and returns a time-ordered stream of it.
+    \param fileName TString with the path of the GEB file.
+    \param compressed Bool_t, kTRUE for a compressed file (see OpenGEBInput).
+    \param ctrl controlVariables* -- hfcMemMB sets the memory cap for the adaptive
+           HFC depth (0 uses the old fixed depth of HFC_GEBDEPTH events), and the
+           selection of OpenGEBInput applies.
+    \return FILE* -- the time-ordered stream, NULL if the file can't be opened.
+
+    Replaces piping the data through "./GEB_HFC -p".  The HFC reordering
+    runs inside unpackGRETINA (see src/hfc/HFCStream.h), and the ordered
+    GEB headers and payloads are read back with fread() from memory.
+*/
+
+Int_t RunTimeSlices(int argc, char** argv, controlVariables* ctrl);
+/*! \fn Int_t RunTimeSlices(int argc, char** argv, controlVariables* ctrl)
+    \brief Sorts one GEB file as several time slices in parallel (-slices N).
+    \param argc, argv the unpackGRETINA command line, passed on to the slices.
+    \param ctrl controlVariables* with the parsed command line.
+    \return Int_t -- 0 on success, otherwise the exit code for main.
+
+    The GEB index gives all GEB header timestamps; the file is cut near N
+    equal shares of data, at gaps larger than the build window where the file
+    is also in time order across the cut.  The merged tree is the one a
+    serial sort makes as long as HFC drops nothing near the cuts (see the
+    HFC summary in the slice logs) and Mode 3 channel timestamps stay within
+    the build window of their GEB header; make slicecheck compares the two.
+    Every slice is an unpackGRETINA of its own (-tsStart/-tsEnd, output
+    <rootName>.sliceK, log in <rootName>.sliceK.log), run in parallel, and
+    the outputs are concatenated in time order with hadd.  The GEB types
+    with a tree branch are passed on with -sliceTypes, in the order they
+    first appear in the whole file, so every slice makes the same branches
+    as a serial sort, before its first entry.
+*/
+
+const char* TypeBranchName(Int_t type);
+/*! \fn const char* TypeBranchName(Int_t type)
+    \brief Name of the tree branch a GEB type is unpacked into.
+    \param type Int_t GEB type (DECOMP, RAW, ...).
+    \return const char* -- "g2", "g3", ..., NULL for types without a branch.
+
+    These branches are made on the first header of their type (or up front
+    with -sliceTypes), not with the rest of the tree.
+*/
+
 int ProcessEvent(Float_t currTS, controlVariables* ctrl,
 		  counterVariables* cnt);
 /*! \fn void ProcessEvent(Float_t currTS, controlVariables* ctrl, counterVariables* cnt, GRETINAVariables* gVar, SuperPulse* sp, Histos* histos)
@@ -0,0 +1,144 @@
+#include "EventBuilder.h"
+#include "UnpackGRETINARaw.h"
+#include "UnpackUtilities.h"
+#include "S800Functions.h"
+#include "Utilities.h"
+#include "HFCStream.h"
+#include "StageMetrics.h"
+
+#include <signal.h>
+#include <iostream>
+
+EventBuilder::EventBuilder(controlVariables* ctrl, counterVariables* cnt, INLCorrection* inlCor,
+                           TCutG* incomingBeam, TCutG* outgoingBeam) :
+    ctrl(ctrl), cnt(cnt), inlCor(inlCor), incomingBeam(incomingBeam), outgoingBeam(outgoingBeam),
+    window(ctrl->ebWindow), lookBack(ctrl->ebLookBack),
+    currTS(0), lastTS(0), TSerrors(0), eventSpan(0),
+    builtEvents(0), spanSum(0), spanMax(0) {
+}
+
+/****************************************************/
+
+Int_t EventBuilder::Open(FILE** inf) {
+    currTS = 0;  lastTS = 0;  TSerrors = 0;  eventSpan = 0;
+
+    if (lookBack <= 0 || ctrl->pgh || ctrl->analyze2AND3) { return(0); }
+
+    /* Without the HFC pass, a bounded look-back still puts slightly late
+       fragments back in place before the event building */
+    if (ctrl->noHFC) {
+        HFCStream *hfc = new HFCStream(*inf, false, HFC_GEBDEPTH, ctrl->hfcMemMB, lookBack);
+        *inf = hfc->open();
+        if (!*inf) { delete hfc;  return(2); }
+    }
+    std::cout << PrintOutput("\t\tEvent builder look-back: ", "blue") << lookBack
+              << PrintOutput(", window: ", "blue") << window << std::endl;
+    return(0);
+}
+
+/****************************************************/
+
+void EventBuilder::Add(FILE* inf, UShort_t junk[]) {
+    static const Int_t skipId = StageMetrics::Id("GetData.skipped");
+
+    /* Check against timestamps in file being out of order... */
+    if(gHeader.timestamp < lastTS) {
+        if(!ctrl->suppressTS) {
+            std::cout << ALERTTEXT;
+            printf("Unpack(): TS out of order: lastTS %lld, current %lld\n",
+                   lastTS, gHeader.timestamp);
+            std::cout << RESET_COLOR;  fflush(stdout);
+        }
+        TSerrors++;
+    }
+    lastTS = gHeader.timestamp;
+
+    /* Just throw out stupid events with no valid TS. */
+    if(gHeader.timestamp == 0) {
+        StageTimer skipTimer(skipId, sizeof(struct globalHeader) + gHeader.length);
+        SkipData(inf, junk);
+        cnt->Increment(gHeader.length);
+        return;
+    }
+
+    if(currTS == 0) { currTS = gHeader.timestamp; }
+
+    /* Build events based on timestamp differences between the
+       start of an event and current timestamp. */
+    long long int deltaEvent = gHeader.timestamp - currTS;
+
+    if(llabs(deltaEvent) < window) {
+        if(llabs(deltaEvent) > eventSpan) { eventSpan = llabs(deltaEvent); }
+        GetData(inf, ctrl, cnt, inlCor, junk);
+        if(ctrl->superPulse) {
+            if(gHeader.type == RAW) {
+                gret->sp.trLength = gret->g3Temp[0].wf.raw.size();
+            }
+        }
+    } else { /* Time difference is big...old event should be closed. */
+
+        /* We need to be careful of tracelengths in superPulse analysis... */
+        if(ctrl->superPulse) {
+            if(gHeader.type == RAW) {
+                gret->sp.trLength = gret->g3Temp[0].wf.raw.size();
+            }
+        }
+        EndEvent(kTRUE);
+
+        /* Check on gate conditions...do we write filtered output? */
+        if(ctrl->outputON) {
+            Int_t writeOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
+        } // S800 crap
+
+        /* Update timestamp information for beginning of new event,
+           and start filling new event. */
+        currTS = gHeader.timestamp;
+        GetData(inf, ctrl, cnt, inlCor, junk);
+    }
+}
+
+/****************************************************/
+
+Bool_t EventBuilder::Close() {
+    if(currTS == 0) { return kFALSE; }
+
+    /* Close the last event like all the others -- each time
+       slice ends here too */
+    EndEvent(kFALSE);
+    currTS = 0;
+    return kTRUE;
+}
+
+/****************************************************/
+
+void EventBuilder::EndEvent(Bool_t stopOnError) {
+    static const Int_t eventId = StageMetrics::Id("events");
+
+    builtEvents++;
+    spanSum += eventSpan;
+    if(eventSpan > spanMax) { spanMax = eventSpan; }
+    eventSpan = 0;
+    if(gMetrics) { gMetrics->Count(eventId, 1); }
+
+    Int_t evtOK = 0;
+    if(ctrl->gateTree) {
+        Int_t pidOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
+        if (pidOK) { evtOK = ProcessEvent(currTS, ctrl, cnt); }
+    } else {
+        evtOK = ProcessEvent(currTS, ctrl, cnt);
+    }
+    if (evtOK < 0 && stopOnError) { raise(SIGINT); }
+
+    ResetEvent(ctrl, cnt);
+    cnt->event = 0.0;
+}
+
+/****************************************************/
+
+void EventBuilder::PrintStatistics() {
+    if(builtEvents == 0) { return; }
+    std::cout << PrintOutput("\t\tBuilt events: ", "yellow") << builtEvents
+              << PrintOutput("; mean TS span ", "yellow") << (Double_t)spanSum/builtEvents
+              << " (" << 100.*spanSum/builtEvents/window << PrintOutput("% of the window)", "yellow")
+              << PrintOutput(", max ", "yellow") << spanMax << std::endl;
+}
@@ -2,10 +2,23 @@
 
 void g3Waveform::Clear() {
     raw.clear();
+    packed.clear();
     pz.clear();
 }
 
-Int_t g3Waveform::LEDLevel(Int_t index, Int_t thresh, Int_t filterK) {
+/* Kernels shared by the g3Waveform functions and g3TimingBatch, on a
+   trace of n samples */
+
+static Float_t BLKernel(const Short_t *raw, Int_t start, Int_t end) {
+    Int_t sum = 0;
+    for(Int_t i = start; i < end; i++) {
+        sum += raw[i];
+    }
+
+    return ((Float_t)sum/(Float_t)(end - start));
+}
+
+static Int_t LEDLevelKernel(const Short_t *raw, Int_t index, Int_t thresh, Int_t filterK) {
     Short_t d1, d2, d3, d4, d5, dd, dd1, dd2, dd3;
     d1 = raw[index-2] - raw[index-filterK-2];
     d2 = raw[index-1] - raw[index-filterK-1];
@@ -25,98 +38,142 @@ Int_t g3Waveform::LEDLevel(Int_t index, Int_t thresh, Int_t filterK) {
     }
 }
 
-Int_t g3Waveform::LED(Int_t index, Int_t thresh, Int_t filterK) {
-    Int_t lled[1024] = {0};
-
-    for(Int_t i = index + 2; i < raw.size(); i++) {
-        lled[i] = LEDLevel(i, thresh, filterK);
-        if((lled[i] - lled[i-1]) == 1) {
+/* First sample after index+1 where the level goes from 0 to 1; n if none.
+   LEDLevel() looks two samples ahead, so the last two samples are not
+   tried (they used to be, reading past the end of the trace). */
+static Int_t LEDKernel(const Short_t *raw, Int_t n, Int_t index, Int_t thresh, Int_t filterK) {
+    Int_t last = 0;
+    for(Int_t i = index + 2; i < n - 2; i++) {
+        Int_t level = LEDLevelKernel(raw, i, thresh, filterK);
+        if((level - last) == 1) {
             return i;
         }
+        last = level;
     }
-    return raw.size();
+    return n;
 }
 
-/* CFD algorithm from Paul Fallon for getting T0 from the trace. */
+/* CFD algorithm from Paul Fallon for getting T0 from the trace.
 
-Float_t g3Waveform::CFD(Int_t startSample = 0) {
-    Int_t tracelength = raw.size();
-    Int_t maxJ = 0;
-    Float_t sint[MAX_TRACE_LENGTH] = {0.};
-    Float_t sdiff[MAX_TRACE_LENGTH] = {0.};
-    Float_t s[MAX_TRACE_LENGTH] = {0.};
+   The smoothing, the differentiation and the CFD signal are done in one
+   pass, keeping the last few values of each filter; only the CFD signal,
+   which is searched backwards from its maximum, is stored (in cfd[],
+   at least n samples).  Samples past the end of the trace count as 0, as
+   in the zeroed arrays this used to fill. */
 
-    Float_t startCFD = 0., start1 = 0., maxPulse = 0., offset = 0.;
-    Float_t y1 = 0., x1 = 0., y2 = 0., x2 = 0.;
-    Float_t tcross = -1., tauDiff = 6., delay = 5., fraction = 0.25;
+static Float_t CFDKernel(const Short_t *raw, Int_t n, Int_t startSample, Short_t *cfd) {
+    const Float_t tauDiff = 6., delay = 5., fraction = 0.25;
+    const Int_t iDelay = (Int_t)delay;
 
-    Float_t wave[MAX_TRACE_LENGTH] = {0.};
-    std::vector<Short_t> cfd;
+    /* Remove DC level */
+    Float_t baseline = BLKernel(raw, 5, 45);
+    Float_t w0 = raw[0] - baseline;
+    Float_t w1 = (n > 1) ? raw[1] - baseline : 0.;
 
-    // cout << tracelength << endl;
+    /* Integrate: sint[i-1], sint[i] */
+    Float_t sintA = (w0*2 + w1)/3.;
+    Float_t sintB = 0.;
+    if(n > 2) { sintB = (w0 + 2*w1 + (raw[2] - baseline))/4.; }
 
-    /* Remove DC level */
-    Float_t baseline = BL(5, 45);
-    for(Int_t i = 0; i < tracelength; i++) {
-      wave[i] = raw[i] - baseline;
-    }
+    /* ... and again: s[i-1] */
+    Float_t sPrev = (2*sintA + sintB)/3.;
 
-    /* Integrate and differentiate */
-    sint[0] = (wave[0]*2 + wave[1])/3.;
-    for(Int_t i = 1; i < tracelength - 1; i++) {
-        sint[i] = (wave[i - 1] + 2*wave[i] + wave[i + 1])/4.;
-    }
-    s[0] = (2*sint[0] + sint[1])/3.;
-    for(Int_t i = 1; i < tracelength - 1; i++) {
-        s[i] = (sint[i - 1] + 2*sint[i] + sint[i + 1])/4.;
-    }
-    sdiff[0] = s[0];
-    for(Int_t i = 1; i < tracelength - 1; i++) {
-        sdiff[i] = ((s[i] - s[i - 1]) +
-		  (sdiff[i - 1] - (sdiff[i - 1]/tauDiff)));
-    }
+    /* Differentiate: sdiff[i], i > i-8 */
+    Float_t sdiff[8];
+    sdiff[0] = sPrev;
 
-    /* CFD */
-    for(Int_t i = (Int_t)delay; i < tracelength - 1; i++) {
-        if(i + delay < tracelength - 1) {
-            cfd.push_back((Short_t)(sdiff[i - (Int_t)delay] - fraction*sdiff[i]));
-        } else {
-            cfd.push_back((Short_t)(sdiff[i] - fraction*sdiff[i]));
-        }
-    }
+    Int_t nCFD = 0, maxJ = 0;
+    Float_t maxPulse = 0.;
 
-    /* Find max pulse height */
-    maxPulse = 0; maxJ = 0;
-    for(UInt_t uj = startSample; uj < cfd.size(); uj++) {
-        if(cfd[uj] > maxPulse) {
-            maxPulse = cfd[uj];
-            maxJ = uj;
+    for(Int_t i = 1; i < n - 1; i++) {
+        Float_t sintC = 0.;
+        if(i + 1 < n - 1) {
+            sintC = ((raw[i] - baseline) + 2*(raw[i + 1] - baseline) + (raw[i + 2] - baseline))/4.;
+        }
+        Float_t s = (sintA + 2*sintB + sintC)/4.;
+        Float_t last = sdiff[(i - 1) & 7];
+        Float_t d = ((s - sPrev) + (last - (last/tauDiff)));
+        sdiff[i & 7] = d;
+        sPrev = s;  sintA = sintB;  sintB = sintC;
+
+        /* CFD */
+        if(i >= iDelay) {
+            Short_t c;
+            if(i + delay < n - 1) { c = (Short_t)(sdiff[(i - iDelay) & 7] - fraction*d); }
+            else { c = (Short_t)(d - fraction*d); }
+            cfd[nCFD] = c;
+
+            /* Find max pulse height */
+            if(nCFD >= startSample && c > maxPulse) {
+                maxPulse = c;
+                maxJ = nCFD;
+            }
+            nCFD++;
         }
     }
 
     /* Crossing point */
-    if(cfd.size() > (UInt_t)maxJ) {
+    Int_t tcross = -1;
+    if(nCFD > maxJ) {
         if(cfd[maxJ] < 0) {
-            for(UInt_t uj = 0; uj < cfd.size(); uj++) {
-	           cfd[uj] = -cfd[uj];
+            for(Int_t j = 0; j < nCFD; j++) {
+                cfd[j] = -cfd[j];
             }
         }
-        for(Int_t i = maxJ; i > 0; i--) {
-            if(cfd[i] < 0) {tcross = i; break;}
+        for(Int_t j = maxJ; j > 0; j--) {
+            if(cfd[j] < 0) {tcross = j; break;}
         }
     }
 
-    UInt_t ui = (UInt_t)tcross;
-    if(cfd.size() > ui) {
-        x1 = ui; y1 = cfd[ui]; x2 = ui + 1; y2 = cfd[ui + 1];
-        start1 = x2 - (y2/((y2 - y1)/(x2 - x1)));
-    } else {
-        start1 = -10;
+    /* No crossing before the maximum: this used to convert tcross = -1 to
+       UInt_t, which gcc on x86-64 makes 0, so samples 0 and 1 were used */
+    if(tcross < 0) { tcross = 0; }
+    if(tcross + 1 >= nCFD) { return -10; }
+
+    Float_t x1 = tcross, y1 = cfd[tcross], x2 = tcross + 1, y2 = cfd[tcross + 1];
+    return (x2 - (y2/((y2 - y1)/(x2 - x1))));
+}
+
+Int_t g3Waveform::LEDLevel(Int_t index, Int_t thresh, Int_t filterK) {
+    return LEDLevelKernel(&raw[0], index, thresh, filterK);
+}
+
+Int_t g3Waveform::LED(Int_t index, Int_t thresh, Int_t filterK) {
+    return LEDKernel(&raw[0], raw.size(), index, thresh, filterK);
+}
+
+Float_t g3Waveform::CFD(Int_t startSample = 0) {
+    Short_t cfd[MAX_TRACE_LENGTH];
+    return CFDKernel(&raw[0], raw.size(), startSample, cfd);
+}
+
+/**************************************************************/
+
+void g3TimingBatch::Clear() {
+    traces.clear();
+    start.clear();  length.clear();  tag.clear();
+}
+
+void g3TimingBatch::Add(const std::vector<Short_t> &raw, Int_t tag) {
+    start.push_back(traces.size());
+    length.push_back(raw.size());
+    this->tag.push_back(tag);
+    traces.insert(traces.end(), raw.begin(), raw.end());
+}
+
+void g3TimingBatch::Run(Int_t startSample) {
+    cfd.resize(start.size());
+    for(size_t k = 0; k < start.size(); k++) {
+        if((Int_t)scratch.size() < length[k]) { scratch.resize(length[k]); }
+        cfd[k] = CFDKernel(&traces[start[k]], length[k], startSample, &scratch[0]);
     }
-    startCFD = start1;
-    cfd.clear();
+}
 
-    return (startCFD);
+void g3TimingBatch::RunLED(Int_t index, Int_t thresh, Int_t filterK) {
+    led.resize(start.size());
+    for(size_t k = 0; k < start.size(); k++) {
+        led[k] = LEDKernel(&traces[start[k]], length[k], index, thresh, filterK);
+    }
 }
 
 Float_t g3Waveform::riseTime(Float_t fLow, Float_t fHigh) {
@@ -146,12 +203,7 @@ Float_t g3Waveform::riseTime(Float_t fLow, Float_t fHigh) {
 }
 
 Float_t g3Waveform::BL(Int_t start, Int_t end) {
-    Int_t sum = 0;
-    for(Int_t i = start; i < end; i++) {
-        sum += raw[i];
-    }
-
-    return ((Float_t)sum/(Float_t)(end - start));
+    return BLKernel(&raw[0], start, end);
 }
 
 Int_t g3Waveform::Look4Pileup() {
@@ -259,128 +311,110 @@ Double_t g3Waveform::LSFitExpo(Int_t startIndex, Int_t nPoints,
 			       Double_t &nStartFitError,
 			       Double_t &baselineFitError) {
 
-    /* Levenberg-Marquardt minimization of exponential decay + offset
-       with a fixed tau, to get N0 and baseline (offset) value.
+    /* Least-squares fit of exponential decay + offset with a fixed tau,
+       to get N0 and baseline (offset) value.
 
         Eqn: N(t) = nStart * Exp(-(t-t0)/tau) + baseline
 
-        We will define all matrices as:
-            ( nStart, nStart          nStart, baseline )
-            ( baseline, nStart      baseline, baseline )    */
-
-    /* Set-up starting point for minimization -- starting parameter, lambda... */
-    Double_t baselineStart = nStart - 10;
-    Double_t nStartStart = nStart;
-    Double_t baselineNow, baselineLast;
-    Double_t nStartNow, nStartLast;
-
-    Double_t lambda = 0.001;
-    Double_t chiSqNow, chiSqLast;
-    Double_t alpha[2][2] = {{0.,0.},{0.,0.}};
-    Double_t beta[2] = {0.};
-    Double_t error[2][2] = {{0.,0.},{0.,0.}};
-    Double_t stepping[2] = {0.};
-
-    Int_t notConverged = 1;
-    Int_t iterations = 0;
-
-    baselineNow = baselineStart;
-    nStartNow = nStartStart;
-    chiSqNow = computeChiSquare(startIndex, nPoints, tau,
-			                    nStartNow, baselineNow);
-
-    while(notConverged && iterations < 10) {
-        /* Clear alpha, beta and error arrays */
-        alpha[0][0] = 0.;  alpha[0][1] = 0.;  alpha[1][0] = 0.; alpha[1][1] = 0.;
-        beta[0] = 0.;  beta[1] = 0.;
-        error[0][0] = 0.;  error[0][1] = 0.;  error[1][0] = 0.; error[1][1] = 0.;
-        stepping[0] = 0.;  stepping[1] = 0.;
-
-        /* Compute the curvature matrix and extremum vector first */
-        for(Int_t i = startIndex; i < (startIndex + nPoints); i++) {
-            alpha[0][0] += TMath::Exp(-2*(i - startIndex)/tau);
-            alpha[0][1] += TMath::Exp(-(i - startIndex)/tau);
-            alpha[1][0] += TMath::Exp(-(i - startIndex)/tau);
-            alpha[1][1] += 1.;
-
-            beta[0] += ((raw[i] - (nStartNow*TMath::Exp(-(i - startIndex)/tau)) -
-                baselineNow)*(TMath::Exp(-(i-startIndex)/tau)));
-            beta[1] += ((raw[i] - (nStartNow*TMath::Exp(-(i - startIndex)/tau)) -
-                baselineNow));
-        }
+       This is linear in nStart and baseline, so g3TailFit solves for the
+       minimum directly instead of iterating towards it; the starting
+       value nStart is not needed.  Returns the number of iterations, 1. */
 
-        alpha[0][0] = alpha[0][0]*(1 + lambda);
-        alpha[1][1] = alpha[1][1]*(1 + lambda);
-
-        /* Compute error matrix and stepping vector */
-        error[0][0] = (1/((alpha[0][0]*alpha[1][1]) -
-		      (alpha[0][1]*alpha[0][1])))*alpha[1][1];
-        error[0][1] = (1/((alpha[0][0]*alpha[1][1]) -
-		      (alpha[0][1]*alpha[0][1])))*(-alpha[0][1]);
-        error[1][0] = (1/((alpha[0][0]*alpha[1][1]) -
-		      (alpha[0][1]*alpha[0][1])))*(-alpha[1][0]);
-        error[1][1] = (1/((alpha[0][0]*alpha[1][1]) -
-		      (alpha[0][1]*alpha[0][1])))*alpha[0][0];
-        stepping[0] = error[0][0]*beta[0] + error[0][1]*beta[1];
-        stepping[1] = error[1][0]*beta[0] + error[1][1]*beta[1];
-
-        /* Compute new values for variables */
-        nStartLast = nStartNow;
-        nStartNow = nStartLast + stepping[0];
-        baselineLast = baselineNow;
-        baselineNow = baselineLast + stepping[1];
-        chiSqLast = chiSqNow;
-        chiSqNow = computeChiSquare(startIndex, nPoints, tau,
-				nStartNow, baselineNow);
-
-        /* Evaluate progress... */
-        if(chiSqNow < chiSqLast) {lambda /= 10.;}
-        else {lambda *= 10.; nStartNow = nStartLast; baselineNow = baselineLast;}
-
-        iterations++;
-
-        if((TMath::Abs(stepping[0]) < (0.00001*TMath::Sqrt(error[0][0]))) &&
-	        (TMath::Abs(stepping[1]) < (0.00001*TMath::Sqrt(error[1][1]))) ) {
-            notConverged = 0;
-        }
+    static thread_local g3TailFit fitter;
+    g3TailFit::result r = fitter.Fit(&raw[startIndex], nPoints, tau);
+
+    nStartFit = r.nStart;
+    nStartFitError = r.nStartError;
+    baselineFit = r.baseline;
+    baselineFitError = r.baselineError;
+    return 1;
+}
+
+/**************************************************************/
+
+/* The exp table and inverse curvature matrix for (tau, nPoints), made on
+   first use.  A few are kept -- a tau scan cycles through its list -- and
+   the oldest dropped beyond that */
+const g3TailFit::table& g3TailFit::Table(Double_t tau, Int_t nPoints) {
+    for(size_t k = 0; k < tables.size(); k++) {
+        if(tables[k].tau == tau && tables[k].n == nPoints) { return tables[k]; }
+    }
+    if(tables.size() >= 64) { tables.erase(tables.begin()); }
+
+    table t;
+    t.tau = tau;
+    t.n = nPoints;
+    t.e.resize(nPoints);
+    Double_t s1 = 0., s2 = 0.;
+    for(Int_t k = 0; k < nPoints; k++) {
+        t.e[k] = TMath::Exp(-k/tau);
+        s1 += t.e[k];
+        s2 += t.e[k]*t.e[k];
     }
 
-    /* We're done, get the final answer */
+    /* Curvature matrix ( s2 s1 ; s1 n ), as LSFitExpo had it */
+    Double_t det = s2*nPoints - s1*s1;
+    t.inv00 = nPoints/det;
+    t.inv01 = -s1/det;
+    t.inv11 = s2/det;
 
-    /* Clear alpha, beta and error arrays */
-    alpha[0][0] = 0.;  alpha[0][1] = 0.;  alpha[1][0] = 0.; alpha[1][1] = 0.;
-    beta[0] = 0.;  beta[1] = 0.;
-    error[0][0] = 0.;  error[0][1] = 0.;  error[1][0] = 0.; error[1][1] = 0.;
-    stepping[0] = 0.;  stepping[1] = 0.;
+    tables.push_back(t);
+    return tables.back();
+}
 
-    /* Compute the curvature matrix and extremum vector first */
-    for(Int_t i = startIndex; i < (startIndex + nPoints); i++) {
-        alpha[0][0] += TMath::Exp(-2*(i - startIndex)/tau);
-        alpha[0][1] += TMath::Exp(-(i - startIndex)/tau);
-        alpha[1][0] += TMath::Exp(-(i - startIndex)/tau);
-        alpha[1][1] += 1.;
-
-        beta[0] += ((raw[i] - (nStartNow*TMath::Exp(-(i-startIndex)/tau)) -
-		    baselineNow)*(TMath::Exp(-(i-startIndex)/tau)));
-        beta[1] += ((raw[i] - (nStartNow*TMath::Exp(-(i-startIndex)/tau)) -
-		    baselineNow));
+g3TailFit::result g3TailFit::Solve(const table &t, const Short_t *y) {
+    Double_t sy = 0., sye = 0., syy = 0.;
+    for(Int_t k = 0; k < t.n; k++) {
+        Double_t v = y[k];
+        sy += v;
+        sye += v*t.e[k];
+        syy += v*v;
+    }
+
+    result r;
+    r.nStart = t.inv00*sye + t.inv01*sy;
+    r.baseline = t.inv01*sye + t.inv11*sy;
+    r.nStartError = TMath::Sqrt(t.inv00);
+    r.baselineError = TMath::Sqrt(t.inv11);
+    /* At the minimum, sum (y - fit)^2 = sum y^2 - the fit . (sye, sy) */
+    r.chiSq = syy - r.nStart*sye - r.baseline*sy;
+    return r;
+}
+
+g3TailFit::result g3TailFit::Fit(const Short_t *y, Int_t nPoints, Double_t tau) {
+    return Solve(Table(tau, nPoints), y);
+}
+
+g3TailFit::result g3TailFit::ScanTau(const Short_t *y, Int_t nPoints,
+                                     const std::vector<Double_t> &taus, Double_t &bestTau) {
+    result best = {0., 0., 0., 0., -1.};
+    bestTau = 0.;
+    for(size_t k = 0; k < taus.size(); k++) {
+        result r = Fit(y, nPoints, taus[k]);
+        if(best.chiSq < 0 || r.chiSq < best.chiSq) { best = r;  bestTau = taus[k]; }
     }
+    return best;
+}
+
+void g3TailFit::Clear() {
+    tails.clear();
+    start.clear();
+    batchPoints = 0;
+}
 
-    /* Compute error matrix  */
-    error[0][0] = (1/((alpha[0][0]*alpha[1][1]) -
-		    (alpha[0][1]*alpha[0][1])))*alpha[1][1];
-    error[0][1] = (1/((alpha[0][0]*alpha[1][1]) -
-		    (alpha[0][1]*alpha[0][1])))*(-alpha[0][1]);
-    error[1][0] = (1/((alpha[0][0]*alpha[1][1]) -
-		    (alpha[0][1]*alpha[0][1])))*(-alpha[1][0]);
-    error[1][1] = (1/((alpha[0][0]*alpha[1][1]) -
-		    (alpha[0][1]*alpha[0][1])))*alpha[0][0];
-
-    nStartFit = nStartNow;
-    nStartFitError = TMath::Sqrt(error[0][0]);
-    baselineFit = baselineNow;
-    baselineFitError = TMath::Sqrt(error[1][1]);
-    return iterations;
+void g3TailFit::Add(const std::vector<Short_t> &raw, Int_t startIndex, Int_t nPoints) {
+    start.push_back(tails.size());
+    batchPoints = nPoints;
+    tails.insert(tails.end(), raw.begin() + startIndex, raw.begin() + startIndex + nPoints);
+}
+
+void g3TailFit::Run(Double_t tau) {
+    fit.resize(start.size());
+    if(start.empty()) { return; }
+    const table &t = Table(tau, batchPoints);
+    for(size_t k = 0; k < start.size(); k++) {
+        fit[k] = Solve(t, &tails[start[k]]);
+    }
 }
 
 Double_t g3Waveform::LSFitLinear(Int_t startIndex, Int_t nPoints,
@@ -473,3 +507,114 @@ Float_t g3Waveform::baseline2Flatten(Float_t tau, Int_t startIndexBase,
 
     return baseLow;
 }
+
+/**************************************************************/
+
+UChar_t g3TraceScreen::Check(const Short_t *y, Int_t n, Int_t expected, Bool_t fpgaPileup) {
+    UChar_t flags = 0;
+    if(n < expected) { flags |= TRUNCATED; }
+    if(fpgaPileup) { flags |= PILEUP_FPGA; }
+
+    Int_t atRail = 0;
+    for(Int_t i = 0; i < n; i++) {
+        if(y[i] >= rail || y[i] <= -rail) { atRail++; }
+    }
+    if(atRail >= railSamples) { flags |= SATURATED; }
+
+    if(edge > 0 && edgeGap > 0 && 2*edgeGap <= n) {
+        /* Sums of the edgeGap samples from i and from i + edgeGap, so the
+           noise on their difference is down by sqrt(edgeGap) */
+        Int_t a = 0, b = 0;
+        for(Int_t j = 0; j < edgeGap; j++) { a += y[j];  b += y[j + edgeGap]; }
+        const Int_t high = edge*edgeGap;
+
+        /* 0: before the first edge, 1: on it, 2: after it */
+        Int_t state = 0, quiet = 0;
+        for(Int_t i = 0; ; i++) {
+            Int_t d = b - a;
+            if(state == 0) {
+                if(d > high) { state = 1;  quiet = 0; }
+            } else if(state == 1) {
+                quiet = (2*d < high) ? quiet + 1 : 0;
+                if(quiet >= edgeGap) { state = 2; }
+            } else if(d > high) {
+                flags |= PILEUP;
+                break;
+            }
+            if(i + 2*edgeGap >= n) { break; }
+            a += y[i + edgeGap] - y[i];
+            b += y[i + 2*edgeGap] - y[i + edgeGap];
+        }
+    }
+
+    return flags;
+}
+
+/**************************************************************/
+
+void g3TraceCodec::Encode(const std::vector<Short_t> &raw, std::vector<UChar_t> &packed) {
+    packed.clear();
+    UInt_t n = raw.size();
+    do {
+        packed.push_back((n & 0x7f) | ((n > 0x7f) ? 0x80 : 0));
+        n >>= 7;
+    } while(n > 0);
+
+    UInt_t zz[16];
+    Int_t prev = 0;
+    for(size_t i = 0; i < raw.size(); i += 16) {
+        Int_t count = (raw.size() - i < 16) ? (Int_t)(raw.size() - i) : 16;
+        UInt_t any = 0;
+        for(Int_t k = 0; k < count; k++) {
+            Int_t d = raw[i + k] - prev;
+            prev = raw[i + k];
+            zz[k] = ((UInt_t)d << 1) ^ (UInt_t)(d >> 31);
+            any |= zz[k];
+        }
+        Int_t width = 0;
+        while(any >> width) { width++; }
+        packed.push_back(width);
+
+        /* LSB first, 'count' values of 'width' bits */
+        ULong64_t bits = 0;
+        Int_t nBits = 0;
+        for(Int_t k = 0; k < count; k++) {
+            bits |= (ULong64_t)zz[k] << nBits;
+            nBits += width;
+            while(nBits >= 8) { packed.push_back(bits & 0xff);  bits >>= 8;  nBits -= 8; }
+        }
+        if(nBits > 0) { packed.push_back(bits & 0xff); }
+    }
+}
+
+Bool_t g3TraceCodec::Decode(const std::vector<UChar_t> &packed, std::vector<Short_t> &raw) {
+    size_t p = 0;
+    UInt_t n = 0;
+    for(Int_t shift = 0; ; shift += 7) {
+        if(p >= packed.size() || shift > 28) { raw.clear();  return kFALSE; }
+        n |= (UInt_t)(packed[p] & 0x7f) << shift;
+        if(!(packed[p++] & 0x80)) { break; }
+    }
+
+    raw.resize(n);
+    Int_t prev = 0;
+    for(UInt_t i = 0; i < n; i += 16) {
+        Int_t count = (n - i < 16) ? (Int_t)(n - i) : 16;
+        if(p >= packed.size() || packed[p] > 17) { raw.clear();  return kFALSE; }
+        Int_t width = packed[p++];
+        if(p + (count*width + 7)/8 > packed.size()) { raw.clear();  return kFALSE; }
+
+        ULong64_t bits = 0;
+        Int_t nBits = 0;
+        UInt_t mask = (1u << width) - 1;
+        for(Int_t k = 0; k < count; k++) {
+            while(nBits < width) { bits |= (ULong64_t)packed[p++] << nBits;  nBits += 8; }
+            UInt_t zz = bits & mask;
+            bits >>= width;
+            nBits -= width;
+            prev += (Int_t)(zz >> 1) ^ -(Int_t)(zz & 1);
+            raw[i + k] = (Short_t)prev;
+        }
+    }
+    return kTRUE;
+}
@@ -716,6 +716,22 @@ Float_t g3OUT::calorimeterE() {
   return sum;
 }
 
+/**************************************************************/
+
+/*! Moves the trace of every channel into g3Waveform::packed, so the tree
+    stores it packed -- called before each Fill() with -packTraces
+
+    \return No return value -- fills the packed traces directly
+*/
+
+void g3OUT::PackTraces() {
+  for (UInt_t ui=0; ui<crystalMult(); ui++) {
+    for (UInt_t uj=0; uj<xtals[ui].chn.size(); uj++) {
+      xtals[ui].chn[uj].wf.Pack();
+    }
+  }
+}
+
 /**************************************************************/
 /* g2CrystalEvent Class Functions *****************************/
 /**************************************************************/
@@ -1965,18 +1981,10 @@ Int_t GRETINA::fillShell2Track() {
   Int_t i, j, k, l;
   Float_t sum, segSum[36], ff;
 
-  /* Clear cluster structure... */
-  for (j=0; j<MAXCLUSTERHITS; j++) { track.clust[j].Clear(); }
-  /* Clear shell structure... */
-  for (j=0; j<MAXSHELLHITS; j++) {
-    track.shell.t0[j] = -1.0;
-    track.shell.chiSq[j] = -1.0; track.shell.normChiSq[j] = -1.0;
-    track.shell.timestamp[j] = 0; track.shell.crystalID[j] = -1;
-    track.shell.eDet[j] = -1.0;  track.shell.eSum[j] = -1.0;
-    track.shell.origPos[j] = -1;
-    track.shell.detNum[j] = -1;  track.shell.module[j] = -1;
-    track.shell.crystalType[j] = -1;
-  }
+  /* Clear cluster and shell structures -- only the entries the last
+     event used, the rest are still clear */
+  track.resetClusters();
+  track.shell.Reset();
 
   for (i=0; i<g2out.crystalMult(); i++) {
     if (g2out.xtals[i].error != 0) {
@@ -2019,15 +2027,13 @@ Int_t GRETINA::fillShell2Track() {
       track.shell.t0[k] = g2out.xtals[i].t0;
       track.shell.crystalID[k] = g2out.xtals[i].crystalID;
 
-      track.shell.xyz[k] = rot.crys2Lab(g2out.xtals[i].crystalID,
-					TVector3(g2out.xtals[i].intpts[j].xyz.X(),
-						 g2out.xtals[i].intpts[j].xyz.Y(),
-						 g2out.xtals[i].intpts[j].xyz.Z()));
+      TVector3 xyz = rot.crys2Lab(g2out.xtals[i].crystalID,
+				  TVector3(g2out.xtals[i].intpts[j].xyz.X(),
+					   g2out.xtals[i].intpts[j].xyz.Y(),
+					   g2out.xtals[i].intpts[j].xyz.Z()));
 
       /* Tracking requires cm, not mm */
-      track.shell.xyz[k].SetXYZ(track.shell.xyz[k].X()/10.,
-				track.shell.xyz[k].Y()/10.,
-				track.shell.xyz[k].Z()/10.);
+      track.shell.SetXYZ(k, xyz.X()/10., xyz.Y()/10., xyz.Z()/10.);
 
       /* Tracking requires energy in MeV, not keV */
       if (track.ctrl.useSegEnergy) {
@@ -2047,6 +2053,7 @@ Int_t GRETINA::fillShell2Track() {
     }
   }
   track.shell.nHit = k;
+  track.shell.nUsed = k;
 
   /* Done */
   return (0);
@@ -2171,26 +2178,31 @@ void GRETINA::checkSPIntegrity() {
 
     sp.segEventIndex[xtalNum][segNum] = i;
 
+    /* A screened-out trace was not put into the waves array; leaving it
+       out of the hit pattern keeps the crystal out of the superpulses */
+    if (g3Temp[i].screen) { continue; }
+
     /* The trace was pulled and put into the waves array when
        the GRETINA data was first unpacked. */
 
     sp.trLength = 100;
+    Int_t *wave = sp.Crystal(xtalNum)->waves[segNum];
 
     /* Adjust the trace baseline offset */
     Int_t s = 0;
     for (Int_t b=0; b<25; b++) {
-      s += sp.waves[xtalNum][segNum][b];
+      s += wave[b];
     }
     if (s >= 0) { s = (s+7)/25; }
     else { s = (s-7)/25; }
     for (Int_t b=0; b<sp.trLength; b++) {
-      sp.waves[xtalNum][segNum][b] -= s;
+      wave[b] -= s;
     }
 
     /* Check for net energy */
     Int_t avg = 0;
     for (Int_t b = sp.trLength-10; b<sp.trLength; b++) {
-      avg += TMath::Abs(sp.waves[xtalNum][segNum][b]);
+      avg += TMath::Abs(wave[b]);
     }
     avg /= 10;
 
@@ -2245,6 +2257,10 @@ Int_t GRETINA::getMode3(FILE *inf, Int_t evtLength, counterVariables *cnt,
   }
   cnt->mode3i = 0;
 
+  /* The CFD of the traces is done for the whole record, after the loop */
+  Int_t firstChannel = g3Temp.size();
+  timing.Clear();
+
   remaining = 1;
 
   while (remaining) {
@@ -2287,6 +2303,12 @@ Int_t GRETINA::getMode3(FILE *inf, Int_t evtLength, counterVariables *cnt,
     cnt->mode3i += (sizeof(dp->aahdr) + sizeof(dp->hdr)) / 2;
     tmp = (gBuf + cnt->mode3i*2);
 
+    /* Samples of this trace actually in the record */
+    Int_t inRecord = evtLength/2 - (Int_t)cnt->mode3i;
+    if (inRecord > TL) { inRecord = TL; }
+    if (inRecord < 0) { inRecord = 0; }
+    g3ch.screen = 0;
+
     /* Copy the waveform! */
     memmove(&dp->waveform[0], tmp, TL*sizeof(UShort_t));
 
@@ -2458,14 +2480,32 @@ Int_t GRETINA::getMode3(FILE *inf, Int_t evtLength, counterVariables *cnt,
       /* For the CC always get a baseline value from the minimum trace, which is 6 samples. */
       if (g3ch.wf.raw.size() >= 6) {  g3ch.baseline = g3ch.wf.BL(0, 6);  }
 
-      g3ch.calcTime = g3ch.wf.CFD(0);
+      /* Piled-up, saturated or truncated traces go no further; raw holds
+	 two samples past the trace, which are not looked at */
+      if (ctrl->screenTraces) {
+	g3ch.screen = screen.Check(g3ch.wf.raw.data(), inRecord, TL, g3ch.pileUp());
+	cnt->screenChecked++;
+	if (g3ch.screen) {
+	  cnt->screenFlagged++;
+	  if (g3ch.screen & g3TraceScreen::TRUNCATED) { cnt->screenTruncated++; }
+	  if (g3ch.screen & g3TraceScreen::SATURATED) { cnt->screenSaturated++; }
+	  if (g3ch.screen & g3TraceScreen::PILEUP_FPGA) { cnt->screenPileupFPGA++; }
+	  if (g3ch.screen & g3TraceScreen::PILEUP) { cnt->screenPileup++; }
+	  cnt->screenSkippedSamples += g3ch.wf.raw.size();
+	}
+      }
+
+      if (!g3ch.screen) { timing.Add(g3ch.wf.raw, g3Temp.size()); }
 
     }
 
     if (ctrl->withWAVE) {
-      if (ctrl->superPulse) {
+      if (ctrl->superPulse && g3ch.screen) {
+	cnt->screenSkippedSP++;
+      } else if (ctrl->superPulse) {
+	Int_t *wave = sp.Crystal((Int_t)(g3ch.ID/40))->waves[sp.map[(Int_t)(g3ch.ID/40)][(Int_t)(g3ch.ID%40)]];
 	for (Int_t j=0; j<sp.trLength; j++) {
-	  sp.waves[(Int_t)(g3ch.ID/40)][sp.map[(Int_t)(g3ch.ID/40)][(Int_t)(g3ch.ID%40)]][j] = g3ch.wf.raw[j];
+	  wave[j] = g3ch.wf.raw[j];
 	}
       }
     }
@@ -2490,6 +2530,17 @@ Int_t GRETINA::getMode3(FILE *inf, Int_t evtLength, counterVariables *cnt,
 
     if ( (Int_t)(cnt->mode3i*2) == evtLength ) { remaining = 0; }
     else if ( (Int_t)(cnt->mode3i*2) < evtLength ) { remaining = 1; }
+    else { remaining = 0; } /* Last trace truncated */
+  }
+
+  /* Channels without a trace keep the time of the channel before, as
+     they did when g3ch.calcTime was set in the loop; screened-out traces
+     get the no-crossing time of the CFD */
+  timing.Run(0);
+  Int_t k = 0;
+  for (UInt_t ui=firstChannel; ui<g3Temp.size(); ui++) {
+    if (k < timing.size() && timing.tag[k] == (Int_t)ui) { g3ch.calcTime = timing.cfd[k++]; }
+    g3Temp[ui].calcTime = (g3Temp[ui].screen) ? -10 : g3ch.calcTime;
   }
 
   return (0);
@@ -3052,6 +3103,7 @@ Int_t GRETINA::getBank88(FILE *inf, Int_t evtLength, counterVariables *cnt) {
 
     /* We've got the data packet, pull out information */
     g3ch.Clear();
+    g3ch.screen = 0;
 
     /* Interpret the header information */
     g3ch.hdr0 = dp->hdr[0];  g3ch.hdr1 = dp->hdr[1];
@@ -33,6 +33,8 @@ GRETINAWF::GRETINAWF() {
     restingBase[i] = 0;
     baseSamples[i] = 0;
     tau[i] = 0;
+    expcorrTau[i] = 0;
+    anlDecay[i] = 0;  anlDecayTau[i] = 0;  anlDecayMK[i] = -1;
     baseline[i] = 0;
     sa[i] = 0; sb[i] = 0; sc[i] = 0;
     sd[i] = 0; se[i] = 0;
@@ -138,19 +140,21 @@ Int_t GRETINAWF::ANLBaseCal(Int_t T, Int_t cNum, Int_t chNum) {
 /****************************************************/
 
 Double_t GRETINAWF::ANLEnergy1(Int_t T, Int_t id, Int_t cNum, Int_t chNum) {
-  Double_t v[1024] = {0.}, s1=0., s2=0., e;
+  Double_t v=0., s1=0., s2=0., e;
   Int_t i=0;
-  
-  v[0] = (Double_t)waveform2Out[cNum][chNum][0];
-  for (i=1; i<1024; i++) {
-    v[i] = ((Double_t)v[i-1] + (Double_t)waveform2Out[cNum][chNum][i] - 
-	    (Double_t)waveform2Out[cNum][chNum][i-1]);
-    v[i] += (((Double_t)waveform2Out[cNum][chNum][i] - baseline[id])/
-	     (Double_t)tau[id]);
-  }
-  for (i = T + eFilterK; i < T + eFilterM + eFilterK; i++) {
-    s1 += v[i - eFilterM - eFilterK];
-    s2 += v[i];
+  const std::vector<Short_t> &w = waveform2Out[cNum][chNum];
+
+  /* Each v[i] is used once, in order, up to the end of the second sum,
+     so it is not kept: s1 sums v[T-M..T-1], s2 v[T+K..T+M+K-1] */
+  for (i=0; i < T + eFilterM + eFilterK; i++) {
+    if (i == 0) {
+      v = (Double_t)w[0];
+    } else {
+      v = (v + (Double_t)w[i] - (Double_t)w[i-1]);
+      v += (((Double_t)w[i] - baseline[id])/(Double_t)tau[id]);
+    }
+    if (i >= T - eFilterM && i < T) { s1 += v; }
+    if (i >= T + eFilterK) { s2 += v; }
   }
   e = (s2 - s1) / (Double_t)eFilterM * 3.0;
   return e;
@@ -158,18 +162,31 @@ Double_t GRETINAWF::ANLEnergy1(Int_t T, Int_t id, Int_t cNum, Int_t chNum) {
 
 /****************************************************/
 
+/* exp(-(M+K)/tau[id]), made again only if tau or M+K change */
+Double_t GRETINAWF::ANLDecay(Int_t id) {
+  if (anlDecayMK[id] != eFilterM + eFilterK || anlDecayTau[id] != tau[id]) {
+    anlDecay[id] = (Double_t)exp(-(Double_t)(eFilterM + eFilterK)/(Double_t)tau[id]);
+    anlDecayMK[id] = eFilterM + eFilterK;
+    anlDecayTau[id] = tau[id];
+  }
+  return anlDecay[id];
+}
+
 Double_t GRETINAWF::ANLEnergy2(Int_t T, Int_t id, Int_t cNum, Int_t chNum) {
-  Double_t s1=0., s2=0., s3=0.;
+  Double_t s1=0., s2=0.;
   Double_t e, c;
   Int_t i=0;
-  
-  c = (Double_t)exp(-(Double_t)(eFilterM + eFilterK)/(Double_t)tau[id]);
-  for (i = T; i < T + eFilterM + eFilterK; i++) {
-    s1 += (Double_t)waveform2Out[cNum][chNum][i - eFilterM - eFilterK] - baseline[id];
-    s2 += (Double_t)waveform2Out[cNum][chNum][i] - baseline[id];
+  Int_t n = eFilterM + eFilterK;
+  const Short_t *w = &waveform2Out[cNum][chNum][0];
+
+  /* The third sum, M*s3/tau, was never filled (s3 stayed 0) and is left
+     out; the decay comes from the per-channel cache */
+  c = ANLDecay(id);
+  for (i = T; i < T + n; i++) {
+    s1 += (Double_t)w[i - n] - baseline[id];
+    s2 += (Double_t)w[i] - baseline[id];
   }
-  e = ((s2 - s1*c + (Double_t)eFilterM*s3/(Double_t)tau[id]) / 
-       (Double_t)eFilterM*3.0);
+  e = (s2 - s1*c) / (Double_t)eFilterM*3.0;
   return e;
 }
 
@@ -788,6 +805,20 @@ GRETINAWF::linfit GRETINAWF::LinReg(Double_t *trace, Int_t startReg, Int_t stopR
   return mbs;
 }
 
+/* exp(n/tau[id]) for n < tracelength, made on the first call for a
+   channel and again only if its tau or the trace length change */
+const Double_t* GRETINAWF::ExpCorrection(Int_t id) {
+  std::vector<Double_t> &e = expcorr[id];
+  if ((Int_t)e.size() != tracelength || expcorrTau[id] != tau[id]) {
+    e.resize(tracelength);
+    for (Int_t nn=0; nn<tracelength; nn++) {
+      e[nn] = exp((Double_t)nn/(Double_t)tau[id]);
+    }
+    expcorrTau[id] = tau[id];
+  }
+  return e.data();
+}
+
 GRETINAWF::peak GRETINAWF::GregorichTrapFilter(Int_t id, Int_t cNum, Int_t chNum) {
   /* Processes the trace and fills a structure with info:
      peak.amp contains amplitude of the largest peak
@@ -799,12 +830,16 @@ GRETINAWF::peak GRETINAWF::GregorichTrapFilter(Int_t id, Int_t cNum, Int_t chNum
   Int_t basestart = 0; // first sample for baseline search (no pulse!)
   Int_t basestop = 300;  // lase sample for baseline search
 
-  Double_t tracetrap[tracelength];
-  Double_t peak[tracelength];
-  
-  Double_t expcorr[tracelength];
-  Double_t tracecor1[tracelength];
-  Double_t tracecor2[tracelength];
+  /* The trace corrected for the decay is made twice, before and after
+     the baseline is known, in the same buffer */
+  if ((Int_t)trapScratch.size() < 3*tracelength) { trapScratch.resize(3*tracelength); }
+  Double_t *tracetrap = &trapScratch[0];
+  Double_t *peak = tracetrap + tracelength;
+  Double_t *tracecor1 = peak + tracelength;
+  Double_t *tracecor2 = tracecor1;
+
+  const Double_t *expcorr = ExpCorrection(id);
+  const Short_t *wave = &waveform2Out[cNum][chNum][0];
 
   Int_t startn;
   Int_t stopn;
@@ -830,12 +865,12 @@ GRETINAWF::peak GRETINAWF::GregorichTrapFilter(Int_t id, Int_t cNum, Int_t chNum
     peak[nn] = 0;
   }
 
-  /* Correct trace for exponential decay. */
-  for (nn=0; nn<tracelength; nn++) {
-    expcorr[nn] = exp((Double_t)nn/(Double_t)tau[id]);
-    tracecor1[nn] = (Double_t)waveform2Out[cNum][chNum][nn]*expcorr[nn];
+  /* Correct trace for exponential decay -- the baseline fit needs only
+     its start */
+  for (nn=0; nn<tracelength && nn<=basestop; nn++) {
+    tracecor1[nn] = (Double_t)wave[nn]*expcorr[nn];
   }
-  
+
   /* Baseline determination */
   baseline = LinReg(tracecor1, basestart, basestop);  
   result.base = (Int_t)(baseline.m*(Double_t)tau[id]*exp(((Double_t)basestart+
@@ -844,7 +879,7 @@ GRETINAWF::peak GRETINAWF::GregorichTrapFilter(Int_t id, Int_t cNum, Int_t chNum
   
   /* Subtract baseline */
   for (nn=0; nn<tracelength; nn++) {
-    tracecor2[nn] = ((Double_t)waveform2Out[cNum][chNum][nn]-result.base)*expcorr[nn]; 
+    tracecor2[nn] = ((Double_t)wave[nn]-result.base)*expcorr[nn];
   }
 
   startn = eFilterM + halfgap - 1;
@@ -913,49 +948,103 @@ void GRETINAWF::PoleZeroTrace(Int_t id, Int_t cNum, Int_t chNum) {
 /*****************************************************************/
 
 Float_t GRETINAWF::FPGAFilter(Int_t id, Int_t cNum, Int_t chNum) {
-  Double_t e = 0;
-  Double_t baseline[20] = {0};
-  Double_t averagebaseline = 0;
+  /* The baseline is not subtracted, so the trace is used as it is.
+     trap[j] and pz[j] start at sample eFilterM-1; only the last two trap
+     values are needed, and pz only at 275 and 500, so nothing is
+     stored.  The first step needs trap[-1], which the vector version
+     read from before the start of its storage (undefined); it is 0 here,
+     so the first trapezoid value is the first difference. */
+  const Short_t *wave = &waveform2Out[cNum][chNum][0];
   Double_t pzSum = 0;
-  
-  std::vector<Double_t> wave;
-  std::vector<Double_t> pz;
-  std::vector<Double_t> trap;
-  
-  for (UInt_t uj=0; uj<20; uj++) {
-    baseline[uj] = waveform2Out[cNum][chNum][uj];
-    averagebaseline += baseline[uj];
+  Double_t trap1 = (Double_t)wave[eFilterM - 1]; /* trap[j-1] */
+  Double_t trap2 = 0;                            /* trap[j-2] */
+  Double_t pz275 = 0, pz500 = 0;
+
+  for (Int_t index = eFilterM; index < tracelength; index++) {
+    Int_t j = index - eFilterM + 1;
+    double scratch = ( ((Double_t)wave[index]) -
+		       ((Double_t)wave[index - eFilterM]) -
+		       ((index >= eFilterM + eFilterK) ?
+			((Double_t)wave[index - eFilterM - eFilterK]):0.0) +
+		       ((index >= 2*eFilterM + eFilterK) ?
+			((Double_t)wave[index - 2*eFilterM - eFilterK]):0.0) );
+    Double_t trap = trap2 + scratch;
+    pzSum += trap;
+    if (j == 275) { pz275 = trap1 + (pzSum)/tau[id]; }
+    if (j == 500) { pz500 = trap1 + (pzSum)/tau[id];  break; }
+    trap2 = trap1;
+    trap1 = trap;
   }
-  averagebaseline /= 20;
-  
-  averagebaseline = 0;
-  
-  for (Int_t j=0; j<tracelength; j++) {
-    wave.push_back(waveform2Out[cNum][chNum][j] - averagebaseline);
+
+  return (pz500 - pz275)/32;
+}
+
+/*****************************************************************/
+/* trapFilterBank                                                */
+/*****************************************************************/
+
+void trapFilterBank::Setup(Int_t rise, Int_t flat, Int_t length, Int_t nChannels, const Float_t *tau) {
+  k = rise;
+  l = rise + flat;
+  nCh = nChannels;
+  this->length = length;
+
+  x.assign((size_t)nCh*length, 0);
+  mPZ.resize(nCh);
+  gain.resize(nCh);
+  p.resize(nCh);
+  s.resize(nCh);
+  energy.resize(nCh);
+  maximum.resize(nCh);
+
+  /* The pole-zero stage turns a pulse A*exp(-n/tau) into a step of
+     A*(M+1), which the trapezoid sums over 'rise' samples */
+  for (Int_t ch=0; ch<nCh; ch++) {
+    mPZ[ch] = 1./(exp(1./(Double_t)tau[ch]) - 1.);
+    gain[ch] = 1./((Double_t)k*(mPZ[ch] + 1.));
   }
-  
-  pz.push_back((tau[id] + 1)*(wave[eFilterM - 1]));
-  trap.push_back((wave[eFilterM - 1]));
-  
-  for (Int_t index = eFilterM; index < (Int_t)wave.size(); index++) {
-    double scratch = ( (wave[index]) - 
-		       ((index >= eFilterM) ? (wave[index - eFilterM]):0.0) -
-		       ((index >= eFilterM + eFilterK) ? 
-			(wave[index - eFilterM - eFilterK]):0.0) +
-		       ((index >= 2*eFilterM + eFilterK) ? 
-			(wave[index - 2*eFilterM - eFilterK]):0.0) );
-    trap.push_back(trap[index - eFilterM - 1] + scratch);
-    pzSum += trap[trap.size() - 1];
-    pz.push_back(trap[index - eFilterM] + (pzSum)/tau[id]);
+}
+
+void trapFilterBank::Load(Int_t ch, const std::vector<Short_t> &trace) {
+  Int_t n = ((Int_t)trace.size() < length) ? (Int_t)trace.size() : length;
+  Int_t *xc = &x[ch];
+  for (Int_t i=0; i<n; i++) { xc[(size_t)i*nCh] = trace[i]; }
+  Int_t last = (n > 0) ? trace[n-1] : 0;
+  for (Int_t i=n; i<length; i++) { xc[(size_t)i*nCh] = last; }
+}
+
+void trapFilterBank::Run(Int_t pick) {
+  const Double_t *ms = &mPZ[0], *gs = &gain[0];
+  Double_t *ss = &s[0], *mx = &maximum[0];
+  Int_t *ps = &p[0];
+
+  for (Int_t ch=0; ch<nCh; ch++) {
+    ps[ch] = 0;
+    ss[ch] = 0.;
+    mx[ch] = 0.;
+    energy[ch] = 0.;
+  }
+
+  /* Rows before sample 0 repeat sample 0: a flat baseline, d = 0 */
+  for (Int_t n=0; n<length; n++) {
+    const Int_t *x0 = &x[(size_t)n*nCh];
+    const Int_t *x1 = &x[(size_t)((n-k > 0) ? n-k : 0)*nCh];
+    const Int_t *x2 = &x[(size_t)((n-l > 0) ? n-l : 0)*nCh];
+    const Int_t *x3 = &x[(size_t)((n-k-l > 0) ? n-k-l : 0)*nCh];
+
+    /* d is the trapezoid difference, p its running sum, s the running
+       sum of p with the pole-zero correction M*d */
+    for (Int_t ch=0; ch<nCh; ch++) {
+      Int_t d = x0[ch] - x1[ch] - x2[ch] + x3[ch];
+      ps[ch] += d;
+      ss[ch] += (Double_t)ps[ch] + ms[ch]*(Double_t)d;
+      Double_t e = ss[ch]*gs[ch];
+      mx[ch] = (e > mx[ch]) ? e : mx[ch];
+    }
+    if (n == pick) {
+      for (Int_t ch=0; ch<nCh; ch++) { energy[ch] = ss[ch]*gs[ch]; }
+    }
   }
-  
-  e = (pz[500] - pz[275])/32;
-  
-  pz.clear();
-  trap.clear();
-  wave.clear();
-	    
-  return e;	
 }
 
 /*****************************************************************/
@@ -0,0 +1,357 @@
+/* goddessGen: writes a synthetic run, ORRUBA .ldf and GEB Global.dat, for
+   load-testing goddessSort and unpackGRETINA at rates we do not have data
+   for.
+
+   ./goddessGen [-o <dir>] [-prefix <p>] [-ldfPrefix <p>] [-run <name>]
+                [-seed S] [-events N] [-rate Hz] [-gretinaRate Hz]
+                [-coincidence f] [-mult M] [-siMult M] [-mode2] [-mode3]
+                [-traceLength L] [-s800 f] [-bank88 f] [-disorder ticks]
+
+   The files go where RunList looks for them with the same config.json
+   settings:  <dir><prefix><run>/<ldfPrefix><run>.ldf  and
+              <dir><prefix><run>/Global.dat
+
+   Timing, in 10 ns ticks as in the data:
+     - ORRUBA events arrive at -rate (Poisson), -events of them;
+     - a fraction -coincidence of them have a GRETINA event within
+       +-300 ticks (inside Unpack's timeThreshold);
+     - GRETINA singles arrive independently at -gretinaRate;
+     - a GRETINA event has Poisson(-mult) crystals (at least one), within
+       20 ticks of each other, written as mode2 (DECOMP) records, mode3
+       (RAW) records -- central contact plus 1-3 segments per crystal, one
+       record per crystal -- or both;
+     - a fraction -s800 / -bank88 of GRETINA events also get an S800 /
+       Bank88 record.
+   GEB records are written in time order unless -disorder D is given; then
+   each record is moved by up to D ticks later in the file, as the global
+   event builder does when its sources lag.
+
+   Everything is drawn from one TRandom3 seeded with -seed, so the same
+   options give the same bytes.  Crystals are those of the holes in
+   gretina.set, read from the current directory. */
+
+#include "GRETINA.h"
+#include "SyntheticData.h"
+#include "Utilities.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+struct genOptions {
+    std::string dir;
+    std::string prefix;
+    std::string ldfPrefix;
+    std::string run;
+    UInt_t seed;
+    Long64_t events;
+    Double_t rate;
+    Double_t gretinaRate;
+    Double_t coincidence;
+    Double_t mult;
+    Double_t siMult;
+    Bool_t mode2;
+    Bool_t mode3;
+    Int_t traceLength;
+    Double_t s800;
+    Double_t bank88;
+    Long64_t disorder;
+};
+
+struct genCounters {
+    Long64_t orrubaEvents;
+    Long64_t ldfBuffers;
+    Long64_t gretinaEvents;
+    Long64_t coincidences;
+    Long64_t records[64];
+    Long64_t gebBytes;
+};
+
+struct gebRecord {
+    Int_t type;
+    Long64_t timestamp;
+    std::vector<UChar_t> payload;
+};
+
+/* GEB records not written yet, keyed by their place in the file */
+typedef std::multimap<Long64_t, gebRecord> gebQueue;
+
+class Generator {
+public:
+    Generator(const genOptions &opt, const std::vector<Int_t> &holes);
+
+    /* Returns false on a write error */
+    Bool_t Run(FILE *ldf, FILE *geb);
+
+    genCounters cnt;
+
+private:
+    void GRETINAEvent(Long64_t ts);
+    void Queue(Int_t type, Long64_t ts, std::vector<UChar_t> &payload);
+    Bool_t Flush(FILE *geb, Long64_t before);
+    Int_t Poisson(Double_t mean, Int_t atLeast);
+
+    genOptions opt;
+    std::vector<Int_t> holes;
+    SyntheticData syn;
+    gebQueue queue;
+};
+
+Generator::Generator(const genOptions &opt, const std::vector<Int_t> &holes)
+    : opt(opt), holes(holes), syn(opt.seed) {
+    memset(&cnt, 0, sizeof(cnt));
+}
+
+Int_t Generator::Poisson(Double_t mean, Int_t atLeast) {
+    Int_t n = syn.rand.Poisson(mean);
+    return (n < atLeast) ? atLeast : n;
+}
+
+void Generator::Queue(Int_t type, Long64_t ts, std::vector<UChar_t> &payload) {
+    Long64_t key = ts;
+    if(opt.disorder > 0) { key += (Long64_t)syn.rand.Integer(opt.disorder + 1); }
+    gebQueue::iterator it = queue.insert(std::make_pair(key, gebRecord()));
+    it->second.type = type;
+    it->second.timestamp = ts;
+    it->second.payload.swap(payload);  /* leaves 'payload' empty for the next one */
+}
+
+/* Every record queued from now on has a key >= its timestamp >= 'before',
+   so the ones below it are final */
+Bool_t Generator::Flush(FILE *geb, Long64_t before) {
+    gebQueue::iterator it = queue.begin();
+    while(it != queue.end() && it->first < before) {
+        const gebRecord &r = it->second;
+        Int_t n = SyntheticData::WriteGEB(geb, r.type, r.timestamp, r.payload);
+        if(n < 0) { return false; }
+        cnt.gebBytes += n;
+        cnt.records[r.type & 63]++;
+        queue.erase(it++);
+    }
+    return true;
+}
+
+void Generator::GRETINAEvent(Long64_t ts) {
+    cnt.gretinaEvents++;
+
+    Int_t nCrystals = holes.size()*4;
+    Int_t mult = Poisson(opt.mult, 1);
+    if(mult > nCrystals) { mult = nCrystals; }
+
+    std::vector<Int_t> used;
+    while((Int_t)used.size() < mult) {
+        Int_t c = syn.rand.Integer(nCrystals);
+        Bool_t dup = false;
+        for(size_t i = 0; i < used.size(); i++) { dup = dup || (used[i] == c); }
+        if(!dup) { used.push_back(c); }
+    }
+
+    std::vector<UChar_t> payload;
+    for(Int_t i = 0; i < mult; i++) {
+        Int_t hole = holes[used[i]/4];
+        Int_t crystal = used[i]%4;
+        Long64_t t = ts + syn.rand.Integer(20);
+        Float_t energy = syn.rand.Uniform(100, 3000);
+
+        if(opt.mode2) {
+            syn.Mode2(payload, hole*4 + crystal, t, energy, 1 + syn.rand.Integer(4));
+            Queue(DECOMP, t, payload);
+        }
+        if(opt.mode3) {
+            /* Digitizer modules hole*16 + crystal*4 + 0..3, the central
+               contact is channel 9 of the last one */
+            Int_t module = hole*16 + crystal*4;
+            syn.Mode3(payload, module + 3, 9, t, energy, opt.traceLength);
+            Int_t nSeg = 1 + syn.rand.Integer(3);
+            for(Int_t s = 0; s < nSeg; s++) {
+                syn.Mode3(payload, module + syn.rand.Integer(4), syn.rand.Integer(9), t,
+                          energy/nSeg, opt.traceLength);
+            }
+            Queue(RAW, t, payload);
+        }
+    }
+
+    if(opt.s800 > 0 && syn.rand.Uniform() < opt.s800) {
+        syn.S800Event(payload, ts + 50);
+        Queue(S800, ts + 50, payload);
+    }
+    if(opt.bank88 > 0 && syn.rand.Uniform() < opt.bank88) {
+        syn.Mode3(payload, 0, syn.rand.Integer(10), ts + 10, syn.rand.Uniform(100, 3000),
+                  opt.traceLength);
+        Queue(BANK88, ts + 10, payload);
+    }
+}
+
+Bool_t Generator::Run(FILE *ldf, FILE *geb) {
+    Double_t orrubaTicks = 1e8/opt.rate;
+    Double_t gretinaTicks = (opt.gretinaRate > 0) ? 1e8/opt.gretinaRate : 0;
+
+    Long64_t ts = 1000000;
+    Long64_t nextSingle = ts + (gretinaTicks > 0 ? (Long64_t)syn.rand.Exp(gretinaTicks) : 0);
+    std::vector<UInt_t> words;
+
+    for(Long64_t i = 0; i < opt.events; i++) {
+        ts += 1 + (Long64_t)syn.rand.Exp(orrubaTicks);
+
+        while(gretinaTicks > 0 && nextSingle < ts) {
+            GRETINAEvent(nextSingle);
+            nextSingle += 1 + (Long64_t)syn.rand.Exp(gretinaTicks);
+        }
+
+        syn.ORRUBAEvent(words, ts, Poisson(opt.siMult, 1));
+        cnt.orrubaEvents++;
+        if(syn.rand.Uniform() < opt.coincidence) {
+            GRETINAEvent(ts + (Long64_t)syn.rand.Integer(601) - 300);
+            cnt.coincidences++;
+        }
+
+        /* Coincident records may sit 300 ticks before ts */
+        if(!Flush(geb, ts - 300)) { return false; }
+        if(words.size() > 64*8192) {
+            Int_t n = syn.WriteLDF(ldf, words);
+            if(n < 0) { return false; }
+            cnt.ldfBuffers += n;
+            words.clear();
+        }
+    }
+
+    Int_t n = syn.WriteLDF(ldf, words);
+    if(n < 0) { return false; }
+    cnt.ldfBuffers += n;
+    return Flush(geb, ts + opt.disorder + 1000);
+}
+
+/****************************************************/
+
+static void PrintUsage() {
+    std::cout << "goddessGen [options]" << std::endl;
+    std::cout << "  -o <dir>           pathToFolders to write into (default ./data/)" << std::endl;
+    std::cout << "  -prefix <p>        pathPrefix (default none)" << std::endl;
+    std::cout << "  -ldfPrefix <p>     ldfPrefix (default run)" << std::endl;
+    std::cout << "  -run <name>        run name (default 001)" << std::endl;
+    std::cout << "  -seed S            random seed (default 4357)" << std::endl;
+    std::cout << "  -events N          ORRUBA events (default 100000)" << std::endl;
+    std::cout << "  -rate Hz           ORRUBA event rate (default 1000)" << std::endl;
+    std::cout << "  -gretinaRate Hz    GRETINA singles rate (default 5000)" << std::endl;
+    std::cout << "  -coincidence f     fraction of ORRUBA events with GRETINA (default 0.5)" << std::endl;
+    std::cout << "  -mult M            mean crystals per GRETINA event (default 2)" << std::endl;
+    std::cout << "  -siMult M          mean silicon channels per ORRUBA event (default 3)" << std::endl;
+    std::cout << "  -mode2, -mode3     GRETINA record types (default -mode2)" << std::endl;
+    std::cout << "  -traceLength L     mode3/Bank88 trace samples (default 200)" << std::endl;
+    std::cout << "  -s800 f            fraction of GRETINA events with an S800 record (default 0)" << std::endl;
+    std::cout << "  -bank88 f          fraction of GRETINA events with a Bank88 record (default 0)" << std::endl;
+    std::cout << "  -disorder D        move GEB records up to D ticks later in the file (default 0)" << std::endl;
+}
+
+static Bool_t MakeDir(const std::string &path) {
+    for(size_t i = 1; i <= path.size(); i++) {
+        if(i == path.size() || path[i] == '/') {
+            std::string sub = path.substr(0, i);
+            if(mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST) { return false; }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    genOptions opt;
+    opt.dir = "./data/";
+    opt.prefix = "";
+    opt.ldfPrefix = "run";
+    opt.run = "001";
+    opt.seed = 4357;
+    opt.events = 100000;
+    opt.rate = 1000;
+    opt.gretinaRate = 5000;
+    opt.coincidence = 0.5;
+    opt.mult = 2;
+    opt.siMult = 3;
+    opt.mode2 = false;
+    opt.mode3 = false;
+    opt.traceLength = 200;
+    opt.s800 = 0;
+    opt.bank88 = 0;
+    opt.disorder = 0;
+
+    for(Int_t i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) { opt.dir = argv[++i]; }
+        else if(strcmp(argv[i], "-prefix") == 0 && i + 1 < argc) { opt.prefix = argv[++i]; }
+        else if(strcmp(argv[i], "-ldfPrefix") == 0 && i + 1 < argc) { opt.ldfPrefix = argv[++i]; }
+        else if(strcmp(argv[i], "-run") == 0 && i + 1 < argc) { opt.run = argv[++i]; }
+        else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) { opt.seed = strtoul(argv[++i], NULL, 0); }
+        else if(strcmp(argv[i], "-events") == 0 && i + 1 < argc) { opt.events = atoll(argv[++i]); }
+        else if(strcmp(argv[i], "-rate") == 0 && i + 1 < argc) { opt.rate = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-gretinaRate") == 0 && i + 1 < argc) { opt.gretinaRate = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-coincidence") == 0 && i + 1 < argc) { opt.coincidence = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-mult") == 0 && i + 1 < argc) { opt.mult = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-siMult") == 0 && i + 1 < argc) { opt.siMult = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-mode2") == 0) { opt.mode2 = true; }
+        else if(strcmp(argv[i], "-mode3") == 0) { opt.mode3 = true; }
+        else if(strcmp(argv[i], "-traceLength") == 0 && i + 1 < argc) { opt.traceLength = atoi(argv[++i]); }
+        else if(strcmp(argv[i], "-s800") == 0 && i + 1 < argc) { opt.s800 = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-bank88") == 0 && i + 1 < argc) { opt.bank88 = atof(argv[++i]); }
+        else if(strcmp(argv[i], "-disorder") == 0 && i + 1 < argc) { opt.disorder = atoll(argv[++i]); }
+        else { PrintUsage(); return 1; }
+    }
+    if(!opt.mode2 && !opt.mode3) { opt.mode2 = true; }
+    if(opt.rate <= 0 || opt.events < 1) { PrintUsage(); return 1; }
+    if(opt.disorder < 0) { opt.disorder = 0; }
+
+    GRETINAVariables var;
+    var.Initialize();
+    var.InitializeGRETINAVariables("gretina.set");
+    std::vector<Int_t> holes;
+    for(Int_t q = 0; q < MAXQUADS; q++) {
+        if(var.hole[q] >= 0) { holes.push_back(var.hole[q]); }
+    }
+    if(holes.empty()) {
+        std::cerr << PrintOutput("No holes in gretina.set", "red") << std::endl;
+        return 1;
+    }
+
+    std::string runDir = opt.dir + opt.prefix + opt.run;
+    std::string ldfPath = runDir + '/' + opt.ldfPrefix + opt.run + ".ldf";
+    std::string gebPath = runDir + "/Global.dat";
+    if(!MakeDir(runDir)) {
+        std::cerr << PrintOutput("Cannot create " + runDir, "red") << std::endl;
+        return 1;
+    }
+
+    FILE *ldf = fopen(ldfPath.c_str(), "wb");
+    FILE *geb = fopen(gebPath.c_str(), "wb");
+    if(!ldf || !geb) {
+        std::cerr << PrintOutput("Cannot open output files in " + runDir, "red") << std::endl;
+        return 1;
+    }
+
+    std::cout << PrintOutput("Writing " + ldfPath + " and " + gebPath, "blue") << std::endl;
+
+    Generator gen(opt, holes);
+    Bool_t ok = gen.Run(ldf, geb);
+    fclose(ldf);
+    fclose(geb);
+    if(!ok) {
+        std::cerr << PrintOutput("Write error in " + runDir, "red") << std::endl;
+        return 1;
+    }
+
+    const genCounters &c = gen.cnt;
+    Double_t seconds = opt.events/opt.rate;
+    printf("  ORRUBA events    %12lld  (%lld buffers)\n", c.orrubaEvents, c.ldfBuffers);
+    printf("  GRETINA events   %12lld  (%lld with ORRUBA)\n", c.gretinaEvents, c.coincidences);
+    printf("  mode2 records    %12lld\n", c.records[DECOMP]);
+    printf("  mode3 records    %12lld\n", c.records[RAW]);
+    printf("  S800 records     %12lld\n", c.records[S800]);
+    printf("  Bank88 records   %12lld\n", c.records[BANK88]);
+    printf("  Global.dat       %12.1f MB\n", c.gebBytes/(1024.*1024.));
+    printf("  run length       %12.1f s (%.0f GEB records/s)\n", seconds,
+           (c.records[DECOMP] + c.records[RAW] + c.records[S800] + c.records[BANK88])/seconds);
+
+    return 0;
+}
@@ -0,0 +1,875 @@
+/* goddessBench: microbenchmarks for the hot kernels, on synthetic input.
+
+   make bench          all kernels, compared with bench_baseline.txt if present
+   make bench-save     all kernels, saved as the new bench_baseline.txt
+
+   ./goddessBench [-events N] [-reps R] [-only <name>] [-save <file>]
+                  [-compare <file>]
+
+   The kernels are run through the real code (UnpackORRUBA,
+   GRETINA::getMode2, ...) on input made by SyntheticData with fixed seeds,
+   so every run sees the same bytes.  Each kernel is run 'reps' times and the
+   fastest pass is reported, in ns per event: per GEB record for getMode2 and
+   getMode3, per trace for the waveform kernels, per ORRUBA timestamp for
+   the merge match.  The check column is a sum over the kernel's results --
+   if it moves, the kernel no longer computes the same thing.
+
+   Run it from the top directory: gretina.set, crmat.dat, track.chat and
+   config.json are read from there, as unpackGRETINA and goddessSort do. */
+
+#include "GRETINA.h"
+#include "GRETINAWavefunction.h"
+#include "S800Parameters.h"
+#include "SortingStructures.h"
+#include "SyntheticData.h"
+#include "Unpack.h"
+#include "UnpackORRUBA.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+
+#include <TFile.h>
+#include <TTree.h>
+
+typedef std::chrono::steady_clock benchClock;
+
+struct benchResult {
+    Long64_t events;
+    Double_t seconds;   /* fastest pass */
+    Double_t check;
+};
+
+struct benchKernel {
+    const char *name;
+    Double_t share;     /* of -events; the slow kernels run fewer */
+    benchResult (*run)(Long64_t n, Int_t reps);
+};
+
+static Double_t Since(benchClock::time_point t0) {
+    return std::chrono::duration<Double_t>(benchClock::now() - t0).count();
+}
+
+/* pass() runs the kernel once over the input and returns the seconds it
+   spent in the timed part */
+template <typename F> static Double_t Fastest(Int_t reps, F pass) {
+    Double_t best = -1;
+    for(Int_t r = 0; r < reps; r++) {
+        Double_t t = pass();
+        if(best < 0 || t < best) { best = t; }
+    }
+    return best;
+}
+
+/****************************************************/
+/* Shared set-up                                    */
+/****************************************************/
+
+static GRETINA* BenchGRETINA() {
+    static GRETINA *g = NULL;
+    if(!g) {
+        g = new GRETINA();
+        g->Initialize();
+        g->var.Initialize();
+        g->var.InitializeGRETINAVariables("gretina.set");
+        g->rot.ReadMatrix("crmat.dat");
+    }
+    return g;
+}
+
+/* Crystal IDs (hole*4 + crystal) of the holes in gretina.set */
+static std::vector<Int_t> BenchCrystals(GRETINA *g) {
+    std::vector<Int_t> ids;
+    for(Int_t q = 0; q < MAXQUADS; q++) {
+        if(g->var.hole[q] < 0) { continue; }
+        for(Int_t c = 0; c < 4; c++) { ids.push_back(g->var.hole[q]*4 + c); }
+    }
+    return ids;
+}
+
+/* Mode2 records of 'mult' different crystals, decoded into g2out */
+static void BenchMode2Event(GRETINA *g, SyntheticData &syn, const std::vector<Int_t> &ids,
+                            Int_t mult, Long64_t ts, counterVariables *cnt) {
+    std::vector<Int_t> used;
+    while((Int_t)used.size() < mult) {
+        Int_t id = ids[syn.rand.Integer(ids.size())];
+        if(std::find(used.begin(), used.end(), id) == used.end()) { used.push_back(id); }
+    }
+    std::vector<UChar_t> data;
+    std::vector<Int_t> length;
+    for(Int_t i = 0; i < mult; i++) {
+        size_t before = data.size();
+        syn.Mode2(data, used[i], ts + syn.rand.Integer(20), syn.rand.Uniform(100, 2000),
+                  1 + syn.rand.Integer(4));
+        length.push_back(data.size() - before);
+    }
+    FILE *f = fmemopen(&data[0], data.size(), "r");
+    for(Int_t i = 0; i < mult; i++) { g->getMode2(f, length[i], cnt); }
+    fclose(f);
+}
+
+static GRETINAWF* BenchWF() {
+    static GRETINAWF *wf = NULL;
+    if(!wf) {
+        SyntheticData syn(5);
+        wf = new GRETINAWF();
+        wf->tracelength = 1000;
+        for(Int_t ch = 0; ch < 40; ch++) {
+            syn.Pulse(wf->waveform2Out[0][ch], wf->tracelength, syn.rand.Uniform(200, 8000),
+                      syn.rand.Uniform(420, 480), syn.rand.Uniform(5, 15), 3500., 0., 3.);
+            wf->tau[ch] = 3500.;
+        }
+    }
+    return wf;
+}
+
+/****************************************************/
+/* Kernels                                          */
+/****************************************************/
+
+/* Whole UnpackORRUBA pass over a synthetic .ldf: buffer decode, channel
+   mapping, Fill and write */
+static benchResult BenchORRUBA(Long64_t n, Int_t reps) {
+    SyntheticData syn(1);
+    std::vector<UInt_t> words;
+    ULong64_t ts = 1000000;
+    for(Long64_t i = 0; i < n; i++) {
+        ts += 50000 + syn.rand.Integer(100000);
+        syn.ORRUBAEvent(words, ts, 1 + syn.rand.Poisson(6));
+    }
+
+    char ldfName[] = "/tmp/goddessBenchXXXXXX";
+    Int_t fd = mkstemp(ldfName);
+    FILE *ldf = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if(!ldf) {
+        std::cerr << "goddessBench: cannot write " << ldfName << std::endl;
+        benchResult none = {0, 0., 0.};
+        return none;
+    }
+    syn.WriteLDF(ldf, words);
+    fclose(ldf);
+
+    fileListStruct run;
+    run.ldfPath = ldfName;
+    run.rootPathRaw = std::string(ldfName) + ".root";
+    run.runNumber = "0";
+    run.copyCuts = false;
+
+    Double_t best = Fastest(reps, [&]() {
+        benchClock::time_point t0 = benchClock::now();
+        UnpackORRUBA unpack(run);
+        return Since(t0);
+    });
+
+    Double_t check = 0;
+    TFile f(run.rootPathRaw.c_str());
+    TTree *t = (TTree*)f.Get("dataRaw");
+    if(t) { check = t->GetEntries(); }
+    f.Close();
+
+    unlink(ldfName);
+    unlink(run.rootPathRaw.c_str());
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchMode2(Long64_t n, Int_t reps) {
+    GRETINA *g = BenchGRETINA();
+    std::vector<Int_t> ids = BenchCrystals(g);
+    SyntheticData syn(2);
+
+    std::vector<UChar_t> data;
+    std::vector<Int_t> length;
+    Long64_t ts = 1000000;
+    for(Long64_t i = 0; i < n; i++) {
+        size_t before = data.size();
+        ts += syn.rand.Integer(20000);
+        syn.Mode2(data, ids[syn.rand.Integer(ids.size())], ts, syn.rand.Uniform(100, 3000),
+                  1 + syn.rand.Integer(MAX_INTPTS/2));
+        length.push_back(data.size() - before);
+    }
+
+    counterVariables cnt;
+    cnt.Initialize();
+    Double_t check = 0;
+
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        FILE *f = fmemopen(&data[0], data.size(), "r");
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            g->getMode2(f, length[i], &cnt);
+            check += g->g2out.xtals[0].cc + g->g2out.xtals[0].numIntPts();
+            g->g2out.Reset();
+        }
+        Double_t dt = Since(t0);
+        fclose(f);
+        return dt;
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchMode3(Long64_t n, Int_t reps) {
+    GRETINA *g = BenchGRETINA();
+    SyntheticData syn(3);
+
+    std::vector<Int_t> modules;
+    for(Int_t q = 0; q < MAXQUADS; q++) {
+        if(g->var.hole[q] < 0) { continue; }
+        for(Int_t m = 0; m < 16; m++) { modules.push_back(g->var.hole[q]*16 + m); }
+    }
+
+    std::vector<UChar_t> data;
+    std::vector<Int_t> length;
+    Long64_t ts = 1000000;
+    for(Long64_t i = 0; i < n; i++) {
+        size_t before = data.size();
+        ts += syn.rand.Integer(2000);
+        syn.Mode3(data, modules[syn.rand.Integer(modules.size())], syn.rand.Integer(10), ts,
+                  syn.rand.Uniform(50, 3000), 200);
+        length.push_back(data.size() - before);
+    }
+
+    counterVariables cnt;
+    cnt.Initialize();
+    controlVariables ctrl;
+    ctrl.Initialize();
+    Double_t check = 0;
+
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        FILE *f = fmemopen(&data[0], data.size(), "r");
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            g->getMode3(f, length[i], &cnt, &ctrl);
+            check += g->g3Temp[0].eRaw + g->g3Temp[0].calcTime;
+            g->g3Temp.clear();
+        }
+        Double_t dt = Since(t0);
+        fclose(f);
+        return dt;
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchCFD(Long64_t n, Int_t reps) {
+    SyntheticData syn(4);
+    const Int_t nWaves = 1000;
+    std::vector<g3Waveform> waves(nWaves);
+    for(Int_t k = 0; k < nWaves; k++) {
+        syn.Pulse(waves[k].raw, 200, syn.rand.Uniform(200, 8000), syn.rand.Uniform(40, 80),
+                  syn.rand.Uniform(5, 15), 5000., syn.rand.Gaus(0, 50), 3.);
+    }
+
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) { check += waves[i%nWaves].CFD(0); }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* The same traces as BenchCFD, 40 (a crystal) per batch, so the check
+   column is the same */
+static benchResult BenchCFDBatch(Long64_t n, Int_t reps) {
+    SyntheticData syn(4);
+    const Int_t nWaves = 1000;
+    std::vector<g3Waveform> waves(nWaves);
+    for(Int_t k = 0; k < nWaves; k++) {
+        syn.Pulse(waves[k].raw, 200, syn.rand.Uniform(200, 8000), syn.rand.Uniform(40, 80),
+                  syn.rand.Uniform(5, 15), 5000., syn.rand.Gaus(0, 50), 3.);
+    }
+
+    g3TimingBatch batch;
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i += 40) {
+            batch.Clear();
+            for(Long64_t j = i; j < n && j < i + 40; j++) { batch.Add(waves[j%nWaves].raw, j); }
+            batch.Run(0);
+            for(Int_t k = 0; k < batch.size(); k++) { check += batch.cfd[k]; }
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* The BenchCFD traces, with a second pulse 30-120 samples after the
+   first in one trace of four and the top clipped at the 14-bit rail in
+   one of eight; the check column is the number of traces flagged */
+static benchResult BenchTraceScreen(Long64_t n, Int_t reps) {
+    SyntheticData syn(4);
+    const Int_t nWaves = 1000;
+    std::vector<g3Waveform> waves(nWaves);
+    std::vector<Short_t> second;
+    for(Int_t k = 0; k < nWaves; k++) {
+        syn.Pulse(waves[k].raw, 200, syn.rand.Uniform(200, 8000), syn.rand.Uniform(40, 80),
+                  syn.rand.Uniform(5, 15), 5000., syn.rand.Gaus(0, 50), 3.);
+        if(k%4 == 1) {
+            syn.Pulse(second, 200, syn.rand.Uniform(200, 4000), syn.rand.Uniform(110, 180),
+                      syn.rand.Uniform(5, 15), 5000., 0., 0.);
+            for(Int_t i = 0; i < 200; i++) { waves[k].raw[i] += second[i]; }
+        }
+        if(k%8 == 2) {
+            for(Int_t i = 0; i < 200; i++) {
+                if(waves[k].raw[i] > 500) { waves[k].raw[i] = 8191; }
+            }
+        }
+    }
+
+    g3TraceScreen screen;
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            const std::vector<Short_t> &raw = waves[i%nWaves].raw;
+            check += (screen.Check(&raw[0], raw.size(), raw.size(), kFALSE) != 0);
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* Encode and decode of the BenchCFD traces, as written to and read from
+   the g3 branch; the check column is the packed size in bytes */
+static benchResult BenchTraceCodec(Long64_t n, Int_t reps) {
+    SyntheticData syn(4);
+    const Int_t nWaves = 1000;
+    std::vector<g3Waveform> waves(nWaves);
+    for(Int_t k = 0; k < nWaves; k++) {
+        syn.Pulse(waves[k].raw, 200, syn.rand.Uniform(200, 8000), syn.rand.Uniform(40, 80),
+                  syn.rand.Uniform(5, 15), 5000., syn.rand.Gaus(0, 50), 3.);
+    }
+
+    std::vector<UChar_t> packed;
+    std::vector<Short_t> raw;
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            g3TraceCodec::Encode(waves[i%nWaves].raw, packed);
+            g3TraceCodec::Decode(packed, raw);
+            check += packed.size() + (raw == waves[i%nWaves].raw ? 0 : 1e9);
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* Pulse tails for the exponential fits: tau 1500, fitted from sample 150
+   over 200 samples.  The check column of the fits is nStart + baseline
+   summed over the first pass through the traces only, so it does not
+   depend on -events and the three fits can be compared */
+static std::vector<g3Waveform> BenchTails(Int_t nWaves) {
+    SyntheticData syn(7);
+    std::vector<g3Waveform> waves(nWaves);
+    for(Int_t k = 0; k < nWaves; k++) {
+        syn.Pulse(waves[k].raw, 400, syn.rand.Uniform(200, 8000), syn.rand.Uniform(40, 80),
+                  syn.rand.Uniform(5, 15), 1500., syn.rand.Gaus(0, 50), 3.);
+    }
+    return waves;
+}
+
+/* The Levenberg-Marquardt fit g3Waveform::LSFitExpo() ran before it was
+   solved directly, kept as the reference for speed and accuracy: the
+   direct fits agree with it to about 1e-6 ADC per trace */
+static Int_t LMFitExpo(const std::vector<Short_t> &raw, Int_t startIndex, Int_t nPoints,
+                       Double_t nStart, Double_t tau, Double_t &nStartFit, Double_t &baselineFit) {
+    auto chiSquare = [&](Double_t a, Double_t b) {
+        Double_t chiSq = 0;
+        for(Int_t i = startIndex; i < startIndex + nPoints; i++) {
+            Double_t d = raw[i] - (a*TMath::Exp(-((i - startIndex)/tau)) + b);
+            chiSq += d*d;
+        }
+        return chiSq;
+    };
+
+    Double_t nStartNow = nStart, baselineNow = nStart - 10;
+    Double_t lambda = 0.001;
+    Double_t chiSqNow = chiSquare(nStartNow, baselineNow);
+    Int_t iterations = 0, notConverged = 1;
+
+    while(notConverged && iterations < 10) {
+        Double_t alpha[2][2] = {{0.,0.},{0.,0.}};
+        Double_t beta[2] = {0.};
+        for(Int_t i = startIndex; i < startIndex + nPoints; i++) {
+            alpha[0][0] += TMath::Exp(-2*(i - startIndex)/tau);
+            alpha[0][1] += TMath::Exp(-(i - startIndex)/tau);
+            alpha[1][0] += TMath::Exp(-(i - startIndex)/tau);
+            alpha[1][1] += 1.;
+            beta[0] += ((raw[i] - (nStartNow*TMath::Exp(-(i - startIndex)/tau)) -
+                         baselineNow)*(TMath::Exp(-(i - startIndex)/tau)));
+            beta[1] += ((raw[i] - (nStartNow*TMath::Exp(-(i - startIndex)/tau)) - baselineNow));
+        }
+        alpha[0][0] *= (1 + lambda);
+        alpha[1][1] *= (1 + lambda);
+
+        Double_t det = 1/((alpha[0][0]*alpha[1][1]) - (alpha[0][1]*alpha[0][1]));
+        Double_t error00 = det*alpha[1][1], error01 = det*(-alpha[0][1]);
+        Double_t error10 = det*(-alpha[1][0]), error11 = det*alpha[0][0];
+        Double_t stepping0 = error00*beta[0] + error01*beta[1];
+        Double_t stepping1 = error10*beta[0] + error11*beta[1];
+
+        Double_t nStartLast = nStartNow, baselineLast = baselineNow;
+        nStartNow += stepping0;
+        baselineNow += stepping1;
+        Double_t chiSqLast = chiSqNow;
+        chiSqNow = chiSquare(nStartNow, baselineNow);
+        if(chiSqNow < chiSqLast) { lambda /= 10.; }
+        else { lambda *= 10.;  nStartNow = nStartLast;  baselineNow = baselineLast; }
+
+        iterations++;
+        if((TMath::Abs(stepping0) < (0.00001*TMath::Sqrt(error00))) &&
+           (TMath::Abs(stepping1) < (0.00001*TMath::Sqrt(error11)))) { notConverged = 0; }
+    }
+
+    nStartFit = nStartNow;
+    baselineFit = baselineNow;
+    return iterations;
+}
+
+static benchResult BenchTailFitLM(Long64_t n, Int_t reps) {
+    std::vector<g3Waveform> waves = BenchTails(1000);
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            const std::vector<Short_t> &raw = waves[i%waves.size()].raw;
+            Double_t a, b;
+            LMFitExpo(raw, 150, 200, raw[150], 1500., a, b);
+            if(i < (Long64_t)waves.size()) { check += a + b; }
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchTailFit(Long64_t n, Int_t reps) {
+    std::vector<g3Waveform> waves = BenchTails(1000);
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            g3Waveform &w = waves[i%waves.size()];
+            Double_t a, b, ea, eb;
+            w.LSFitExpo(150, 200, w.raw[150], 1500., a, b, ea, eb);
+            if(i < (Long64_t)waves.size()) { check += a + b; }
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* The same fits, 40 traces per batch */
+static benchResult BenchTailFitBatch(Long64_t n, Int_t reps) {
+    std::vector<g3Waveform> waves = BenchTails(1000);
+    g3TailFit batch;
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i += 40) {
+            batch.Clear();
+            for(Long64_t j = i; j < n && j < i + 40; j++) { batch.Add(waves[j%waves.size()].raw, 150, 200); }
+            batch.Run(1500.);
+            if(i >= (Long64_t)waves.size()) { continue; }
+            for(Int_t k = 0; k < batch.size(); k++) { check += batch.fit[k].nStart + batch.fit[k].baseline; }
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchFPGAFilter(Long64_t n, Int_t reps) {
+    GRETINAWF *wf = BenchWF();
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) { check += wf->FPGAFilter(i%40, 0, i%40); }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* Both ANL sums at T = 500: every pulse starts before it, and the two
+   (M+K)-sample windows of ANLEnergy2 fit the trace */
+static benchResult BenchANLEnergy(Long64_t n, Int_t reps) {
+    GRETINAWF *wf = BenchWF();
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            check += wf->ANLEnergy1(500, i%40, 0, i%40) + wf->ANLEnergy2(500, i%40, 0, i%40);
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchResult BenchGregorichTrap(Long64_t n, Int_t reps) {
+    GRETINAWF *wf = BenchWF();
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            GRETINAWF::peak p = wf->GregorichTrapFilter(i%40, 0, i%40);
+            check += p.amp + p.cen;
+        }
+        return Since(t0);
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* The trapezoid of trapFilterBank at sample 'pick', summed directly:
+   the pole-zero corrected trace M*x[i] + sum(x[0..i]) (baseline x[0]
+   taken off), its sum over the last 'rise' samples less the one a rise
+   and a flat top earlier, over the gain rise*(M+1) */
+static Double_t DirectTrap(const std::vector<Short_t> &trace, Int_t rise, Int_t flat,
+                           Int_t length, Float_t tau, Int_t pick) {
+    Double_t M = 1./(exp(1./(Double_t)tau) - 1.);
+    std::vector<Double_t> pz(length);
+    Double_t x0 = trace[0], acc = 0;
+    for(Int_t i = 0; i < length; i++) {
+        Double_t x = (i < (Int_t)trace.size()) ? trace[i] : trace.back();
+        acc += x - x0;
+        pz[i] = M*(x - x0) + acc;
+    }
+    Double_t s1 = 0, s2 = 0;
+    for(Int_t j = pick - rise + 1; j <= pick; j++) { s1 += (j < 0) ? 0. : pz[j]; }
+    for(Int_t j = pick - 2*rise - flat + 1; j <= pick - rise - flat; j++) { s2 += (j < 0) ? 0. : pz[j]; }
+    return (s1 - s2)/(rise*(M + 1.));
+}
+
+/* All 40 BenchWF channels through the trapezoid bank per event; the
+   flat top of every pulse covers sample 850.  A channel that differs
+   from DirectTrap() by more than 1e-11 (relative) adds 1e9 to the check */
+static benchResult BenchTrapBank(Long64_t n, Int_t reps) {
+    GRETINAWF *wf = BenchWF();
+    trapFilterBank bank;
+    bank.Setup(wf->eFilterM, wf->eFilterK, wf->tracelength, 40, wf->tau);
+    for(Int_t ch = 0; ch < 40; ch++) { bank.Load(ch, wf->waveform2Out[0][ch]); }
+
+    bank.Run(850);
+    Double_t wrong = 0;
+    for(Int_t ch = 0; ch < 40; ch++) {
+        Double_t direct = DirectTrap(wf->waveform2Out[0][ch], wf->eFilterM, wf->eFilterK,
+                                     wf->tracelength, wf->tau[ch], 850);
+        if(fabs(bank.energy[ch] - direct) > 1e-11*std::max(1., fabs(direct))) { wrong += 1e9; }
+    }
+
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i += 40) {
+            bank.Run(850);
+            for(Int_t ch = 0; ch < 40; ch++) { check += bank.energy[ch]; }
+        }
+        return Since(t0);
+    });
+    check += wrong;
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* findTargetPos + trackEvent on 1-4 crystal events; the shell is refilled
+   (untimed) before every event */
+static benchResult BenchTrack(Long64_t n, Int_t reps) {
+    GRETINA *g = BenchGRETINA();
+    g->track.Initialize();
+
+    std::vector<Int_t> ids = BenchCrystals(g);
+    SyntheticData syn(6);
+    counterVariables cnt;
+    cnt.Initialize();
+
+    const Int_t nEvents = 1000;
+    std::vector<g2OUT> events;
+    for(Int_t e = 0; e < nEvents; e++) {
+        BenchMode2Event(g, syn, ids, 1 + syn.rand.Integer(4), 1000000 + 10000*e, &cnt);
+        events.push_back(g->g2out);
+        g->g2out.Reset();
+    }
+
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        Double_t dt = 0;
+        for(Long64_t i = 0; i < n; i++) {
+            g->g2out = events[i%nEvents];
+            if(g->fillShell2Track() == 8) { continue; }
+            benchClock::time_point t0 = benchClock::now();
+            g->track.findTargetPos();
+            Int_t status = g->track.trackEvent();
+            dt += Since(t0);
+            check += status + g->track.nClusters;
+            for(Int_t c = 0; c < g->track.nClusters; c++) {
+                if(g->track.clust[c].valid) { check += g->track.clust[c].FOM; }
+            }
+        }
+        g->g2out.Reset();
+        return dt;
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* ata, yta, bta, dta from a 5th order map in the four CRDC parameters */
+static benchResult BenchS800Map(Long64_t n, Int_t reps) {
+    SyntheticData syn(7);
+    S800Map *map = new S800Map();
+    memset(map->maxcoefficient, 0, sizeof(map->maxcoefficient));
+    memset(map->order, 0, sizeof(map->order));
+    memset(map->exponent, 0, sizeof(map->exponent));
+    memset(map->coefficient, 0, sizeof(map->coefficient));
+
+    const Int_t maxOrder = 5;
+    for(Int_t p = 0; p < 4; p++) {
+        Int_t index = 0;
+        for(Int_t o = 0; o <= maxOrder; o++) {
+            for(Int_t e0 = o; e0 >= 0; e0--) {
+                for(Int_t e1 = o - e0; e1 >= 0; e1--) {
+                    for(Int_t e2 = o - e0 - e1; e2 >= 0; e2--) {
+                        map->order[p][index] = o;
+                        map->exponent[p][0][index] = e0;
+                        map->exponent[p][1][index] = e1;
+                        map->exponent[p][2][index] = e2;
+                        map->exponent[p][3][index] = o - e0 - e1 - e2;
+                        map->coefficient[p][index] = syn.rand.Gaus(0, 1)/pow(10., o);
+                        index++;
+                    }
+                }
+            }
+        }
+        map->maxcoefficient[p] = index;
+    }
+    map->maxorder = maxOrder;
+
+    const Int_t nInputs = 1000;
+    std::vector<Double_t> input(6*nInputs, 0.);
+    for(Int_t k = 0; k < nInputs; k++) {
+        input[6*k + 0] = syn.rand.Uniform(-0.3, 0.3);
+        input[6*k + 1] = syn.rand.Uniform(-0.1, 0.1);
+        input[6*k + 2] = syn.rand.Uniform(-0.3, 0.3);
+        input[6*k + 3] = syn.rand.Uniform(-0.1, 0.1);
+    }
+
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        check = 0;
+        benchClock::time_point t0 = benchClock::now();
+        for(Long64_t i = 0; i < n; i++) {
+            Double_t *in = &input[6*(i%nInputs)];
+            for(Int_t p = 0; p < 4; p++) { check += map->Calculate(maxOrder, p, in); }
+        }
+        return Since(t0);
+    });
+
+    delete map;
+    benchResult r = {n, best, check};
+    return r;
+}
+
+/* Unpack::MatchTimeStamps with ~60% of the ORRUBA events in coincidence
+   and two GRETINA singles per ORRUBA event */
+static benchResult BenchMatch(Long64_t n, Int_t reps) {
+    SyntheticData syn(8);
+    std::vector<std::pair<Int_t, Long64_t> > orruba, gretina;
+    Long64_t ts = 1000000;
+    for(Long64_t i = 0; i < n; i++) {
+        ts += 50000 + syn.rand.Integer(100000);
+        orruba.push_back(std::make_pair((Int_t)i, ts));
+        if(syn.rand.Uniform() < 0.6) {
+            gretina.push_back(std::make_pair((Int_t)gretina.size(), ts + (Long64_t)syn.rand.Integer(600) - 300));
+        }
+        for(Int_t k = 0; k < 2; k++) {
+            gretina.push_back(std::make_pair((Int_t)gretina.size(), ts + 2000 + (Long64_t)syn.rand.Integer(40000)));
+        }
+    }
+    std::sort(gretina.begin(), gretina.end(),
+              [](const std::pair<Int_t, Long64_t>& a, const std::pair<Int_t, Long64_t>& b) { return a.second < b.second; });
+
+    Double_t check = 0;
+    Double_t best = Fastest(reps, [&]() {
+        Long64_t nMatched = 0;
+        benchClock::time_point t0 = benchClock::now();
+        std::vector<matchedEvents> matched = Unpack::MatchTimeStamps(orruba, gretina, 1000, 1000, nMatched, false);
+        Double_t dt = Since(t0);
+        check = nMatched;
+        for(size_t i = 0; i < matched.size(); i++) { check += matched[i].gretinaNumber; }
+        return dt;
+    });
+
+    benchResult r = {n, best, check};
+    return r;
+}
+
+static benchKernel kernels[] = {
+    {"ORRUBA.unpack",          1.,   BenchORRUBA},
+    {"GRETINA.getMode2",       1.,   BenchMode2},
+    {"GRETINA.getMode3",       1.,   BenchMode3},
+    {"g3Waveform.CFD",         1.,   BenchCFD},
+    {"g3TimingBatch.CFD",      1.,   BenchCFDBatch},
+    {"g3TraceScreen.Check",    1.,   BenchTraceScreen},
+    {"g3Waveform.LSFitExpo.LM",0.01, BenchTailFitLM},
+    {"g3Waveform.LSFitExpo",   1.,   BenchTailFit},
+    {"g3TailFit.batch",        1.,   BenchTailFitBatch},
+    {"g3TraceCodec.roundtrip", 1.,   BenchTraceCodec},
+    {"GRETINAWF.FPGAFilter",   0.1,  BenchFPGAFilter},
+    {"GRETINAWF.ANLEnergy",    0.1,  BenchANLEnergy},
+    {"GRETINAWF.GregorichTrap",0.1,  BenchGregorichTrap},
+    {"GRETINAWF.trapFilterBank",0.1, BenchTrapBank},
+    {"Track.trackEvent",       0.1,  BenchTrack},
+    {"S800Map.Calculate",      1.,   BenchS800Map},
+    {"Unpack.MatchTimeStamps", 1.,   BenchMatch},
+};
+
+/****************************************************/
+
+struct benchBaseline {
+    Long64_t events;
+    Double_t nsPerEvent;
+    Double_t check;
+};
+
+static std::map<std::string, benchBaseline> ReadBaseline(const std::string &fileName) {
+    std::map<std::string, benchBaseline> base;
+    FILE *f = fopen(fileName.c_str(), "r");
+    if(!f) { return base; }
+    char line[512], name[256];
+    benchBaseline b;
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == '#') { continue; }
+        if(sscanf(line, "%255s %lld %lf %lf", name, &b.events, &b.nsPerEvent, &b.check) == 4) {
+            base[name] = b;
+        }
+    }
+    fclose(f);
+    return base;
+}
+
+static void PrintUsage() {
+    std::cout << "goddessBench [-events N] [-reps R] [-only <name>] [-save <file>] [-compare <file>]" << std::endl;
+    std::cout << "  -events N        events per kernel (default 100000; the slow kernels run N/10)" << std::endl;
+    std::cout << "  -reps R          passes per kernel, the fastest counts (default 3)" << std::endl;
+    std::cout << "  -only <name>     only kernels whose name contains <name>" << std::endl;
+    std::cout << "  -save <file>     write the results as a baseline" << std::endl;
+    std::cout << "  -compare <file>  show the change against a saved baseline" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    Long64_t events = 100000;
+    Int_t reps = 3;
+    std::string only, saveFile, compareFile;
+
+    for(Int_t i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-events") == 0 && i + 1 < argc) { events = atoll(argv[++i]); }
+        else if(strcmp(argv[i], "-reps") == 0 && i + 1 < argc) { reps = atoi(argv[++i]); }
+        else if(strcmp(argv[i], "-only") == 0 && i + 1 < argc) { only = argv[++i]; }
+        else if(strcmp(argv[i], "-save") == 0 && i + 1 < argc) { saveFile = argv[++i]; }
+        else if(strcmp(argv[i], "-compare") == 0 && i + 1 < argc) { compareFile = argv[++i]; }
+        else { PrintUsage(); return 1; }
+    }
+    if(events < 10) { events = 10; }
+    if(reps < 1) { reps = 1; }
+
+    std::map<std::string, benchBaseline> base;
+    if(!compareFile.empty()) {
+        base = ReadBaseline(compareFile);
+        if(base.empty()) {
+            std::cout << PrintOutput("No baseline in " + compareFile + " yet (make bench-save)", "yellow") << std::endl;
+        }
+    }
+
+    std::vector<std::string> names;
+    std::vector<benchResult> results;
+    for(size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++) {
+        if(!only.empty() && std::string(kernels[k].name).find(only) == std::string::npos) { continue; }
+        Long64_t n = (Long64_t)(events*kernels[k].share);
+        if(n < 1) { n = 1; }
+        std::cout << PrintOutput("Running " + std::string(kernels[k].name), "blue") << std::endl;
+        names.push_back(kernels[k].name);
+        results.push_back(kernels[k].run(n, reps));
+    }
+
+    printf("\n%-26s %10s %12s %12s %9s  %s\n", "kernel", "events", "ns/event", "baseline", "change", "check");
+    for(size_t k = 0; k < results.size(); k++) {
+        Double_t ns = results[k].events ? 1e9*results[k].seconds/results[k].events : 0.;
+        printf("%-26s %10lld %12.1f", names[k].c_str(), results[k].events, ns);
+        std::map<std::string, benchBaseline>::iterator b = base.find(names[k]);
+        if(b != base.end() && b->second.nsPerEvent > 0) {
+            printf(" %12.1f %+8.1f%%", b->second.nsPerEvent, 100.*(ns/b->second.nsPerEvent - 1.));
+        } else {
+            printf(" %12s %9s", "-", "-");
+        }
+        printf("  %.6g", results[k].check);
+        if(b != base.end() && b->second.events == results[k].events &&
+           fabs(b->second.check - results[k].check) > 1e-6*(fabs(b->second.check) + 1.)) {
+            printf("  (baseline %.6g: results differ)", b->second.check);
+        }
+        printf("\n");
+    }
+
+    if(!saveFile.empty()) {
+        FILE *f = fopen(saveFile.c_str(), "w");
+        if(!f) {
+            std::cerr << "goddessBench: cannot write " << saveFile << std::endl;
+            return 1;
+        }
+        fprintf(f, "# goddessBench baseline: kernel events ns/event check\n");
+        for(size_t k = 0; k < results.size(); k++) {
+            fprintf(f, "%s %lld %.3f %.17g\n", names[k].c_str(), results[k].events,
+                    results[k].events ? 1e9*results[k].seconds/results[k].events : 0., results[k].check);
+        }
+        fclose(f);
+        std::cout << PrintOutput("\nBaseline saved to " + saveFile, "blue") << std::endl;
+    }
+
+    return 0;
+}
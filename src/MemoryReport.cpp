@@ -0,0 +1,196 @@
+#include "MemoryReport.h"
+#include "StageMetrics.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/****************************************************/
+/* Counting operator new                            */
+/****************************************************/
+
+static inline void* CountedAlloc(size_t size) {
+    if(gCountAllocs) {
+        allocCounters& c = AllocCounters();
+        c.count++;
+        c.bytes += size;
+    }
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+    void *p = CountedAlloc(size);
+    if(!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    void *p = CountedAlloc(size);
+    if(!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { free(p); }
+
+/****************************************************/
+
+/* VmRSS and VmHWM from /proc/self/status, in kB */
+static void ProcessMemory(long long &rssKB, long long &peakKB) {
+    rssKB = peakKB = -1;
+    FILE *f = fopen("/proc/self/status", "r");
+    if(!f) { return; }
+    char line[256];
+    while(fgets(line, sizeof(line), f)) {
+        if(strncmp(line, "VmRSS:", 6) == 0) { rssKB = atoll(line + 6); }
+        else if(strncmp(line, "VmHWM:", 6) == 0) { peakKB = atoll(line + 6); }
+    }
+    fclose(f);
+}
+
+/* Bytes of [p, p+bytes) in resident pages */
+static long long ResidentBytes(const void *p, size_t bytes) {
+    if(!p || bytes == 0) { return 0; }
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)p & ~(uintptr_t)(pageSize - 1);
+    uintptr_t end = (uintptr_t)p + bytes;
+    size_t nPages = (end - begin + pageSize - 1)/pageSize;
+
+    std::vector<unsigned char> vec(nPages);
+    if(mincore((void*)begin, end - begin, &vec[0]) != 0) { return -1; }
+
+    long long resident = 0;
+    for(size_t i = 0; i < nPages; i++) {
+        if(!(vec[i] & 1)) { continue; }
+        uintptr_t lo = begin + i*pageSize, hi = lo + pageSize;
+        if(lo < (uintptr_t)p) { lo = (uintptr_t)p; }
+        if(hi > end) { hi = end; }
+        resident += hi - lo;
+    }
+    return resident;
+}
+
+MemoryReport *gMemReport = NULL;
+
+MemoryReport::MemoryReport(std::string job, std::string fileName) {
+    this->job = job;
+    this->fileName = fileName;
+    peakKB = -1;
+}
+
+void MemoryReport::Component(std::string name, const void *p, size_t bytes) {
+    for(size_t i = 0; i < components.size(); i++) {
+        if(components[i].name == name) {
+            components[i].p = p;
+            components[i].bytes = bytes;
+            return;
+        }
+    }
+    component c = {name, p, bytes, 0};
+    components.push_back(c);
+}
+
+long long MemoryReport::Measure(component &c) {
+    long long resident = ResidentBytes(c.p, c.bytes);
+    if(resident > c.peak) { c.peak = resident; }
+    return resident;
+}
+
+void MemoryReport::Snapshot(std::string label) {
+    snapshot s;
+    s.label = label;
+    ProcessMemory(s.rssKB, s.peakKB);
+    peakKB = s.peakKB;
+    for(size_t i = 0; i < components.size(); i++) {
+        s.resident.push_back(Measure(components[i]));
+    }
+    snapshots.push_back(s);
+}
+
+void MemoryReport::Sample() {
+    long long rssKB;
+    ProcessMemory(rssKB, peakKB);
+    for(size_t i = 0; i < components.size(); i++) { Measure(components[i]); }
+}
+
+void MemoryReport::Print() {
+    const double MB = 1024.*1024.;
+
+    printf("\n\t\tMemory report (%s)\n", job.c_str());
+    printf("\t\t  %-34s %10s", "component", "size MB");
+    for(size_t k = 0; k < snapshots.size(); k++) { printf(" %10s", (snapshots[k].label + " MB").c_str()); }
+    printf(" %10s\n", "peak MB");
+
+    for(size_t i = 0; i < components.size(); i++) {
+        /* Indent by nesting depth */
+        const std::string &name = components[i].name;
+        size_t dot = name.rfind('.');
+        int depth = 0;
+        for(size_t c = 0; c < name.size(); c++) { depth += (name[c] == '.'); }
+        std::string shown = std::string(2*depth, ' ') + ((dot == std::string::npos) ? name : name.substr(dot + 1));
+
+        printf("\t\t  %-34s %10.1f", shown.c_str(), components[i].bytes/MB);
+        for(size_t k = 0; k < snapshots.size(); k++) {
+            if(i >= snapshots[k].resident.size()) { printf(" %10s", "-"); }
+            else if(snapshots[k].resident[i] < 0) { printf(" %10s", "?"); }
+            else { printf(" %10.1f", snapshots[k].resident[i]/MB); }
+        }
+        printf(" %10.1f\n", components[i].peak/MB);
+    }
+
+    printf("\t\t  %-34s %10s", "process RSS", "");
+    for(size_t k = 0; k < snapshots.size(); k++) { printf(" %10.1f", snapshots[k].rssKB/1024.); }
+    printf("\n\t\t  %-34s %10s", "process peak RSS", "");
+    for(size_t k = 0; k < snapshots.size(); k++) { printf(" %10.1f", snapshots[k].peakKB/1024.); }
+    printf(" %10.1f\n", peakKB/1024.);
+
+    if(gMetrics) { gMetrics->PrintAllocations(); }
+    else { printf("\t\t  (per-stage allocations need a metrics file)\n"); }
+    fflush(stdout);
+}
+
+/* {"job":..,"components":[{"name":..,"bytes":..,"resident":{"startup":..,"end":..},"peak":..},...],
+    "process":{"startup":{"rssKB":..,"peakKB":..},...},
+    "stages":{"ProcessEvent":{"calls":..,"allocs":..,"allocBytes":..},...}} */
+void MemoryReport::WriteJSON() {
+    if(fileName.empty()) { return; }
+    FILE *out = fopen(fileName.c_str(), "w");
+    if(!out) {
+        fprintf(stderr, "MemoryReport: cannot open %s\n", fileName.c_str());
+        return;
+    }
+
+    fprintf(out, "{\"job\":\"%s\",\"components\":[", job.c_str());
+    for(size_t i = 0; i < components.size(); i++) {
+        fprintf(out, "%s\n {\"name\":\"%s\",\"bytes\":%zu,\"resident\":{", i ? "," : "",
+                components[i].name.c_str(), components[i].bytes);
+        const char *sep = "";
+        for(size_t k = 0; k < snapshots.size(); k++) {
+            if(i >= snapshots[k].resident.size()) { continue; }
+            fprintf(out, "%s\"%s\":%lld", sep, snapshots[k].label.c_str(), snapshots[k].resident[i]);
+            sep = ",";
+        }
+        fprintf(out, "},\"peak\":%lld}", components[i].peak);
+    }
+    fprintf(out, "],\n\"process\":{");
+    for(size_t k = 0; k < snapshots.size(); k++) {
+        fprintf(out, "%s\"%s\":{\"rssKB\":%lld,\"peakKB\":%lld}", k ? "," : "",
+                snapshots[k].label.c_str(), snapshots[k].rssKB, snapshots[k].peakKB);
+    }
+    fprintf(out, "},\n\"stages\":");
+    if(gMetrics) { gMetrics->WriteAllocationsJSON(out); }
+    else { fprintf(out, "{}"); }
+    fprintf(out, "}\n");
+    fclose(out);
+}
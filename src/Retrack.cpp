@@ -0,0 +1,284 @@
+/* goddessRetrack: runs tracking again on the mode2 data of an existing
+   unpackGRETINA tree, with a different track.chat, without going back to
+   Global.dat.
+
+   ./goddessRetrack -i <run_gretina.root> [-o <file>] [-chat <file>]
+                    [-threads N] [-events N] [-block N]
+
+   Only the g2 branch of "teb" is read.  Each entry goes through the same
+   steps as in unpackGRETINA -track (GRETINA::fillShell2Track,
+   Track::findTargetPos, trackEvent, GRETINA::fillMode1), and the tracked
+   gammas are written as branch "g1" (g1OUT) of tree "retrack", one entry
+   per teb entry -- empty where there is nothing to track -- so it can be
+   used as a friend of the original tree:
+
+       teb->AddFriend("retrack", "run_retrack.root");
+       teb->Draw("retrack.g1.gammas.cc", "retrack.g1.gammas.FOM < 0.8");
+
+   The output file defaults to the input with _gretina.root replaced by
+   _retrack.root; the chat file used is stored in it as TNamed "trackChat".
+   gretina.set (beta for the Doppler correction) and crmat.dat are read
+   from the current directory, as unpackGRETINA does.
+
+   Entries are read in blocks of -block (default 4096) and the events of a
+   block are tracked on -threads threads (default: all cores), each with
+   its own GRETINA and Track -- about 120 MB each, mostly the permutation
+   tables.  The block is written back in entry order, so the output does
+   not depend on the number of threads. */
+
+#include "GRETINA.h"
+#include "TrackPool.h"
+#include "Utilities.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <TFile.h>
+#include <TNamed.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+struct retrackOptions {
+    std::string input;
+    std::string output;
+    std::string chat;
+    Int_t threads;
+    Long64_t events;
+    Int_t block;
+};
+
+/* Totals over the workers, for the summary */
+struct retrackTotals {
+    Long64_t entries;
+    Long64_t tracked;       /* entries with mode2 data that went through tracking */
+    Long64_t gammas;
+    Long64_t clusters;
+    Double_t sumFOM;        /* clusters with nDet > 1 */
+    Long64_t nSumFOM;
+    TrackCounts counts;
+};
+
+/* One thread's copy of everything tracking touches */
+class RetrackWorker {
+public:
+    RetrackWorker(GRETINA *g) : g(g), tracked(0) { ; }
+    ~RetrackWorker() { delete g; }
+
+    /* Tracks in[k] for the k taken from 'next', result in out[k] */
+    void Run(std::vector<g2OUT> &in, std::vector<g1OUT> &out, std::atomic<Int_t> &next);
+
+    GRETINA *g;
+    Long64_t tracked;
+};
+
+void RetrackWorker::Run(std::vector<g2OUT> &in, std::vector<g1OUT> &out, std::atomic<Int_t> &next) {
+    Int_t k;
+    while((k = next.fetch_add(1)) < (Int_t)in.size()) {
+        g->g1out.Reset();
+        g->g2out.runNumber = in[k].runNumber;
+        g->g2out.xtals.swap(in[k].xtals);
+
+        /* As ProcessEvent() in UnpackUtilities.cpp */
+        if(g->g2out.crystalMult() > 0) {
+            if(g->fillShell2Track() != 8) {
+                tracked++;
+                g->track.findTargetPos();
+                Int_t trackStatus = g->track.trackEvent();
+                g->fillMode1(trackStatus);
+            }
+        }
+
+        g->g2out.xtals.swap(in[k].xtals);
+        out[k].gammas.swap(g->g1out.gammas);
+    }
+}
+
+static void PrintUsage() {
+    std::cout << "goddessRetrack -i <file> [options]" << std::endl;
+    std::cout << "  -i <file>          unpackGRETINA output with a g2 branch" << std::endl;
+    std::cout << "  -o <file>          output (default: input with _gretina.root -> _retrack.root)" << std::endl;
+    std::cout << "  -chat <file>       tracking parameters (default track.chat)" << std::endl;
+    std::cout << "  -threads N         tracking threads (default: all cores)" << std::endl;
+    std::cout << "  -events N          stop after N entries (default: all)" << std::endl;
+    std::cout << "  -block N           entries read per block (default 4096)" << std::endl;
+}
+
+static std::string OutputName(const std::string &input) {
+    const std::string suffix = "_gretina.root";
+    if(input.size() > suffix.size() &&
+       input.compare(input.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return input.substr(0, input.size() - suffix.size()) + "_retrack.root";
+    }
+    size_t dot = input.rfind(".root");
+    return ((dot == std::string::npos) ? input : input.substr(0, dot)) + "_retrack.root";
+}
+
+int main(int argc, char *argv[]) {
+    retrackOptions opt;
+    opt.chat = "track.chat";
+    opt.threads = 0;
+    opt.events = -1;
+    opt.block = 4096;
+
+    for(Int_t i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) { opt.input = argv[++i]; }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) { opt.output = argv[++i]; }
+        else if(strcmp(argv[i], "-chat") == 0 && i + 1 < argc) { opt.chat = argv[++i]; }
+        else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+        else if(strcmp(argv[i], "-events") == 0 && i + 1 < argc) { opt.events = atoll(argv[++i]); }
+        else if(strcmp(argv[i], "-block") == 0 && i + 1 < argc) { opt.block = atoi(argv[++i]); }
+        else { PrintUsage(); return 1; }
+    }
+    if(opt.input.empty()) { PrintUsage(); return 1; }
+    if(opt.output.empty()) { opt.output = OutputName(opt.input); }
+    if(opt.threads <= 0) { opt.threads = TrackPool::HardwareThreads(); }
+    if(opt.block < 1) { opt.block = 1; }
+
+    /* The workers make TObjects (TVector3, g1GammaEvent) */
+    ROOT::EnableThreadSafety();
+
+    TFile *fin = TFile::Open(opt.input.c_str(), "READ");
+    if(!fin || fin->IsZombie()) {
+        std::cerr << PrintOutput("Cannot open " + opt.input, "red") << std::endl;
+        return 1;
+    }
+    TTree *tin = (TTree*)fin->Get("teb");
+    if(!tin || !tin->GetBranch("g2")) {
+        std::cerr << PrintOutput("No teb tree with a g2 branch in " + opt.input, "red") << std::endl;
+        return 1;
+    }
+    g2OUT *g2 = NULL;
+    TBranch *b2 = NULL;
+    tin->SetBranchAddress("g2", &g2, &b2);
+
+    Long64_t nEntries = tin->GetEntries();
+    if(opt.events >= 0 && opt.events < nEntries) { nEntries = opt.events; }
+
+    /* The first worker is set up as unpackGRETINA sets up gret; the others
+       are copies of it, so the chat file is read once */
+    GRETINA *first = new GRETINA();
+    first->Initialize();
+    first->var.Initialize();
+    first->var.InitializeGRETINAVariables("gretina.set");
+    first->rot.ReadMatrix("crmat.dat");
+    first->track.Initialize(opt.chat.c_str());
+
+    std::vector<RetrackWorker*> workers;
+    workers.push_back(new RetrackWorker(first));
+    for(Int_t t = 1; t < opt.threads; t++) {
+        GRETINA *g = new GRETINA();
+        g->Initialize();
+        g->var.beta = first->var.beta;
+        g->rot = first->rot;
+        g->track = first->track;
+        workers.push_back(new RetrackWorker(g));
+    }
+
+    TFile *fout = new TFile(opt.output.c_str(), "RECREATE");
+    if(fout->IsZombie()) {
+        std::cerr << PrintOutput("Cannot open " + opt.output, "red") << std::endl;
+        return 1;
+    }
+    fout->SetCompressionAlgorithm(1);
+    fout->SetCompressionLevel(2);
+
+    std::ifstream chatIn(opt.chat.c_str());
+    std::stringstream chatText;
+    chatText << chatIn.rdbuf();
+    TNamed("trackChat", chatText.str().c_str()).Write();
+
+    TTree *tout = new TTree("retrack", "Tracked gammas, friend of teb");
+    g1OUT *g1 = new g1OUT();
+    tout->Branch("g1", "g1OUT", &g1);
+
+    std::cout << PrintOutput("\t\tRe-tracking " + opt.input + " (" + std::to_string(nEntries) + " entries, " +
+                             std::to_string(opt.threads) + " threads) to " + opt.output + "\n", "blue");
+
+    retrackTotals tot;
+    memset(&tot, 0, sizeof(tot));
+    tot.entries = nEntries;
+
+    std::vector<g2OUT> in;
+    std::vector<g1OUT> out;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    for(Long64_t start = 0; start < nEntries; start += opt.block) {
+        Int_t n = (Int_t)((nEntries - start < opt.block) ? nEntries - start : opt.block);
+        in.resize(n);
+        out.resize(n);
+
+        /* Only the g2 branch is read; swapping leaves the buffers of
+           in[k] to be reused by the next read */
+        for(Int_t k = 0; k < n; k++) {
+            b2->GetEntry(tin->LoadTree(start + k));
+            in[k].runNumber = g2->runNumber;
+            in[k].xtals.swap(g2->xtals);
+        }
+
+        std::atomic<Int_t> next(0);
+        std::vector<std::thread> threads;
+        for(size_t t = 1; t < workers.size() && (Int_t)t < n; t++) {
+            threads.push_back(std::thread(&RetrackWorker::Run, workers[t], std::ref(in), std::ref(out), std::ref(next)));
+        }
+        workers[0]->Run(in, out, next);
+        for(size_t t = 0; t < threads.size(); t++) { threads[t].join(); }
+
+        for(Int_t k = 0; k < n; k++) {
+            g1->gammas.swap(out[k].gammas);
+            tot.gammas += g1->gammas.size();
+            tout->Fill();
+            g1->gammas.swap(out[k].gammas);
+            out[k].Reset();
+        }
+
+        if((start/opt.block) % 25 == 0) {
+            printf("\t\t  %lld / %lld entries\r", start + n, nEntries);
+            fflush(stdout);
+        }
+    }
+
+    Double_t seconds = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+
+    fout->cd();
+    tout->Write();
+    fout->Close();
+    fin->Close();
+
+    for(size_t t = 0; t < workers.size(); t++) {
+        TrackStat &s = workers[t]->g->track.stat;
+        tot.tracked += workers[t]->tracked;
+        tot.clusters += s.nClusters;
+        tot.sumFOM += s.sumFOM_NT;
+        tot.nSumFOM += s.nSumFOM_NT;
+        tot.counts.nPerm += s.nPerm;
+        for(Int_t i = 0; i < MAXNUMSEG; i++) {
+            tot.counts.permClusters[i] += s.permClusters[i];
+            tot.counts.permEval[i] += s.permEval[i];
+        }
+    }
+
+    printf("\n");
+    printf("  entries          %12lld  (%.0f /s)\n", tot.entries, (seconds > 0) ? tot.entries/seconds : 0.);
+    printf("  tracked events   %12lld\n", tot.tracked);
+    printf("  clusters         %12lld\n", tot.clusters);
+    printf("  gammas written   %12lld\n", tot.gammas);
+    printf("  permutations     %12lld\n", (Long64_t)tot.counts.nPerm);
+    printf("  mean FOM, nDet>1 %12.4f\n", (tot.nSumFOM > 0) ? tot.sumFOM/tot.nSumFOM : 0.);
+
+    TrackStat sum;
+    sum.Zero();
+    sum.Add(tot.counts);
+    sum.PrintPermutations(first->track.perm.nPerm);
+
+    for(size_t t = 0; t < workers.size(); t++) { delete workers[t]; }
+    return 0;
+}
@@ -27,6 +27,14 @@ RunList::RunList() {
     withTracked = config["withTracked"].asBool();
     mergeTrees = config["mergeTrees"].asBool();
 
+    // Optional per-stage metrics output (see StageMetrics.h)
+    metricsFile = config.get("metricsFile", "").asString();
+    metricsPeriod = config.get("metricsPeriod", 10.).asDouble();
+    // Optional timeline of the same stages (see Trace.h)
+    traceFile = config.get("traceFile", "").asString();
+    // Optional JSON copy of the end-of-sort memory report (see MemoryReport.h)
+    memReportFile = config.get("memReportFile", "").asString();
+
     if(!useAllFolders) CompileListOfRuns();
     else GetAllRuns();
 }
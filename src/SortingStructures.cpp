@@ -17,6 +17,7 @@ ClassImp(counterVariables);
 
 controlVariables::controlVariables() {
   doTRACK = 0;
+  trackThreads = 0;
   withWAVE = 0;
   withSEG = 1;
   withHISTOS = 1;
@@ -37,6 +38,13 @@ controlVariables::controlVariables() {
   compressedFile = 0;
   compressedFileB = 0;
   noHFC = 0;
+  hfcMemMB = 1024;
+  useIndex = 0;
+  tsStart = -1;  tsEnd = -1;
+  nSlices = 1;  sliceTypes = "";
+  ebWindow = EB_DIFF_TIME;  ebLookBack = 0;
+  metricsFile = "";  metricsPeriod = 10.;
+  traceFile = "";  memReportFile = "";
   suppressTS = 0;
   pgh = 0;
   noEB = 0;
@@ -57,6 +65,9 @@ controlVariables::controlVariables() {
 
   WITH_TRACETREE = 0;
   CHECK_PILEUP = 0;
+  screenTraces = 0;
+  screenRail = 8191;  screenEdge = 50;
+  packTraces = 0;
   FALLON_TIME = 0;
   LEDCROSSING = 0;
   FIT_BASELINE = 0;
@@ -101,6 +112,7 @@ controlVariables::controlVariables() {
 
 void controlVariables::Initialize() {
   doTRACK = 0;
+  trackThreads = 0;
   withWAVE = 0;
   withSEG = 1;
   withHISTOS = 0;
@@ -121,6 +133,13 @@ void controlVariables::Initialize() {
   compressedFile = 0;
   compressedFileB = 0;
   noHFC = 0;
+  hfcMemMB = 1024;
+  useIndex = 0;
+  tsStart = -1;  tsEnd = -1;
+  nSlices = 1;  sliceTypes = "";
+  ebWindow = EB_DIFF_TIME;  ebLookBack = 0;
+  metricsFile = "";  metricsPeriod = 10.;
+  traceFile = "";  memReportFile = "";
   suppressTS = 0;
   pgh = 0;
   noEB = 0;
@@ -138,6 +157,9 @@ void controlVariables::Initialize() {
 
   WITH_TRACETREE = 0;
   CHECK_PILEUP = 0;
+  screenTraces = 0;
+  screenRail = 8191;  screenEdge = 50;
+  packTraces = 0;
   FALLON_TIME = 0;
   LEDCROSSING = 0;
   FIT_BASELINE = 0;
@@ -204,12 +226,34 @@ Int_t controlVariables::InterpretCommandLine(int argc, char *argv[]) {
       std::cout << "\t\t" << PrintOutput("Tracking enabled.", "blue") << std::endl;
       i++;
     }
+    else if (strcmp(argv[i], "-trackThreads") == 0) {
+      trackThreads = atoi(argv[i+1]);
+      i += 2;
+    }
     else if (strcmp(argv[i], "-wf") == 0) {
       withWAVE = 1;
       WITH_TRACETREE = 1;
       std::cout << "Waveform analysis enabled. " << std::endl;
       i++;
     }
+    else if (strcmp(argv[i], "-screen") == 0) {
+      screenTraces = 1;
+      std::cout << "Mode3 trace screening enabled. " << std::endl;
+      i++;
+    }
+    else if (strcmp(argv[i], "-screenRail") == 0) {
+      screenRail = atoi(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-screenEdge") == 0) {
+      screenEdge = atoi(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-packTraces") == 0) {
+      packTraces = 1;
+      std::cout << "Mode3 traces written packed. " << std::endl;
+      i++;
+    }
     else if (strcmp(argv[i], "-noSeg") == 0) {
       withSEG = 0;
       std::cout << "Segment analysis disabled. " << std::endl;
@@ -273,6 +317,55 @@ Int_t controlVariables::InterpretCommandLine(int argc, char *argv[]) {
       noHFC = 1;
       i++;
     }
+    else if (strcmp(argv[i], "-hfcMem") == 0) {
+      hfcMemMB = atoi(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-index") == 0) {
+      useIndex = 1;
+      i++;
+    }
+    else if (strcmp(argv[i], "-tsStart") == 0) {
+      tsStart = atoll(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-tsEnd") == 0) {
+      tsEnd = atoll(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-slices") == 0) {
+      nSlices = atoi(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-sliceTypes") == 0) {
+      sliceTypes = argv[i+1];
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-ebWindow") == 0) {
+      ebWindow = atoll(argv[i+1]);
+      if (ebWindow < 1) { ebWindow = 1; }
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-ebLookBack") == 0) {
+      ebLookBack = atoll(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-metrics") == 0) {
+      metricsFile = argv[i+1];
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-metricsPeriod") == 0) {
+      metricsPeriod = atof(argv[i+1]);
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-trace") == 0) {
+      traceFile = argv[i+1];
+      i += 2;
+    }
+    else if (strcmp(argv[i], "-memReport") == 0) {
+      memReportFile = argv[i+1];
+      i += 2;
+    }
     else if (strcmp(argv[i], "-dopplerSimple") == 0) {
       dopplerSimple = 1;
       i++;
@@ -629,6 +722,9 @@ void counterVariables::Initialize() {
     crystalBuildEventXtal[i] = 0; totalCrystalEventXtal[i] = 0;
   }
   tossed4Time = 0;
+  screenChecked = 0; screenFlagged = 0;
+  screenTruncated = 0; screenSaturated = 0; screenPileupFPGA = 0; screenPileup = 0;
+  screenSkippedSamples = 0; screenSkippedSP = 0;
 
   for (Int_t i=0; i<4*MAXCRYSTALS; i++) { /* 4 boards/crystal */
     lastBdTS[i] = 0;
@@ -677,6 +773,9 @@ void counterVariables::ResetRunCounters() {
     crystalBuildEventXtal[i] = 0; totalCrystalEventXtal[i] = 0;
   }
   tossed4Time = 0;
+  screenChecked = 0; screenFlagged = 0;
+  screenTruncated = 0; screenSaturated = 0; screenPileupFPGA = 0; screenPileup = 0;
+  screenSkippedSamples = 0; screenSkippedSP = 0;
 
   for (Int_t i=0; i<(MAXCRYSTALS*4); i++) {
     lastBdTS[i] = 0;
@@ -784,6 +883,23 @@ void counterVariables::PrintRunStatistics(Int_t pgh, Int_t withWAVE, Int_t super
     std::cout << nMode3NoMode2[0] << std::endl << std::endl;
   }
 
+  if (screenChecked > 0) {
+    std::cout << PrintOutput("\n\t\t Mode3 trace screening: ", "blue") << screenChecked
+	      << PrintOutput(" traces checked, ", "blue") << screenFlagged
+	      << PrintOutput(" flagged (", "blue") << (float)(100*screenFlagged)/screenChecked
+	      << PrintOutput("%)\n", "blue");
+    std::cout << PrintOutput("\t\t  truncated:          ", "blue") << screenTruncated << std::endl;
+    std::cout << PrintOutput("\t\t  saturated:          ", "blue") << screenSaturated << std::endl;
+    std::cout << PrintOutput("\t\t  pile-up, FPGA flag: ", "blue") << screenPileupFPGA << std::endl;
+    std::cout << PrintOutput("\t\t  pile-up, 2nd edge:  ", "blue") << screenPileup << std::endl;
+    std::cout << PrintOutput("\t\t  skipped: ", "blue") << screenFlagged
+	      << PrintOutput(" CFDs (", "blue") << screenSkippedSamples << PrintOutput(" samples)", "blue");
+    if (superPulse) {
+      std::cout << PrintOutput(", ", "blue") << screenSkippedSP << PrintOutput(" superpulse traces", "blue");
+    }
+    std::cout << std::endl;
+  }
+
   /* This is a little antiquated... from the days of missing FPGA energies,
      etc.  I'll keep it around for now, to remember how much the early data sucked. */
 
@@ -0,0 +1,202 @@
+#include "StageMetrics.h"
+
+#include <ctime>
+#include <iostream>
+
+StageMetrics *gMetrics = NULL;
+bool gCountAllocs = false;
+
+allocCounters& AllocCounters() {
+    static thread_local allocCounters counters = {0, 0};
+    return counters;
+}
+
+/* Records are checked for every this many Poll() calls */
+#define METRICS_POLL_EVERY 1024
+
+static std::vector<std::string>& StageNames() {
+    static std::vector<std::string> names;
+    return names;
+}
+
+int StageMetrics::Id(const std::string& name) {
+    std::vector<std::string>& names = StageNames();
+    for(size_t i = 0; i < names.size(); i++) {
+        if(names[i] == name) { return i; }
+    }
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+const std::string& StageMetrics::Name(int id) {
+    static const std::string unknown = "unknown";
+    std::vector<std::string>& names = StageNames();
+    return (id >= 0 && id < (int)names.size()) ? names[id] : unknown;
+}
+
+std::string SiblingFileName(const std::string& fileName, const std::string& tag) {
+    std::string name = fileName;
+    size_t dot = name.rfind('.');
+    if(dot == std::string::npos || name.find('/', dot) != std::string::npos) { dot = name.size(); }
+    name.insert(dot, tag);
+    return name;
+}
+
+StageMetrics::StageMetrics(std::string fileName, double period, std::string job) {
+    this->fileName = fileName;
+    this->job = job;
+    this->period = (period > 0) ? period : 10.;
+    prometheus = (fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".prom") == 0);
+
+    out = NULL;
+    if(!prometheus) {
+        out = fopen(fileName.c_str(), "a");
+        if(!out) { std::cerr << "StageMetrics: cannot open " << fileName << std::endl; }
+    }
+
+    gCountAllocs = true;
+    start = std::chrono::steady_clock::now();
+    lastWrite = start;
+    polls = 0;
+}
+
+StageMetrics::~StageMetrics() {
+    Write();
+    if(out) { fclose(out); }
+}
+
+StageMetrics::Stage& StageMetrics::At(int id) {
+    if(id >= (int)stages.size()) {
+        Stage empty = {0, 0, 0., 0, 0, 0., 0, 0};
+        stages.resize(id + 1, empty);
+    }
+    return stages[id];
+}
+
+void StageMetrics::Add(int id, double seconds, long long count, long long bytes) {
+    Stage& s = At(id);
+    s.count += count;
+    s.bytes += bytes;
+    s.seconds += seconds;
+}
+
+void StageMetrics::AddAllocations(int id, long long allocs, long long allocBytes) {
+    Stage& s = At(id);
+    s.allocs += allocs;
+    s.allocBytes += allocBytes;
+}
+
+void StageMetrics::Count(int id, long long count, long long bytes) {
+    Add(id, 0., count, bytes);
+}
+
+void StageMetrics::Poll() {
+    if(++polls < METRICS_POLL_EVERY) { return; }
+    polls = 0;
+
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - lastWrite;
+    if(dt.count() >= period) { Write(); }
+}
+
+void StageMetrics::Write() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - start;
+    std::chrono::duration<double> interval = now - lastWrite;
+    lastWrite = now;
+
+    if(prometheus) { WritePrometheus(elapsed.count()); }
+    else { WriteJSON(elapsed.count(), interval.count()); }
+
+    for(size_t i = 0; i < stages.size(); i++) {
+        stages[i].lastCount = stages[i].count;
+        stages[i].lastBytes = stages[i].bytes;
+        stages[i].lastSeconds = stages[i].seconds;
+    }
+}
+
+/* One line per record: totals since the start, plus rates over the last
+   interval, e.g.
+   {"job":"unpackGRETINA","time":1700000000,"elapsed":10.0,"stages":{
+    "GetData.mode2":{"count":..,"seconds":..,"bytes":..,"perSecond":..,
+                     "MBperSecond":..,"meanUs":..},...}} */
+void StageMetrics::WriteJSON(double elapsed, double interval) {
+    if(!out) { return; }
+    std::vector<std::string>& names = StageNames();
+    if(interval <= 0) { interval = 1e-9; }
+
+    fprintf(out, "{\"job\":\"%s\",\"time\":%ld,\"elapsed\":%.3f,\"stages\":{",
+            job.c_str(), (long)time(NULL), elapsed);
+    bool first = true;
+    for(size_t i = 0; i < stages.size(); i++) {
+        const Stage& s = stages[i];
+        if(s.count == 0 && s.bytes == 0) { continue; }
+        long long dCount = s.count - s.lastCount;
+        long long dBytes = s.bytes - s.lastBytes;
+        double dSeconds = s.seconds - s.lastSeconds;
+        fprintf(out, "%s\"%s\":{\"count\":%lld,\"seconds\":%.6f,\"bytes\":%lld,"
+                "\"perSecond\":%.1f,\"MBperSecond\":%.3f,\"meanUs\":%.3f,"
+                "\"allocs\":%lld,\"allocBytes\":%lld}",
+                first ? "" : ",", names[i].c_str(), s.count, s.seconds, s.bytes,
+                dCount/interval, dBytes/interval/(1024.*1024.),
+                dCount ? 1e6*dSeconds/dCount : 0., s.allocs, s.allocBytes);
+        first = false;
+    }
+    fprintf(out, "}}\n");
+    fflush(out);
+}
+
+/* Counters only -- rates are left to the scraper (rate() in PromQL) */
+void StageMetrics::WritePrometheus(double elapsed) {
+    std::vector<std::string>& names = StageNames();
+    std::string tmpName = fileName + ".tmp";
+    FILE *prom = fopen(tmpName.c_str(), "w");
+    if(!prom) { return; }
+
+    fprintf(prom, "# TYPE goddess_elapsed_seconds gauge\n");
+    fprintf(prom, "goddess_elapsed_seconds{job=\"%s\"} %.3f\n", job.c_str(), elapsed);
+
+    const char *metric[5] = {"goddess_stage_calls_total", "goddess_stage_seconds_total",
+                             "goddess_stage_bytes_total", "goddess_stage_allocs_total",
+                             "goddess_stage_alloc_bytes_total"};
+    for(int m = 0; m < 5; m++) {
+        fprintf(prom, "# TYPE %s counter\n", metric[m]);
+        for(size_t i = 0; i < stages.size(); i++) {
+            const Stage& s = stages[i];
+            if(s.count == 0 && s.bytes == 0) { continue; }
+            fprintf(prom, "%s{job=\"%s\",stage=\"%s\"} ", metric[m], job.c_str(), names[i].c_str());
+            if(m == 0) { fprintf(prom, "%lld\n", s.count); }
+            else if(m == 1) { fprintf(prom, "%.6f\n", s.seconds); }
+            else if(m == 2) { fprintf(prom, "%lld\n", s.bytes); }
+            else if(m == 3) { fprintf(prom, "%lld\n", s.allocs); }
+            else { fprintf(prom, "%lld\n", s.allocBytes); }
+        }
+    }
+
+    fclose(prom);
+    rename(tmpName.c_str(), fileName.c_str());
+}
+
+void StageMetrics::PrintAllocations() {
+    std::vector<std::string>& names = StageNames();
+    printf("\t\t  %-34s %12s %12s %12s\n", "stage", "calls", "allocs/call", "bytes/call");
+    for(size_t i = 0; i < stages.size(); i++) {
+        const Stage& s = stages[i];
+        if(s.count == 0) { continue; }
+        printf("\t\t  %-34s %12lld %12.2f %12.1f\n", names[i].c_str(), s.count,
+               (double)s.allocs/s.count, (double)s.allocBytes/s.count);
+    }
+}
+
+void StageMetrics::WriteAllocationsJSON(FILE *out) {
+    std::vector<std::string>& names = StageNames();
+    bool first = true;
+    fprintf(out, "{");
+    for(size_t i = 0; i < stages.size(); i++) {
+        const Stage& s = stages[i];
+        if(s.count == 0) { continue; }
+        fprintf(out, "%s\n \"%s\":{\"calls\":%lld,\"allocs\":%lld,\"allocBytes\":%lld}",
+                first ? "" : ",", names[i].c_str(), s.count, s.allocs, s.allocBytes);
+        first = false;
+    }
+    fprintf(out, "}");
+}
@@ -9,6 +9,14 @@
 
 ClassImp(SuperPulse);
 
+spCrystal::spCrystal() {
+  memset(waves, 0, sizeof(waves));
+  memset(averageTrace, 0, sizeof(averageTrace));
+  memset(averageTraceINT, 0, sizeof(averageTraceINT));
+}
+
+/****************************************************/
+
 void SuperPulse::Initialize(controlVariables* ctrl, GRETINAVariables* gVar) {
   CFD_INT_LEN = 4;
   CFD_DELAY = 4;
@@ -264,12 +272,13 @@ void SuperPulse::MakeSuperPulses() {
       if (segE[i] >= lowE && ccE[i] >= lowE && segE[i] <= highE && ccE[i] <= highE) {
 	Int_t t0 = AlignCFD(i);
 	if (t0 >= 0) { /* CFD alignment was successful. */
+	  spCrystal *c = Crystal(i);
 	  data4net[i][netSeg[i]]++;
 	  for (Int_t m=0; m<37; m++) { /* 36 segments + 1 CC only */
 	    for (Int_t j=0; j<AVG_TR_LENGTH; j++) {
 	      /* We fill one giant array with all 37 traces,
 		 with small gaps between waveforms. */
-	      averageTrace[i][netSeg[i]][m*(AVG_TR_STRIDE) + j] += waves[i][m][j];
+	      c->averageTrace[netSeg[i]][m*(AVG_TR_STRIDE) + j] += c->waves[m][j];
 	    } /* Loop over waveform samples */
 	  } /* Loop over segments */
 	} /* if CFD alignment is OK */
@@ -286,6 +295,7 @@ void SuperPulse::MakeSuperPulses() {
 Int_t SuperPulse::AlignCFD(Int_t crystalNum) {
   Int_t i, j, k;
   Float_t t=0, tmin = 1000.0;
+  Int_t (*waves)[2048] = Crystal(crystalNum)->waves;
 
   /* Find the time to align to. */
   for (j=0; j<40; j++) {
@@ -303,19 +313,19 @@ Int_t SuperPulse::AlignCFD(Int_t crystalNum) {
   if (i < 0) {
     for (j=0; j<40; j++) {
       for (k=trLength - 2; k > (0-i); k--) {
-	waves[crystalNum][j][k] = waves[crystalNum][j][k+i];
+	waves[j][k] = waves[j][k+i];
       }
       for (k=0; k<(0-i); k++) {
-	waves[crystalNum][j][k] = 0;
+	waves[j][k] = 0;
       }
     }
   } else {
     for (j=0; j<40; j++) {
       for (k=0; k<=trLength - i - 2; k++) {
-	waves[crystalNum][j][k] = waves[crystalNum][j][k+i];
+	waves[j][k] = waves[j][k+i];
       }
       for (k=trLength - i - 1; k<trLength; k++) {
-	waves[crystalNum][j][k] = waves[crystalNum][j][trLength-2];
+	waves[j][k] = waves[j][trLength-2];
       }
     }
   }
@@ -331,17 +341,18 @@ Float_t SuperPulse::cfdTime(Int_t crystalNum, Int_t segNum) {
   Int_t deriv[2048];
   Int_t cfd[2048];
   Int_t i, imax = 0, max_deriv = 0;
+  const Int_t *wave = Crystal(crystalNum)->waves[segNum];
 
   deriv[0] = 0;
   for (i=0; i< CFD_INT_LEN; i++) {
-    deriv[0] += (waves[crystalNum][segNum][i+CFD_INT_LEN] -
-		 waves[crystalNum][segNum][i]);
+    deriv[0] += (wave[i+CFD_INT_LEN] -
+		 wave[i]);
   }
   for (i=1; i<trLength - 5 - 2*CFD_INT_LEN; i++) {
     deriv[i] = (deriv[i-1] +
-		waves[crystalNum][segNum][i+2*CFD_INT_LEN] -
-		2*waves[crystalNum][segNum][i+CFD_INT_LEN] +
-		waves[crystalNum][segNum][i]);
+		wave[i+2*CFD_INT_LEN] -
+		2*wave[i+CFD_INT_LEN] +
+		wave[i]);
     if (max_deriv < deriv[i]) {
       max_deriv = deriv[i];
       imax = i;
@@ -367,20 +378,23 @@ void SuperPulse::FinishSuperPulses() {
   /* Scale the superpulses, and get the trace gains. */
 
   for (Int_t i=0; i<MAXCRYSTALS; i++) {
+    if (!xtal[i]) { continue; } /* Never hit */
+    Float_t (*averageTrace)[4096] = xtal[i]->averageTrace;
+    Int_t (*averageTraceINT)[4096] = xtal[i]->averageTraceINT;
 
     for (Int_t j=0; j<36; j++) {
-      gain[i][j] = (((Float_t)averageTrace[i][j][j*AVG_TR_STRIDE + AVG_TR_LENGTH - 1]) /
-		    ((Float_t)averageTrace[i][j][36*AVG_TR_STRIDE + AVG_TR_LENGTH - 1]));
+      gain[i][j] = (((Float_t)averageTrace[j][j*AVG_TR_STRIDE + AVG_TR_LENGTH - 1]) /
+		    ((Float_t)averageTrace[j][36*AVG_TR_STRIDE + AVG_TR_LENGTH - 1]));
     }
 
     gain[i][36] = 1.0f;
 
     for (Int_t j=0; j<36; j++) {
-      Float_t scaleFactor = TR_SCALE / ((Float_t)averageTrace[i][j][36*AVG_TR_STRIDE + AVG_TR_LENGTH -1]);
+      Float_t scaleFactor = TR_SCALE / ((Float_t)averageTrace[j][36*AVG_TR_STRIDE + AVG_TR_LENGTH -1]);
       for (Int_t k=0; k<37; k++) {
 	for (Int_t m=0; m<AVG_TR_LENGTH; m++) {
-	  averageTrace[i][j][k*AVG_TR_STRIDE + m] = ((Float_t)averageTrace[i][j][k*AVG_TR_STRIDE + m])*scaleFactor/gain[i][k];
-	  averageTraceINT[i][j][k*AVG_TR_STRIDE + m] = (Int_t)averageTrace[i][j][k*AVG_TR_STRIDE + m];
+	  averageTrace[j][k*AVG_TR_STRIDE + m] = ((Float_t)averageTrace[j][k*AVG_TR_STRIDE + m])*scaleFactor/gain[i][k];
+	  averageTraceINT[j][k*AVG_TR_STRIDE + m] = (Int_t)averageTrace[j][k*AVG_TR_STRIDE + m];
 	}
       }
     }
@@ -391,14 +405,14 @@ void SuperPulse::FinishSuperPulses() {
 
 void SuperPulse::WriteSuperPulses() {
   for (Int_t i=0; i<MAXCRYSTALS; i++) {
-    if (data4net[i][0] > 0 || data4net[i][1] > 0) {
+    if (xtal[i] && (data4net[i][0] > 0 || data4net[i][1] > 0)) {
       char filenameOut[1024];
       sprintf(filenameOut, "SPCrystal%d_%d.spn", i, (Int_t)((lowE + highE)/2));
       std::cout << "Writing superpulses to " << filenameOut << std::endl;
 
       FILE *spOut = fopen(filenameOut, "wb");
       for (Int_t j=0; j<36; j++) {
-	fwrite(averageTraceINT[i][j], sizeof(Int_t), 4096, spOut);
+	fwrite(xtal[i]->averageTraceINT[j], sizeof(Int_t), 4096, spOut);
       }
       fclose(spOut);
       printf("Superpulse statistics:\n");
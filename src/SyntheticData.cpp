@@ -0,0 +1,214 @@
+#include "SyntheticData.h"
+#include "GRETINA.h"
+#include "S800Definitions.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <TMath.h>
+
+#define LDF_BUFFER_LENGTH 8194
+#define LDF_DATA 0x41544144
+
+SyntheticData::SyntheticData(UInt_t seed) : rand(seed) { }
+
+void SyntheticData::Pulse(std::vector<Short_t> &trace, Int_t length, Float_t amplitude,
+                          Float_t t0, Float_t riseTime, Float_t tau, Float_t baseline,
+                          Float_t noise) {
+    trace.resize(length);
+    if(riseTime < 1) { riseTime = 1; }
+    for(Int_t i = 0; i < length; i++) {
+        Double_t t = i - t0;
+        Double_t s = 0;
+        if(t > riseTime) { s = amplitude*exp(-(t - riseTime)/tau); }
+        else if(t > 0) { s = amplitude*t/riseTime; }
+        s += baseline + rand.Gaus(0, noise);
+        if(s > 32767) { s = 32767; }
+        if(s < -32768) { s = -32768; }
+        trace[i] = (Short_t)lrint(s);
+    }
+}
+
+void SyntheticData::Mode2(std::vector<UChar_t> &payload, Int_t crystalID, Long64_t timestamp,
+                          Float_t energy, Int_t nIntPts) {
+    mode2ABCD6789 g2;
+    memset(&g2, 0, sizeof(g2));
+
+    if(nIntPts < 1) { nIntPts = 1; }
+    if(nIntPts > MAX_INTPTS) { nIntPts = MAX_INTPTS; }
+
+    g2.type = (Int_t)0xabcd6789;
+    g2.crystal_id = crystalID;
+    g2.num = nIntPts;
+    g2.tot_e = energy;
+    g2.timestamp = timestamp;
+    g2.t0 = rand.Gaus(0, 5);
+    g2.chisq = rand.Exp(1.);
+    g2.norm_chisq = g2.chisq;
+    g2.totE_fixedPickOff_current = energy;
+    g2.totE_fixedPickOff_prior1 = rand.Uniform(0, 2000);
+    g2.totE_fixedPickOff_prior2 = rand.Uniform(0, 2000);
+    g2.deltaT_prior1 = rand.Integer(65536);
+    g2.deltaT_prior2 = rand.Integer(65536);
+    g2.prestep = rand.Gaus(0, 10);
+    g2.poststep = rand.Gaus(0, 10);
+    for(Int_t i = 0; i < 4; i++) { g2.core_e[i] = (Int_t)(energy*32); }
+
+    /* Split the energy over the points, positions inside the crystal (mm);
+       the segment follows from the position, 6 sectors x 6 slices */
+    Double_t weight[MAX_INTPTS], sum = 0;
+    for(Int_t i = 0; i < nIntPts; i++) { weight[i] = rand.Uniform(0.1, 1.); sum += weight[i]; }
+    for(Int_t i = 0; i < nIntPts; i++) {
+        Double_t r = 35.*sqrt(rand.Uniform());
+        Double_t phi = rand.Uniform(0, 2*TMath::Pi());
+        Double_t z = rand.Uniform(0, 89.99);
+        g2.intpts[i].x = r*cos(phi);
+        g2.intpts[i].y = r*sin(phi);
+        g2.intpts[i].z = z;
+        g2.intpts[i].e = energy*weight[i]/sum;
+        g2.intpts[i].seg = ((Int_t)(z/15.))*6 + (Int_t)(phi/(2*TMath::Pi())*6);
+        g2.intpts[i].seg_energy = g2.intpts[i].e;
+    }
+
+    const UChar_t *p = (const UChar_t*)&g2;
+    payload.insert(payload.end(), p, p + sizeof(g2));
+}
+
+/* Big endian 16-bit word, as getMode3() expects before its byte swap */
+static void PushWord(std::vector<UChar_t> &payload, UShort_t w) {
+    payload.push_back((w >> 8) & 0xff);
+    payload.push_back(w & 0xff);
+}
+
+void SyntheticData::Mode3(std::vector<UChar_t> &payload, Int_t module, Int_t channel,
+                          Long64_t timestamp, Float_t energy, Int_t traceLength) {
+    if(traceLength < 2) { traceLength = 2; }
+    traceLength += (traceLength % 2);
+    if(traceLength > MAX_TRACE_LENGTH - 2) { traceLength = MAX_TRACE_LENGTH - 2; }
+
+    Bool_t cc = (channel%10 == 9);
+    UShort_t hdr[14];
+    memset(hdr, 0, sizeof(hdr));
+
+    /* Energy in 1/32 units, 24 bits; segments are stored negated */
+    UInt_t e = (UInt_t)(energy*4*32) & 0x00ffffff;
+    if(!cc && e) { e = (0x01000000 - e) & 0x00ffffff; }
+
+    hdr[0] = ((traceLength + 14)/2) & 0x7ff;
+    hdr[1] = ((module & 0xfff) << 4) | (channel & 0xf);
+    hdr[2] = (timestamp >> 16) & 0xffff;
+    hdr[3] = timestamp & 0xffff;
+    hdr[4] = e & 0xffff;
+    hdr[5] = (timestamp >> 32) & 0xffff;
+    hdr[6] = rand.Integer(65536);
+    hdr[7] = ((e >> 16) & 0xff) | ((!cc && e) ? 0x0100 : 0);
+    hdr[8] = hdr[4];
+    hdr[9] = rand.Integer(65536);
+    hdr[11] = hdr[7] & 0x01ff;
+
+    PushWord(payload, 0xAAAA);
+    PushWord(payload, 0xAAAA);
+    for(Int_t i = 0; i < 14; i++) { PushWord(payload, hdr[i]); }
+
+    std::vector<Short_t> trace;
+    Pulse(trace, traceLength, energy*2 > 8000 ? 8000 : energy*2, traceLength/4.,
+          rand.Uniform(5, 15), 5000., rand.Gaus(0, 50), 3.);
+
+    /* Samples come in swapped pairs, segments with inverted sign */
+    for(Int_t i = 0; i < traceLength; i += 2) {
+        Short_t s0 = cc ? trace[i] : -trace[i];
+        Short_t s1 = cc ? trace[i + 1] : -trace[i + 1];
+        PushWord(payload, (UShort_t)s1);
+        PushWord(payload, (UShort_t)s0);
+    }
+}
+
+void SyntheticData::S800Event(std::vector<UChar_t> &payload, Long64_t timestamp) {
+    UShort_t w[15];
+    Int_t n = 0;
+
+    /* Two leading words the parser skips, then one S800 packet: length,
+       tag, version and the subpackets, each with its own length and tag */
+    w[n++] = 15;
+    w[n++] = 0;
+    w[n++] = 13;
+    w[n++] = S800_PACKET;
+    w[n++] = S800_VERSION;
+
+    w[n++] = 4;
+    w[n++] = S800_TRIGGER_PACKET;
+    w[n++] = 0x0001;                                    /* trigger register */
+    w[n++] = 0x8000 | (UShort_t)rand.Integer(4096);     /* S800 trigger time */
+
+    w[n++] = 6;
+    w[n++] = S800_TIMESTAMP_PACKET;
+    for(Int_t i = 0; i < 4; i++) { w[n++] = (timestamp >> (16*i)) & 0xffff; }
+
+    const UChar_t *p = (const UChar_t*)w;
+    payload.insert(payload.end(), p, p + n*sizeof(UShort_t));
+}
+
+void SyntheticData::ORRUBAEvent(std::vector<UInt_t> &words, ULong64_t timestamp, Int_t nHits) {
+    std::vector<Int_t> channels;
+    while((Int_t)channels.size() < nHits && channels.size() < 700) {
+        Int_t ch = 1 + rand.Integer(700);
+        Bool_t used = false;
+        for(size_t i = 0; i < channels.size(); i++) { used = used || (channels[i] == ch); }
+        if(!used) { channels.push_back(ch); }
+    }
+
+    /* Channel in the low half, value in the high half: UnpackORRUBA swaps
+       the halves back */
+    for(size_t i = 0; i < channels.size(); i++) {
+        UInt_t value = 100 + rand.Integer(16000);
+        words.push_back((value << 16) | channels[i]);
+    }
+    for(Int_t i = 0; i < 3; i++) {
+        UInt_t value = (timestamp >> (16*i)) & 0xffff;
+        words.push_back((value << 16) | (1000 + i));
+    }
+    words.push_back(0xffffffff);
+}
+
+Int_t SyntheticData::WriteLDF(FILE *out, const std::vector<UInt_t> &words) {
+    UInt_t buffer[LDF_BUFFER_LENGTH];
+    Int_t nBuffers = 0;
+    size_t pos = 0;
+
+    while(pos < words.size()) {
+        Int_t n = 2;
+        memset(buffer, 0xff, sizeof(buffer));
+        buffer[0] = LDF_DATA;
+
+        /* Whole events only */
+        while(pos < words.size()) {
+            size_t end = pos;
+            while(end < words.size() && words[end] != 0xffffffff) { end++; }
+            if(end < words.size()) { end++; }
+            if(n + (Int_t)(end - pos) > LDF_BUFFER_LENGTH) {
+                if(n == 2) { end = pos + LDF_BUFFER_LENGTH - 2; }  /* too long for any buffer */
+                else { break; }
+            }
+            for(size_t i = pos; i < end; i++) { buffer[n++] = words[i]; }
+            pos = end;
+        }
+
+        buffer[1] = n - 2;
+        if(fwrite(buffer, sizeof(buffer), 1, out) != 1) { return -1; }
+        nBuffers++;
+    }
+
+    return nBuffers;
+}
+
+Int_t SyntheticData::WriteGEB(FILE *out, Int_t type, Long64_t timestamp,
+                              const std::vector<UChar_t> &payload) {
+    globalHeader h;
+    h.type = type;
+    h.length = payload.size();
+    h.timestamp = timestamp;
+
+    if(fwrite(&h, sizeof(h), 1, out) != 1) { return -1; }
+    if(!payload.empty() && fwrite(&payload[0], payload.size(), 1, out) != 1) { return -1; }
+    return sizeof(h) + payload.size();
+}
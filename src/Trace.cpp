@@ -0,0 +1,80 @@
+#include "Trace.h"
+#include "StageMetrics.h"
+
+#include <iostream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+Trace *gTrace = NULL;
+
+/* Events kept in memory before a block is written */
+#define TRACE_BLOCK 16384
+/* Recording stops after this many events (about 100 bytes each) */
+#define TRACE_MAX_EVENTS 5000000
+
+static int ThreadId() {
+    static thread_local int tid = (int)syscall(SYS_gettid);
+    return tid;
+}
+
+Trace::Trace(std::string fileName, std::string process) {
+    this->fileName = fileName;
+    this->process = process;
+    pid = (int)getpid();
+    recorded = 0;
+    dropped = 0;
+    events.reserve(TRACE_BLOCK);
+
+    out = fopen(fileName.c_str(), "w");
+    if(!out) { std::cerr << "Trace: cannot open " << fileName << std::endl; return; }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            pid, pid, process.c_str());
+}
+
+Trace::~Trace() {
+    if(!out) { return; }
+    Flush();
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    if(dropped) {
+        std::cerr << "Trace: " << dropped << " events after the first " << TRACE_MAX_EVENTS
+                  << " not written to " << fileName << std::endl;
+    }
+}
+
+double Trace::Now() {
+    return Micro(std::chrono::steady_clock::now());
+}
+
+void Trace::Complete(int id, double start, double duration) {
+    std::lock_guard<std::mutex> guard(lock);
+    if(!out) { return; }
+    if(recorded >= TRACE_MAX_EVENTS) { dropped++; return; }
+
+    Event e = {id, ThreadId(), start, duration};
+    events.push_back(e);
+    recorded++;
+    if(events.size() >= TRACE_BLOCK) { Flush(); }
+}
+
+/* Called with the lock held (or from the destructor) */
+void Trace::Flush() {
+    for(size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+
+        bool named = false;
+        for(size_t t = 0; t < threads.size(); t++) { named = named || (threads[t] == e.tid); }
+        if(!named) {
+            threads.push_back(e.tid);
+            fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    pid, e.tid, (e.tid == pid) ? "main" : "worker");
+        }
+
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                StageMetrics::Name(e.id).c_str(), pid, e.tid, e.start, e.duration);
+    }
+    events.clear();
+    fflush(out);
+}
@@ -1,7 +1,11 @@
 #include "Track.h"
+#include "TrackPool.h"
 
 #include "Globals.h"
 
+#include <algorithm>
+#include <cmath>
+
 ClassImp(TrackClusterIP);
 ClassImp(TrackCluster);
 ClassImp(TrackShell);
@@ -176,13 +180,13 @@ Int_t TrackCluster::sortSegEnergies() {
 }
 
 void TrackCluster::Reset() {
-  nDet = 0;  eSum = 0;  tracked = 0;  valid = 1;  FOM = MAXFOM;
+  nDet = 0;  eSum = 0;  tracked = 0;  valid = 1;  FOM = MAXFOM;  nPermEval = 0;
   for (Int_t k=0; k<MAXNUMDET; k++) { intpts[k].order = -1; }
 }
 
 void TrackCluster::Clear() {
   valid = 0; nDet = 0; tracked = 0; FOM = 0.0; eSum = 0.0;
-  trackNum = 0; bestPermutation = 0; processed = 0;
+  trackNum = 0; bestPermutation = 0; nPermEval = 0; processed = 0;
   for (Int_t k=0; k<MAXNUMDET; k++) {
     intpts[k].xyz.SetXYZ(0., 0., 0.); intpts[k].eDet = 0.;
     intpts[k].order = 0; intpts[k].timestamp = 0;
@@ -197,7 +201,7 @@ void TrackCluster::PrintCluster() {
     printf("    valid, tracked?: %i, %i\n", valid, tracked);
     printf("    eSum, FOM: %0.3f, %0.3f\n", eSum, FOM);
     printf("    nDet: %i\n", nDet);
-    printf("    perm: %i\n", bestPermutation);
+    printf("    perm: %i (%i evaluated)\n", bestPermutation, nPermEval);
     for (Int_t j=0; j<nDet; j++) {
       if (intpts[j].order == 0) {
 	printf("----> IntPt %i:\n", j);
@@ -212,23 +216,45 @@ void TrackCluster::PrintCluster() {
 
 /**********************************************************/
 
-Double_t TrackShell::xx(Int_t i) { return xyz[i].X(); }
+Double_t TrackShell::xx(Int_t i) { return x[i]; }
+
+Double_t TrackShell::yy(Int_t i) { return y[i]; }
 
-Double_t TrackShell::yy(Int_t i) { return xyz[i].Y(); }
+Double_t TrackShell::zz(Int_t i) { return z[i]; }
 
-Double_t TrackShell::zz(Int_t i) { return xyz[i].Z(); }
+Double_t TrackShell::nxx(Int_t i) { return XYZ(i).Unit().X(); }
 
-Double_t TrackShell::nxx(Int_t i) { return xyz[i].Unit().X(); }
+Double_t TrackShell::nyy(Int_t i) { return XYZ(i).Unit().Y(); }
 
-Double_t TrackShell::nyy(Int_t i) { return xyz[i].Unit().Y(); }
+Double_t TrackShell::nzz(Int_t i) { return XYZ(i).Unit().Z(); }
 
-Double_t TrackShell::nzz(Int_t i) { return xyz[i].Unit().Z(); }
+/* TVector3::Angle(), same operations in the same order */
+Double_t TrackShell::relAngle(Int_t i, Int_t j) {
+  Double_t ptot2 = (x[i]*x[i] + y[i]*y[i] + z[i]*z[i])*(x[j]*x[j] + y[j]*y[j] + z[j]*z[j]);
+  if (ptot2 <= 0) { return (0.0); }
+  Double_t arg = (x[i]*x[j] + y[i]*y[j] + z[i]*z[j])/TMath::Sqrt(ptot2);
+  if (arg > 1.0) { arg = 1.0; }
+  if (arg < -1.0) { arg = -1.0; }
+  return (TMath::ACos(arg));
+}
 
-Double_t TrackShell::relAngle(Int_t i, Int_t j) { return xyz[i].Angle(xyz[j]); }
+Double_t TrackShell::polAngle(Int_t i) { return XYZ(i).Unit().Theta(); }
 
-Double_t TrackShell::polAngle(Int_t i) { return xyz[i].Unit().Theta(); }
+Double_t TrackShell::aziAngle(Int_t i) { return XYZ(i).Unit().Phi(); }
 
-Double_t TrackShell::aziAngle(Int_t i) { return xyz[i].Unit().Phi(); }
+/* Back to the cleared state, for the hits the last event used */
+void TrackShell::Reset() {
+  for (Int_t j=0; j<nUsed && j<MAXSHELLHITS; j++) {
+    t0[j] = -1.0;
+    chiSq[j] = -1.0; normChiSq[j] = -1.0;
+    timestamp[j] = 0; crystalID[j] = -1;
+    eDet[j] = -1.0;  eSum[j] = -1.0;
+    origPos[j] = -1;
+    detNum[j] = -1;  module[j] = -1;
+    crystalType[j] = -1;
+  }
+  nUsed = 0;
+}
 
 void TrackShell::Print() {
   printf("TrackShell::Print() -->\n");
@@ -238,8 +264,8 @@ void TrackShell::Print() {
 	 << chiSq[i] << ", " << normChiSq[i] << std::endl;
     std::cout << "    crystalID, timestamp: " << crystalID[i] << ", "
 	 << timestamp[i] << std::endl;
-    std::cout << "    (x,y,z), eDet, eSum : (" << xyz[i].X() << ", "
-	 << xyz[i].Y() << ", " << xyz[i].Z() << "), " << eDet[i]
+    std::cout << "    (x,y,z), eDet, eSum : (" << x[i] << ", "
+	 << y[i] << ", " << z[i] << "), " << eDet[i]
 	 << ", " << eSum[i] << std::endl;
   }
 }
@@ -382,6 +408,13 @@ Int_t TrackCtrl::ReadChatFile(TString fileName) {
     } else if ((p = strstr (str, "fomgoodenough")) != NULL) {
       nret = sscanf(str, "%s %f", str1, &FOMGoodEnough);
       CheckNumArgs(nret, 2, str);
+    } else if ((p = strstr (str, "branchandbound")) != NULL) {
+      nret = sscanf(str, "%s %i", str1, &branchAndBound);
+      CheckNumArgs(nret, 2, str);
+    } else if ((p = strstr (str, "beamwidth")) != NULL) {
+      nret = sscanf(str, "%s %i", str1, &beamWidth);
+      CheckNumArgs(nret, 2, str);
+      if (beamWidth < 0) { beamWidth = 0; }
     } else if ((p = strstr (str, "target_x")) != NULL) {
       nret = sscanf(str, "%s %f", str1, &targetX);
       CheckNumArgs(nret, 2, str);
@@ -656,6 +689,10 @@ void TrackCtrl::PrintPartial() {
   std::cout << PrintOutput("\t\tTRACK: Alpha = ", "blue") << alpha[2] << std::endl;
   std::cout << PrintOutput("\t\tTRACK: FOM jump = ", "blue") << FOMJump << std::endl;
   std::cout << PrintOutput("\t\tTRACK: FOM good enough = ", "blue") << FOMGoodEnough << std::endl;
+  std::cout << PrintOutput("\t\tTRACK: Full search = ", "blue");
+  if (!branchAndBound) { std::cout << "exhaustive" << std::endl; }
+  else if (beamWidth > 0) { std::cout << "branch and bound, beam width " << beamWidth << std::endl; }
+  else { std::cout << "branch and bound (exact)" << std::endl; }
   std::cout << PrintOutput("\t\tTRACK: nPrint = ", "blue") << nPrint << std::endl;
   std::cout << PrintOutput("\t\tTRACK: ---------------------------------------\n\n", "blue");
 }
@@ -737,12 +774,43 @@ void TrackStat::Zero() {
     nHit[i] = 0;
   }
   for (Int_t i=0; i<MAXNUMSEG; i++) {
+    permClusters[i] = 0;
+    permEval[i] = 0;
     for (Int_t j=0; j<MAXPERM; j++) {
       permHit[i][j] = 0;
     }
   }
 }
 
+void TrackCounts::Zero() {
+  trackingCalls = 0;
+  nPerm = 0;
+  for (Int_t i=0; i<MAXNUMSEG; i++) {
+    permClusters[i] = 0;
+    permEval[i] = 0;
+  }
+}
+
+void TrackStat::Add(const TrackCounts &c) {
+  trackingCalls += c.trackingCalls;
+  nPerm += c.nPerm;
+  for (Int_t i=0; i<MAXNUMSEG; i++) {
+    permClusters[i] += c.permClusters[i];
+    permEval[i] += c.permEval[i];
+  }
+}
+
+void TrackStat::PrintPermutations(Int_t *nPerm) {
+  std::cout << PrintOutput("\n\t\tTRACK: Permutations evaluated per cluster (full search)\n", "blue");
+  printf("\t\t  %4s %12s %12s %12s %9s\n", "nDet", "clusters", "mean", "nDet!", "fraction");
+  for (Int_t i=2; i<MAXNUMSEG; i++) {
+    if (permClusters[i] == 0) { continue; }
+    Double_t mean = (Double_t) permEval[i] / permClusters[i];
+    printf("\t\t  %4i %12lld %12.1f %12i %9.4f\n", i, permClusters[i], mean, nPerm[i], mean / nPerm[i]);
+  }
+  fflush(stdout);
+}
+
 /**********************************************************/
 
 void TrackPerm::Initialize() {
@@ -908,7 +976,7 @@ void TrackPerm::Initialize() {
 /**********************************************************/
 
 
-void Track::Initialize() {
+void Track::Initialize(TString chatFile) {
 
   {  /* Previously in setupTrack() function */
 
@@ -918,6 +986,8 @@ void Track::Initialize() {
     {  /* Previously in ctkinit() function */
       ctrl.badTheoAngPenalty = 0.0;
       ctrl.reTrack = 0;
+      ctrl.branchAndBound = 1;
+      ctrl.beamWidth = 0;
 
       for (Int_t i=0; i<MAXNUMSEG; i++) {
 	ctrl.nDetELim_lo[i] = 0;
@@ -938,7 +1008,7 @@ void Track::Initialize() {
     std::cout << PrintOutput("Done.\n", "blue") << std::endl;
   }
 
-  ctrl.ReadChatFile("track.chat");
+  ctrl.ReadChatFile(chatFile);
 
   {  /* Previously in setupTrack() function */
 
@@ -963,6 +1033,31 @@ void Track::Initialize() {
 }
 
 
+/* Clusters the last event used back to the cleared state; the rest
+   are still in it */
+void Track::resetClusters() {
+  for (Int_t i=0; i<clustUsed && i<MAXCLUSTERHITS; i++) {
+    clust[i].Clear();
+    clust[i].Reset();
+  }
+  clustUsed = 0;
+}
+
+Track::~Track() {
+  if (pool) { delete pool;  pool = NULL; }
+}
+
+/* Threads for the first tracking pass of each event: 1 tracks serially,
+   <= 0 uses all cores */
+void Track::SetThreads(Int_t nThreads) {
+  if (pool) { delete pool;  pool = NULL; }
+  if (nThreads <= 0) { nThreads = TrackPool::HardwareThreads(); }
+  if (nThreads > 1) {
+    pool = new TrackPool(this, nThreads);
+    std::cout << "\t\t" << PrintOutput("TRACK: Tracking clusters on ", "blue") << nThreads << PrintOutput(" threads", "blue") << std::endl;
+  }
+}
+
 Int_t Track::findTargetPos() {
   targetPos.SetXYZ(ctrl.targetX, ctrl.targetY, ctrl.targetZ);
   return (0);
@@ -971,6 +1066,10 @@ Int_t Track::findTargetPos() {
 Int_t Track::trackEvent() {
 
   Int_t i, j, i1, st, itNum;
+  Int_t nPass, nTrack;
+  Int_t passList[MAXCLUSTERHITS], passTrack[MAXCLUSTERHITS];
+  Int_t trackList[MAXCLUSTERHITS], trackStatus[MAXCLUSTERHITS];
+  TrackCounts trackCounts[MAXCLUSTERHITS];
 
   stat.nEvents++;
 
@@ -1013,7 +1112,8 @@ Int_t Track::trackEvent() {
   /* Sort segment energies, so groups can be skipped properly */
   for (i=0; i<nClusters; i++) { clust[i].sortSegEnergies(); }
 
-  /* Track each cluster */
+  /* Track each cluster: statistics and the clusters to track first... */
+  nPass = 0;  nTrack = 0;
   for (i=0; i<nClusters; i++) {
     if (clust[i].valid) {
       stat.trackGetCalls++;
@@ -1022,37 +1122,60 @@ Int_t Track::trackEvent() {
       stat.nHit[clust[i].nDet]++;
       stat.trackPassCnt++;
 
-      /* Find best interaction point sequence */
-      i1 = -stat.trackingCalls;
       clust[i].tracked = 0;
+      passList[nPass] = i;
+      passTrack[nPass] = -1;
       if (clust[i].nDet < MAXNUMSEG) {
 	if (ctrl.trackOps[clust[i].nDet] < 6 && ctrl.trackOps[clust[i].nDet] >= 0 && ctrl.trackOps[clust[i].nDet] != 2) {
-	  st = doTrack(ctrl.trackOps[clust[i].nDet], i);
-	  stat.trackError[ctrl.trackOps[clust[i].nDet]][st]++;
+	  passTrack[nPass] = nTrack;
+	  trackList[nTrack] = i;
+	  nTrack++;
 	} else {
 	  printf("TRACK: ctk: tracking option not known!?, option = %i\n, TRACK: Quitting...\n", ctrl.trackOps[clust[i].nDet]);
 	  exit(1);
 	}
       }
+      nPass++;
+    }
+  }
 
-      i1 += stat.trackingCalls;
-      stat.firstClusterTrackCalls += i1;
+  /* ...then find the best interaction point sequences, on the pool's
+     threads if there is one -- each doTrack() has its own cluster... */
+  if (pool) {
+    pool->Run(nTrack, trackList, trackStatus, trackCounts);
+  } else {
+    for (j=0; j<nTrack; j++) {
+      trackCounts[j].Zero();
+      trackStatus[j] = doTrack(ctrl.trackOps[clust[trackList[j]].nDet], trackList[j], trackCounts[j]);
+    }
+  }
+
+  /* ...and account for them in cluster order, as a serial loop would */
+  for (j=0; j<nPass; j++) {
+    i = passList[j];
+    i1 = 0;
+    if (passTrack[j] >= 0) {
+      st = trackStatus[passTrack[j]];
+      stat.Add(trackCounts[passTrack[j]]);
+      stat.trackError[ctrl.trackOps[clust[i].nDet]][st]++;
+      i1 = trackCounts[passTrack[j]].trackingCalls;
+    }
+    stat.firstClusterTrackCalls += i1;
 
-      /* Count good tracks with clust[i].FOM below cut */
-      stat.trackFOMokay++;
+    /* Count good tracks with clust[i].FOM below cut */
+    stat.trackFOMokay++;
 
-      /* What permutations work? */
-      stat.permHit[clust[i].nDet][clust[i].bestPermutation]++;
+    /* What permutations work? */
+    stat.permHit[clust[i].nDet][clust[i].bestPermutation]++;
 
-      /* Sanity checks */
-      if (clust[i].valid) {
-	if (clust[i].tracked) {
-	  if (clust[i].FOM > MAXFOM) {
-      std::cout << PrintOutput("\t\tTRACK: ERROR: FOM makes no sense = ", "red") << clust[i].FOM << std::endl;
-      std::cout << PrintOutput("\t\tTRACK: iCluster = ", "red") << i << std::endl;
-      std::cout << PrintOutput("\t\tTRACK: ctrl.trackOps[nDet] = ", "red") << ctrl.trackOps[clust[i].nDet] << std::endl;
-      std::cout << std::endl;
-	  }
+    /* Sanity checks */
+    if (clust[i].valid) {
+      if (clust[i].tracked) {
+	if (clust[i].FOM > MAXFOM) {
+	  std::cout << PrintOutput("\t\tTRACK: ERROR: FOM makes no sense = ", "red") << clust[i].FOM << std::endl;
+	  std::cout << PrintOutput("\t\tTRACK: iCluster = ", "red") << i << std::endl;
+	  std::cout << PrintOutput("\t\tTRACK: ctrl.trackOps[nDet] = ", "red") << ctrl.trackOps[clust[i].nDet] << std::endl;
+	  std::cout << std::endl;
 	}
       }
     }
@@ -1235,9 +1358,202 @@ Int_t Track::trackEvent() {
   return (0);
 }
 
+/* Scattering angles between the points of a cluster, once per cluster
+   instead of once per step of every permutation: theta[from][at][to]
+   is the angle at point 'at' between the legs from 'from' and to 'to',
+   from == nDet being the target.  Same vectors and TVector3::Angle()
+   as findFOM() uses, so the values are identical. */
+
+struct clusterAngles {
+  Double_t theta[MAXNUMSEG+1][MAXNUMSEG][MAXNUMSEG];
+
+  void Fill(TrackCluster *c, TVector3 targetPos);
+};
+
+void clusterAngles::Fill(TrackCluster *c, TVector3 targetPos) {
+  TVector3 u[MAXNUMSEG+1][MAXNUMSEG];
+  Int_t from, at, to, n = c->nDet;
+
+  for (at=0; at<n; at++) {
+    u[n][at] = (c->intpts[at].xyz - targetPos).Unit();
+    for (from=0; from<n; from++) {
+      if (from != at) { u[from][at] = (c->intpts[at].xyz - c->intpts[from].xyz).Unit(); }
+    }
+  }
+  for (from=0; from<=n; from++) {
+    for (at=0; at<n; at++) {
+      if (at == from) { continue; }
+      for (to=0; to<n; to++) {
+	if (to == at || to == from) { continue; }
+	theta[from][at][to] = u[from][at].Angle(u[at][to]);
+      }
+    }
+  }
+}
+
+/* FOMs of permutations taken in perm.lookup order, for the loop in
+   doTrack().  Consecutive permutations share a prefix -- all but the
+   last two points, most of the time -- and so the FOM terms of that
+   prefix; only the terms from the first changed point on are redone.
+   Same float steps as findFOM(), so the FOMs are identical. */
+
+struct permSequence {
+  clusterAngles a;
+  TrackCluster *c;
+  Int_t n;
+  Int_t prev[MAXNUMSEG];   /* Order of the last permutation */
+  Float_t fom[MAXNUMSEG];  /* fom[k]: sum of the first k terms */
+  Float_t eg[MAXNUMSEG];   /* eg[k]: gamma energy arriving at point k */
+
+  void Start(TrackCluster *c, TVector3 targetPos);
+  Float_t FOM(const Int_t *order);
+};
+
+void permSequence::Start(TrackCluster *c, TVector3 targetPos) {
+  this->c = c;
+  n = c->nDet;
+  a.Fill(c, targetPos);
+  for (Int_t k=0; k<n; k++) { prev[k] = -1; }
+  fom[0] = 0;
+  eg[0] = c->eSum;
+}
+
+Float_t permSequence::FOM(const Int_t *order) {
+  Int_t k, m = 0;
+  Float_t thc;
+  Double_t th;
+
+  while (m < n && order[m] == prev[m]) { m++; }
+  for (k=m; k<n; k++) { prev[k] = order[k]; }
+
+  /* Term k is the scatter at point k, so it needs points k-1 to k+1 */
+  for (k=((m > 0) ? m-1 : 0); k<n-1; k++) {
+    th = a.theta[(k > 0) ? order[k-1] : n][order[k]][order[k+1]];
+    c->findComptonAngle(eg[k], c->intpts[order[k]].eDet, &thc);
+    fom[k+1] = fom[k];
+    fom[k+1] += (thc - th)*(thc - th);
+    eg[k+1] = eg[k] - c->intpts[order[k]].eDet;
+  }
+
+  return (fom[n-1]);
+}
+
+/* Branch and bound over the interaction point sequences of a cluster.
+
+   The FOM of a sequence is a sum of non-negative terms, one per scatter,
+   so the sum over its first d points never exceeds the FOM of any
+   sequence starting with them; a prefix already above the best complete
+   FOM is dropped with all its (nDet-d)! completions.  Partial sums are
+   built with the same float steps as findFOM(), so complete FOMs agree
+   bit for bit, and of equal FOMs the lowest permutation number (as in
+   perm.lookup) is kept -- the result is that of the exhaustive loop.
+   The cheapest continuations are tried first to get a good bound early.
+
+   With ctrl.beamWidth > 0 only that many of the cheapest continuations
+   of each prefix are followed, which is no longer guaranteed to find
+   the minimum. */
+
+struct permSearch {
+  TrackCluster *c;
+  Int_t n, beam;
+  long long *faculty;
+  clusterAngles a;
+  Int_t seq[MAXNUMSEG];
+  Int_t used[MAXNUMSEG];
+  Float_t minFOM;
+  Int_t best;
+  Int_t nEval;
+};
+
+static void extendPermutation(permSearch &s, Int_t d, Float_t fom, Float_t eg, Int_t num) {
+  Int_t i, j, nCand = 0, rank = 0;
+  Int_t cand[MAXNUMSEG], cNum[MAXNUMSEG];
+  Float_t cFOM[MAXNUMSEG], f, thc = 0, egNext = eg;
+  Double_t th;
+  Int_t at = 0, from = 0;
+
+  if (d == s.n) {
+    s.nEval++;
+    if (fom < s.minFOM || (s.best >= 0 && fom == s.minFOM && num < s.best)) {
+      s.minFOM = fom;
+      s.best = num;
+    }
+    return;
+  }
+
+  /* Compton angle at the last point placed, then the energy it took */
+  if (d > 0) {
+    at = s.seq[d-1];
+    from = (d > 1) ? s.seq[d-2] : s.n;
+    s.c->findComptonAngle(eg, s.c->intpts[at].eDet, &thc);
+    egNext = eg - s.c->intpts[at].eDet;
+  }
+
+  /* Continuations, cheapest first (stable, ties stay in number order) */
+  for (i=0; i<s.n; i++) {
+    if (s.used[i]) { continue; }
+    f = fom;
+    if (d > 0) {
+      th = s.a.theta[from][at][i];
+      f += (thc - th)*(thc - th);
+    }
+    j = nCand++;
+    while (j > 0 && cFOM[j-1] > f) {
+      cand[j] = cand[j-1];  cFOM[j] = cFOM[j-1];  cNum[j] = cNum[j-1];
+      j--;
+    }
+    cand[j] = i;  cFOM[j] = f;  cNum[j] = num + rank*s.faculty[s.n-1-d];
+    rank++;
+  }
+  if (d > 0 && s.beam > 0 && nCand > s.beam) { nCand = s.beam; }
+
+  for (j=0; j<nCand; j++) {
+    if (cFOM[j] > s.minFOM) { continue; }
+    s.seq[d] = cand[j];
+    s.used[cand[j]] = 1;
+    extendPermutation(s, d+1, cFOM[j], egNext, cNum[j]);
+    s.used[cand[j]] = 0;
+  }
+}
+
+Float_t Track::searchPermutations(Int_t iClust, TrackCounts &counts) {
+  permSearch s;
+  Int_t at, n = clust[iClust].nDet;
+
+  s.c = &clust[iClust];
+  s.n = n;
+  s.beam = ctrl.beamWidth;
+  s.faculty = faculty;
+  s.a.Fill(&clust[iClust], targetPos);
+
+  for (at=0; at<n; at++) { s.used[at] = 0; }
+  s.minFOM = FLT_MAX;
+  s.best = -1;
+  s.nEval = 0;
+
+  extendPermutation(s, 0, 0, clust[iClust].eSum, 0);
+
+  if (s.best >= 0) { clust[iClust].bestPermutation = s.best; }
+  clust[iClust].nPermEval = s.nEval;
+  counts.nPerm += s.nEval;
+  counts.permEval[n] += s.nEval;
+
+  return (s.minFOM);
+}
+
 Int_t Track::doTrack(Int_t mode, Int_t iClust) {
-  std::cout << DCYAN;
+  TrackCounts counts;
+  Int_t st;
+
+  counts.Zero();
+  st = doTrack(mode, iClust, counts);
+  stat.Add(counts);
+  return (st);
+}
 
+/* Only writes clust[iClust] and counts (and stdout with DEBUG), so calls
+   for different clusters can run at the same time */
+Int_t Track::doTrack(Int_t mode, Int_t iClust, TrackCounts &counts) {
   Float_t FOM, minFOM;
   Int_t curPerm, k;
   Int_t index[MAXNUMSEG];
@@ -1252,10 +1568,13 @@ Int_t Track::doTrack(Int_t mode, Int_t iClust) {
   Float_t FOMcutJump;
   Int_t distNextGrp, baseJump;
 
-  stat.trackingCalls++;
+  permSequence sequence; /* FOMs for the permutation loop */
+
+  counts.trackingCalls++;
 
   /* Initialize */
   clust[iClust].FOM = 0.;
+  clust[iClust].nPermEval = 0;
 
   /* Trap single hits, which are trivial, but
      we need to mark them as tracked anyway. */
@@ -1316,8 +1635,26 @@ Int_t Track::doTrack(Int_t mode, Int_t iClust) {
     clust[iClust].eSum += clust[iClust].intpts[k].eDet;
   }
 
+  counts.permClusters[clust[iClust].nDet]++;
+
+  /* Full search as a tree search -- same best permutation as the
+     loop below, from a fraction of the FOM evaluations */
+  if (ctrl.branchAndBound && mode != 3 && mode != 4 && mode != 5) {
+    minFOM = searchPermutations(iClust, counts);
+
+    /* Normalize FOM, and return minFOM */
+    minFOM = sqrtf(minFOM) / (clust[iClust].nDet - 1);
+    clust[iClust].FOM = minFOM;
+    for (k=0; k<clust[iClust].nDet; k++) {
+      clust[iClust].intpts[perm.lookup[clust[iClust].nDet][clust[iClust].bestPermutation][k]].order = k;
+    }
+
+    return (0);
+  }
+
   /* Loop over ALL permutations, i.e. full search, not tree search */
 
+  sequence.Start(&clust[iClust], targetPos);
   minFOM = FLT_MAX;
   for (curPerm = 0; curPerm < perm.nPerm[clust[iClust].nDet]; curPerm++) {
 
@@ -1334,17 +1671,12 @@ Int_t Track::doTrack(Int_t mode, Int_t iClust) {
     if (mode == 3) { if (curPerm > 0) { oldFOM = minFOM; } }
 
     /* Count permutations we make */
-    stat.nPerm++;
-
-    eg = clust[iClust].eSum;
-
-    /* Index for FOM calculation */
-    for (k=0; k<clust[iClust].nDet; k++) {
-      clust[iClust].intpts[k].order = perm.lookup[clust[iClust].nDet][curPerm][k];
-    }
+    counts.nPerm++;
+    counts.permEval[clust[iClust].nDet]++;
+    clust[iClust].nPermEval++;
 
-    clust[iClust].findFOM(targetPos);
-    FOM = clust[iClust].FOM;
+    /* FOM of this order, as findFOM() would give it */
+    FOM = sequence.FOM(perm.lookup[clust[iClust].nDet][curPerm]);
 
     /* Keep track of the best permutation so far */
     if (FOM < minFOM) {
@@ -1410,8 +1742,6 @@ Int_t Track::doTrack(Int_t mode, Int_t iClust) {
     std::cin.get();
   }
 
-  std::cout << RESET_COLOR;
-
   /* Done */
   return (0);
 }
@@ -1511,6 +1841,7 @@ Int_t Track::reCluster(Int_t ii, Int_t m) {
       }
 
       /* Make the trial clusters */
+      useClusters(nClusters + nTrialClusters);
       for (k=0; k<nTrialClusters; k++) {
 	trialPos[k] = k + nClusters;
 	clust[trialPos[k]].nDet = 0;
@@ -1852,6 +2183,7 @@ Int_t Track::splitCluster(Int_t ii, Int_t m) {
   clust[best1].valid = 0; clust[best2].valid = 0;
 
   try1 = best2 + 1;  try2 = try1 + 1;  /* homes for trial clusters */
+  useClusters(try2 + 1);
 
   /* Try to find an optimum evaluation order */
   for (j=0; j<pNum; j++) {
@@ -2088,6 +2420,7 @@ Int_t Track::combineCluster(Int_t focusC) {
   best = nClusters; /* where the best combined cluster will end up */
   clust[best].valid = 0;
   try1 = best + 1; /* where the trial will be */
+  useClusters(try1 + 1);
 
   clust[try1] = clust[focusC];
   nBase = clust[focusC].nDet;
@@ -2218,6 +2551,7 @@ Int_t Track::matchMaker(Int_t ii, Int_t jj) {
 
   /* Two single hits are close enough to consider as a trial cluster */
   try1 = nClusters;
+  useClusters(try1 + 1);
   clust[try1].nDet = 2;
   clust[try1].eSum = clust[ii].eSum + clust[jj].eSum;
   clust[try1].intpts[0].detNum = clust[ii].intpts[0].detNum;
@@ -2278,67 +2612,98 @@ Int_t Track::matchMaker(Int_t ii, Int_t jj) {
 
 }
 
-Int_t Track::findClusters() {
-  /* This is actually just assigning cluster numbers */
-  Int_t i, j, k, i1, i2;
-
-  for (k=0; k<shell.nHit; k++) { shell.clusterNum[k] = -1; }
-
-  shell.numClusters = 0;
-
-  /* Hunt for multihit clusters */
-  for (i=0; i<shell.nHit; i++) {
-    for (j=0; j<shell.nHit; j++) {
-      if (i != j) {
-	/* Single out hits that are close */
-	if (shell.relAngle(i,j) < ctrl.alpha[shell.nHit]) {
-	  /* We have two interactions close in angle */
-	  if (shell.clusterNum[i] < 0 && shell.clusterNum[j] < 0) {
-	    /* Neither has been clustered previously, make a new cluster. */
-	    shell.clusterNum[i] = shell.numClusters;
-	    shell.clusterNum[j] = shell.numClusters;
-	    shell.numClusters++;
-	  } else if (shell.clusterNum[i] >= 0 && shell.clusterNum[j] < 0) {
-	    /* [j] should join [i]'s cluster */
-	    shell.clusterNum[j] = shell.clusterNum[i];
-	  } else if (shell.clusterNum[i] < 0  && shell.clusterNum[j] >= 0) {
-	    /* [i] should join [j]'s cluster */
-	    shell.clusterNum[i] = shell.clusterNum[j];
-	  } else if (shell.clusterNum[i] >= 0 && shell.clusterNum[j] >= 0 &&
-		     shell.clusterNum[i] != shell.clusterNum[j]) {
-	    /* Oops, colliding clusters - put them together!
-	       -. i1 is common cluster index, i2 will move to i1 */
-	    if (shell.clusterNum[i] > shell.clusterNum[j]) {
-	      i1 = shell.clusterNum[j];  i2 = shell.clusterNum[i];
-	    } else {
-	      i1 = shell.clusterNum[i];  i2 = shell.clusterNum[j];
-	    }
-
-	    for (k=0; k<shell.nHit; k++) {
-	      if (shell.clusterNum[k] == i2) {
-		shell.clusterNum[k] = i1;
-	      }
-	    }
+/* Clusters are the connected groups of hits closer than alpha in angle
+   (TrackShell::relAngle); hits without a partner get a cluster each.
+   Only hits in neighbouring cells of a grid over the unit sphere (cubes
+   of side >= alpha, so no closer pair is missed) are compared, and the
+   groups are joined by union-find -- the cost grows about linearly with
+   the number of hits instead of quadratically.  The numbering is the one
+   the old pairwise scan gave: multihit clusters in order of their first
+   hit, then the single hits in order. */
+
+#define CLUSTERGRID_MAX 64 /* Cells per axis, at most */
+
+static Int_t clusterRoot(Int_t *parent, Int_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return (i);
+}
 
-	    /* Bump everyone above i2 down by one index */
-	    for (k=0; k<shell.nHit; k++) {
-	      if (shell.clusterNum[k] > i2) {
-		shell.clusterNum[k]--;
-	      }
-	    }
+static void clusterJoin(Int_t *parent, Int_t *size, Int_t i, Int_t j) {
+  i = clusterRoot(parent, i);
+  j = clusterRoot(parent, j);
+  if (i == j) { return; }
+  if (size[i] < size[j]) { Int_t t = i;  i = j;  j = t; }
+  parent[j] = i;
+  size[i] += size[j];
+}
 
-	    shell.numClusters--;
-	  }
+Int_t Track::findClusters() {
+  /* This is actually just assigning cluster numbers */
+  Int_t i, j, k, d, n = shell.nHit;
+  Int_t parent[MAXSHELLHITS], size[MAXSHELLHITS], label[MAXSHELLHITS];
+  Int_t cx[MAXSHELLHITS], cy[MAXSHELLHITS], cz[MAXSHELLHITS];
+  Int_t odd[MAXSHELLHITS], nOdd = 0, nGrid = 0, nCell;
+  std::pair<long long, Int_t> grid[MAXSHELLHITS], *lo, *hi;
+  Double_t alpha = ctrl.alpha[n], h, mag2, x, y, z;
+
+  for (k=0; k<n; k++) { parent[k] = k;  size[k] = 1;  label[k] = -1; }
+
+  if (alpha > 0) {
+    /* Cell side, with room for rounding in relAngle() */
+    h = alpha*(1. + 1e-3) + 1e-6;
+    if (h < 2./CLUSTERGRID_MAX) { h = 2./CLUSTERGRID_MAX; }
+    nCell = (Int_t)(2./h) + 1;
+
+    /* Hits at the origin, or not finite, are compared with everyone */
+    for (k=0; k<n; k++) {
+      mag2 = shell.x[k]*shell.x[k] + shell.y[k]*shell.y[k] + shell.z[k]*shell.z[k];
+      if (!(mag2 > 0) || !std::isfinite(mag2)) { odd[nOdd++] = k;  continue; }
+      mag2 = sqrt(mag2);
+      x = shell.x[k]/mag2;  y = shell.y[k]/mag2;  z = shell.z[k]/mag2;
+      cx[k] = std::min(std::max((Int_t)((x + 1.)/h), 0), nCell - 1);
+      cy[k] = std::min(std::max((Int_t)((y + 1.)/h), 0), nCell - 1);
+      cz[k] = std::min(std::max((Int_t)((z + 1.)/h), 0), nCell - 1);
+      grid[nGrid++] = std::make_pair(((long long) cx[k]*nCell + cy[k])*nCell + cz[k], k);
+    }
+    std::sort(grid, grid + nGrid);
+
+    for (i=0; i<nGrid; i++) {
+      k = grid[i].second;
+      for (d=0; d<27; d++) {
+	Int_t ax = cx[k] + d/9 - 1, ay = cy[k] + (d/3)%3 - 1, az = cz[k] + d%3 - 1;
+	if (ax < 0 || ay < 0 || az < 0 || ax >= nCell || ay >= nCell || az >= nCell) { continue; }
+	lo = std::lower_bound(grid, grid + nGrid, std::make_pair(((long long) ax*nCell + ay)*nCell + az, -1));
+	for (hi=lo; hi<grid+nGrid && hi->first==lo->first; hi++) {
+	  j = hi->second;
+	  if (j > k && shell.relAngle(k,j) < ctrl.alpha[n]) { clusterJoin(parent, size, k, j); }
 	}
       }
     }
+
+    for (i=0; i<nOdd; i++) {
+      for (j=0; j<n; j++) {
+	if (j != odd[i] && shell.relAngle(odd[i],j) < ctrl.alpha[n]) { clusterJoin(parent, size, odd[i], j); }
+      }
+    }
   }
 
-  /* Assign single hit clusters to the rest that never
-     found any partner. */
-  for (i=0; i<shell.nHit; i++) {
-    if (shell.clusterNum[i] < 0) {
-      shell.clusterNum[i] = shell.numClusters;
+  /* Multihit clusters first, numbered in order of their first hit,
+     then the single hits */
+  shell.numClusters = 0;
+  for (k=0; k<n; k++) {
+    shell.clusterNum[k] = -1;
+    i = clusterRoot(parent, k);
+    if (size[i] > 1) {
+      if (label[i] < 0) { label[i] = shell.numClusters++; }
+      shell.clusterNum[k] = label[i];
+    }
+  }
+  for (k=0; k<n; k++) {
+    if (shell.clusterNum[k] < 0) {
+      shell.clusterNum[k] = shell.numClusters;
       shell.numClusters++;
     }
   }
@@ -2353,9 +2718,8 @@ Int_t Track::transferClusters() {
 
   /* Initialize all cluster counters
      and sum energy, valid flags, etc. */
-  for (i=0; i<MAXCLUSTERHITS; i++) {
-    clust[i].Reset();
-  }
+  resetClusters();
+  useClusters(shell.numClusters);
 
   /* Loop over all shell hits and use the cluster
      number to fill up the cluster array. */
@@ -2376,7 +2740,7 @@ Int_t Track::transferClusters() {
 
     clust[clustNum].trackNum = clustNum;
     clust[clustNum].intpts[insertPos].shellPos = i; /* Needed later */
-    clust[clustNum].intpts[insertPos].xyz = shell.xyz[i];
+    clust[clustNum].intpts[insertPos].xyz.SetXYZ(shell.x[i], shell.y[i], shell.z[i]);
     clust[clustNum].intpts[insertPos].eDet = shell.eDet[i];
     clust[clustNum].intpts[insertPos].timestamp = shell.timestamp[i];
     clust[clustNum].intpts[insertPos].t0 = shell.t0[i];
@@ -0,0 +1,95 @@
+#include "TrackPool.h"
+
+/* Below this many full-search permutations in an event, Run() does not
+   wake the workers */
+#define TRACKPOOL_MINWORK 2000
+
+TrackPool::TrackPool(Track *track, int nThreads) {
+    this->track = track;
+    n = 0;
+    iClust = NULL;
+    status = NULL;
+    counts = NULL;
+    next = 0;
+    job = 0;
+    helpers = 0;
+    active = 0;
+    stop = false;
+
+    /* The calling thread is one of them */
+    for(int i = 1; i < nThreads; i++) {
+        threads.push_back(std::thread(&TrackPool::Worker, this));
+    }
+}
+
+TrackPool::~TrackPool() {
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < threads.size(); i++) { threads[i].join(); }
+}
+
+int TrackPool::HardwareThreads() {
+    int n = (int)std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+
+void TrackPool::Work() {
+    int k;
+    while((k = next.fetch_add(1)) < n) {
+        Int_t c = iClust[k];
+        counts[k].Zero();
+        status[k] = track->doTrack(track->ctrl.trackOps[track->clust[c].nDet], c, counts[k]);
+    }
+}
+
+void TrackPool::Worker() {
+    long long seen = 0;
+    std::unique_lock<std::mutex> l(lock);
+    while(true) {
+        wake.wait(l, [&] { return stop || (job != seen && helpers > 0); });
+        if(stop) { return; }
+        seen = job;
+        helpers--;
+        active++;
+
+        l.unlock();
+        Work();
+        l.lock();
+
+        active--;
+        if(active == 0) { finished.notify_one(); }
+    }
+}
+
+void TrackPool::Run(int n, const int *iClust, int *status, TrackCounts *counts) {
+    long long work = 0;
+    for(int k = 0; k < n; k++) {
+        Int_t nDet = track->clust[iClust[k]].nDet;
+        if(nDet > 1) { work += track->perm.nPerm[nDet]; }
+    }
+
+    bool parallel = (n > 1 && work >= TRACKPOOL_MINWORK && !threads.empty());
+    {
+        std::lock_guard<std::mutex> l(lock);
+        this->n = n;
+        this->iClust = iClust;
+        this->status = status;
+        this->counts = counts;
+        next = 0;
+        if(parallel) {
+            job++;
+            helpers = ((int)threads.size() < n - 1) ? (int)threads.size() : n - 1;
+        }
+    }
+    if(parallel) { wake.notify_all(); }
+
+    Work();
+
+    /* Everything is taken; workers not in by now are not needed */
+    std::unique_lock<std::mutex> l(lock);
+    helpers = 0;
+    finished.wait(l, [&] { return active == 0; });
+}
@@ -16,6 +16,17 @@ Unpack::Unpack() {
     auto* runList = new RunList();
     auto fileList = runList->GetListOfRuns();
 
+    if(!runList->GetMetricsFile().empty()) {
+        gMetrics = new StageMetrics(runList->GetMetricsFile(), runList->GetMetricsPeriod(), "goddessSort");
+        std::cout << PrintOutput("Writing stage metrics to ", "yellow") << runList->GetMetricsFile() << std::endl;
+    }
+    if(!runList->GetTraceFile().empty()) {
+        gTrace = new Trace(runList->GetTraceFile(), "goddessSort");
+        std::cout << PrintOutput("Writing stage trace to ", "yellow") << runList->GetTraceFile() << std::endl;
+    }
+    gMemReport = new MemoryReport("goddessSort", runList->GetMemReportFile());
+    gMemReport->Snapshot("startup");
+
     std::cout << PrintOutput("Number of files to be sort = ", "yellow") << fileList.size() << std::endl;
 
     int numRuns = 0;
@@ -26,6 +37,7 @@ Unpack::Unpack() {
         if (run.unpackORRUBA) {
             auto* orruba = new UnpackORRUBA(run);
             orrubaCompleted = orruba->GetCompleted();
+            gMemReport->Sample();
         }
         else if (run.mergeTrees) { // Check if file exists for merging
             orrubaCompleted = !(gSystem->AccessPathName(run.rootPathRaw.c_str()));
@@ -35,6 +47,7 @@ Unpack::Unpack() {
         if(run.unpackGRETINA) {
             auto* gretina = new UnpackGRETINA(run);
             gretinaCompleted = gretina->GetCompleted();
+            gMemReport->Sample();
         }
         else if (run.mergeTrees) {
             gretinaCompleted = !(gSystem->AccessPathName(run.gretinaPath.c_str()));
@@ -43,12 +56,23 @@ Unpack::Unpack() {
         if (orrubaCompleted && gretinaCompleted && run.mergeTrees) {
 //            CombineReader(run); //original
               CombineReader2(run); // SB, Sept 2023
+              gMemReport->Sample();
 //              CombineReaderCompare(run); // Compares the results from the two methods above, writes to disk using the original approach
         }
     }
 
     std::cout << PrintOutput("************************************************", "yellow") << std::endl;
     std::cout << PrintOutput("Finished Unpacking ", "yellow") << fileList.size() << PrintOutput(" files!", "yellow") <<  std::endl;
+
+    // GRETINA's big tables live in the unpackGRETINA child, which prints its own report;
+    // the ORRUBA arrays and the merge tables are registered where they are made
+    gMemReport->Snapshot("end");
+    gMemReport->Print();
+    gMemReport->WriteJSON();
+    delete gMemReport;  gMemReport = NULL;
+
+    if(gMetrics) { delete gMetrics;  gMetrics = NULL; }
+    if(gTrace) { delete gTrace;  gTrace = NULL; }
 }
 
 void Unpack::CombineReader(fileListStruct run) {
@@ -1490,6 +1514,8 @@ void Unpack::CombineReaderCompare(fileListStruct run) {
 
 
 void Unpack::CombineReader2(fileListStruct run) {
+    static const int mergeId = StageMetrics::Id("merge");
+    StageTimer mergeTimer(mergeId);
 
     // SC: Declare timing variables that are used in event building
     Long64_t timeThreshold, timeFoundBreak, timeNotFoundBreak;
@@ -1570,56 +1596,23 @@ void Unpack::CombineReader2(fileListStruct run) {
     timeFoundBreak = 0;
     timeNotFoundBreak = 1000;
     std::cout << "Matching indices.. " << std::endl;
-    std::vector<matchedEvents> matchedEvents_;
-
-    size_t newstart = 0;
-    for(size_t i = 0; i < orrubaTimeStamps_.size(); i++) { // SC: Loop through ORRUBA timestamps
-        size_t found_j = 0;
-        int found_index = 0;
-        Long64_t orrubaTime = orrubaTimeStamps_[i].second;
-        Bool_t found = false;
-
-        size_t best_j;
-        Long64_t closestTime = 100000;
-        Long64_t gretinaTime;
-        for(size_t j = newstart; j < gretinaTimeStamps_.size(); j++) { // SC: Loop through GRETINA timestamps
-            size_t timeDiff = fabs(orrubaTime - gretinaTimeStamps_[j].second); // SC: Find timing difference
-
-            if((timeDiff < timeThreshold) && (timeDiff < closestTime)) { // If this is closest time difference, take it
-                closestTime = fabs(orrubaTime - gretinaTimeStamps_[j].second);
-                gretinaTime = gretinaTimeStamps_[j].second;
-                best_j = gretinaTimeStamps_[j].first;
-                found_index = j;
-                found = true;
-                newstart = found_index;
-            }
-            else if(timeDiff > closestTime && found){
-                break;
-            }
-            if(timeDiff > timeNotFoundBreak && (gretinaTimeStamps_[j].second > orrubaTime)){
-                break; // SC: Looks like this breaks the statement if it seems a match isn't found
-            }
-        }
-
-        // Record ORRUBA + GRETINA timestamps
-        if(found) {
-            matchedEvents hit = {i, best_j, orrubaTime, gretinaTime};
-            matchedEvents_.push_back(hit);
-            nentriesMatched++;
-        }
-        // Record ORRUBA hits that do not have a GRETINA timestamp
-        else {
-            matchedEvents hit = {i, 0, orrubaTime, 0};
-            matchedEvents_.push_back(hit);
-        }
-
-        // Remove the first found_index elements and shift everything else down by found_index indices
-        // This is so that we don't have to loop through GRETINA events that have already been matched
-        // Don't do it for every event as it will slow it down too much. Every 500 seems to work well
-        //if((i % 500 == 0) && found) gretinaTimeStamps_.erase(gretinaTimeStamps_.begin(), gretinaTimeStamps_.begin() + found_index);
-        if(i % 10000==0) std::cout << "Progress :" << static_cast<int>(i*100./orrubaTimeStamps_.size()) << " %\r";
-    }
-
+    std::vector<matchedEvents> matchedEvents_ = MatchTimeStamps(orrubaTimeStamps_, gretinaTimeStamps_,
+                                                                timeThreshold, timeNotFoundBreak,
+                                                                nentriesMatched);
+
+    // All the merge tables are alive here, the merge's peak
+    gMemReport->Component("merge.orrubaTimeStamps", orrubaTimeStamps_.data(),
+                          orrubaTimeStamps_.size()*sizeof(orrubaTimeStamps_[0]));
+    gMemReport->Component("merge.gretinaTimeStamps", gretinaTimeStamps_.data(),
+                          gretinaTimeStamps_.size()*sizeof(gretinaTimeStamps_[0]));
+    gMemReport->Component("merge.gretinaDraw", gtimestamparr, testn*sizeof(double));
+    gMemReport->Component("merge.matchedEvents", matchedEvents_.data(),
+                          matchedEvents_.size()*sizeof(matchedEvents_[0]));
+    gMemReport->Sample();
+
+    Long64_t nentriesToMatch = orrubaTimeStamps_.size();
+    gMemReport->Component("merge.orrubaTimeStamps", NULL, 0);
+    gMemReport->Component("merge.gretinaTimeStamps", NULL, 0);
     std::vector<std::pair<Int_t,Long64_t>>().swap(gretinaTimeStamps_);
     std::vector<std::pair<Int_t,Long64_t>>().swap(orrubaTimeStamps_);
 
@@ -1631,6 +1624,23 @@ void Unpack::CombineReader2(fileListStruct run) {
     dur = std::chrono::duration_cast<std::chrono::microseconds>(cp3-cp2);
     std::cout <<  dur.count()/1.0e6 << std::endl;
 
+    static const int readTSId = StageMetrics::Id("merge.readTimestamps");
+    static const int matchId = StageMetrics::Id("merge.match");
+    static const int eventId = StageMetrics::Id("merge.event");
+    static const int fillId = StageMetrics::Id("merge.Fill");
+    static const int writeId = StageMetrics::Id("merge.write");
+    if(gMetrics) {
+        gMetrics->Add(readTSId, std::chrono::duration<double>(cp2-start).count(), nentriesORRUBA + nentriesGRETINA);
+        gMetrics->Add(matchId, std::chrono::duration<double>(cp3-cp2).count(), nentriesToMatch);
+    }
+    if(gTrace) { // cp3 is about now
+        double now = Trace::Now();
+        gTrace->Complete(readTSId, now - std::chrono::duration<double, std::micro>(cp3-start).count(),
+                         std::chrono::duration<double, std::micro>(cp2-start).count());
+        gTrace->Complete(matchId, now - std::chrono::duration<double, std::micro>(cp3-cp2).count(),
+                         std::chrono::duration<double, std::micro>(cp3-cp2).count());
+    }
+
     // Reset ORRUBA TTreeReaders
     t_ORRUBA.Restart();
 
@@ -1932,6 +1942,8 @@ void Unpack::CombineReader2(fileListStruct run) {
     // ----------------------------------------------------------------------------------------
 
     for(auto matchedEvent: matchedEvents_) {
+        StageTimer eventTimer(eventId);
+        if(gMetrics) gMetrics->Poll();
 
         // Handle ORRUBA
         tree_ORRUBA->GetEntry(matchedEvent.orrubaNumber);
@@ -2137,13 +2149,22 @@ void Unpack::CombineReader2(fileListStruct run) {
             foundGRETINA = false;
         }
 
-        tree_Combined->Fill();
+        {
+            StageTimer fillTimer(fillId);
+            tree_Combined->Fill();
+        }
         if(matchedEvent.orrubaNumber % 10000==0) std::cout << "Progress :" << static_cast<int>(matchedEvent.orrubaNumber*100.0/nentriesORRUBA) << " %\r\a";
     }
     std::cout << std::endl;
-    tree_Combined->Write();
-    f_Combined->Close();
+    {
+        StageTimer writeTimer(writeId);
+        tree_Combined->Write();
+        f_Combined->Close();
+    }
 
+    gMemReport->Sample();
+    gMemReport->Component("merge.matchedEvents", NULL, 0);
+    gMemReport->Component("merge.gretinaDraw", NULL, 0);
     f_ORRUBA->Close();
     f_GRETINA->Close();
 
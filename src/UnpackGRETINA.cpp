@@ -1,4 +1,6 @@
 #include "UnpackGRETINA.h"
+#include "MemoryReport.h"
+#include "StageMetrics.h"
 
 UnpackGRETINA::UnpackGRETINA(fileListStruct run) {
     int startClock = clock();
@@ -12,8 +14,22 @@ UnpackGRETINA::UnpackGRETINA(fileListStruct run) {
     //std::string commandString = "./unpackGRETINA -f " + globalPath + " -noHFC -suppressTS -rootName " + run.gretinaPath;
     std::string commandString = "./unpackGRETINA -f " + globalPath + " -rootName " + run.gretinaPath;
 
+    // unpackGRETINA writes its own metrics and trace next to ours: metrics.jsonl -> metrics_gretina.jsonl
+    if(gMetrics) {
+        commandString += " -metrics " + SiblingFileName(gMetrics->FileName(), "_gretina");
+    }
+    if(gTrace) {
+        commandString += " -trace " + SiblingFileName(gTrace->FileName(), "_gretina");
+    }
+    if(gMemReport && !gMemReport->FileName().empty()) {
+        commandString += " -memReport " + SiblingFileName(gMemReport->FileName(), "_gretina");
+    }
+
+    static const int unpackId = StageMetrics::Id("GRETINA.unpack");
+    StageTimer unpackTimer(unpackId);
     const char *command = commandString.c_str();
     int systemSuccess = system(command);
+    unpackTimer.Stop();
 
     if(systemSuccess != -1) completed = true;
 }
@@ -44,6 +44,8 @@
 #include "TVector3.h"
 #include "TMath.h"
 #include "TCutG.h"
+#include "TObjArray.h"
+#include "TObjString.h"
 
 /* Program header files */
 #include "Globals.h"
@@ -55,6 +57,7 @@
 #include "SortingStructures.h"
 #include "INLCorrection.h"
 #include "UnpackUtilities.h"
+#include "EventBuilder.h"
 
 /* Tracking... */
 #include "Track.h"
@@ -66,6 +69,8 @@
 
 #include "Tree.h"
 #include "Utilities.h"
+#include "StageMetrics.h"
+#include "MemoryReport.h"
 
 #define DEBUG2AND3 0
 
@@ -74,11 +79,8 @@
 void PrintHelpInformation();
 void PrintConditions();
 
-void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
-            INLCorrection *inlCor, UShort_t junk[]);
-
+void AddTypeBranch(Int_t type, counterVariables* cnt);
 void ReadMario(FILE* inf);
-void SkipData(FILE* inf, UShort_t junk[]);
 
 /****************************************************/
 
@@ -110,6 +112,24 @@ int main(int argc, char *argv[]) {
     if(good2Go != 1) {exit(-2);}
     printf("\n");
 
+    /* Time-sliced parallel sort: this process only drives the slices */
+    if(ctrl->nSlices > 1) {
+        exit(RunTimeSlices(argc, argv, ctrl));
+    }
+
+    if(ctrl->metricsFile != "") {
+        gMetrics = new StageMetrics(ctrl->metricsFile.Data(), ctrl->metricsPeriod, "unpackGRETINA");
+        std::cout << PrintOutput("\t\tWriting stage metrics to: ", "blue") << ctrl->metricsFile.Data() << std::endl;
+    }
+    if(ctrl->traceFile != "") {
+        gTrace = new Trace(ctrl->traceFile.Data(), "unpackGRETINA");
+        std::cout << PrintOutput("\t\tWriting stage trace to: ", "blue") << ctrl->traceFile.Data() << std::endl;
+    }
+    /* GEB bytes are counted by the per-type GetData.* stages (and
+       GetData.skipped in EventBuilder), all of them by GEB.loop */
+    static const Int_t writeId = StageMetrics::Id("write");
+    static const Int_t loopId = StageMetrics::Id("GEB.loop");
+
     gret = new GRETINA();
     gret->Initialize();
     gret->var.Initialize();
@@ -122,6 +142,10 @@ int main(int argc, char *argv[]) {
     /* Superpulse analysis */
     gret->sp.Initialize(ctrl, &gret->var);
 
+    /* Mode3 trace screening */
+    gret->screen.rail = ctrl->screenRail;
+    gret->screen.edge = ctrl->screenEdge;
+
     /* INL correction parameters */
     INLCorrection *inlCor = new INLCorrection();
     inlCor->Initialize(ctrl, &gret->var);
@@ -129,6 +153,7 @@ int main(int argc, char *argv[]) {
     /* Initialize tracking stuff. */
     if(ctrl->doTRACK) {
         gret->track.Initialize();
+        gret->track.SetThreads(ctrl->trackThreads);
     }
 
     /* And data arrays... */
@@ -213,8 +238,27 @@ int main(int argc, char *argv[]) {
      out of the compiled code.  I need to think about this one... */
 #include "ROOTGates.var"
 
+    /* The big tables, resident size now and at the end, peak sampled
+       every 100 MB of input */
+    MemoryReport memReport("unpackGRETINA", ctrl->memReportFile.Data());
+    memReport.Component("GRETINA", gret, sizeof(GRETINA));
+    memReport.Component("GRETINA.var.dnlLU", gret->var.dnlLU, sizeof(gret->var.dnlLU));
+    memReport.Component("GRETINA.sp (SuperPulse)", &gret->sp, sizeof(gret->sp));
+    memReport.Component("GRETINA.track", &gret->track, sizeof(gret->track));
+    memReport.Component("GRETINA.gHist", &gret->gHist, sizeof(gret->gHist));
+    memReport.Component("GRETINA.gBuf", gret->gBuf, sizeof(gret->gBuf));
+    memReport.Component("INLCorrection", inlCor, sizeof(INLCorrection));
+    memReport.Component("INLCorrection.inl", inlCor->inl, sizeof(inlCor->inl));
+    memReport.Component("INLCorrection.enl", inlCor->enl, sizeof(inlCor->enl));
+    memReport.Component("S800Full", s800, sizeof(S800Full));
+    if(gWf) {
+        memReport.Component("GRETINAWF", gWf, sizeof(GRETINAWF));
+        memReport.Component("GRETINAWF.his", gWf->his, sizeof(gWf->his));
+    }
+    memReport.Snapshot("startup");
+
     TStopwatch timer;
-    Int_t builtEvents = 0;
+    EventBuilder *builder = new EventBuilder(ctrl, cnt, inlCor, incomingBeam, outgoingBeam);
 
     /* Loop over each run given at the command line. */
     if(ctrl->fileType == "f1" || ctrl->fileType == "f2" ||
@@ -233,6 +277,7 @@ int main(int argc, char *argv[]) {
 
             Int_t fileOK = OpenInputFile(&inf, ctrl, runNumber);
             if(fileOK != 0) {exit(2);}
+            if(builder->Open(&inf) != 0) {exit(2);}
 
       if (ctrl->fileType != "f") {
 	TString runVariableFileName = ctrl->directory + "Run" + runNumber + "/Run" + runNumber + ".var";
@@ -256,6 +301,14 @@ int main(int argc, char *argv[]) {
             if(ctrl->withTREE) {
                 InitializeTree();
                 InitializeTreeS800(ctrl);
+
+                /* A time slice makes the branches of all slices before its
+                   first entry, in the order of a serial sort */
+                TObjArray *sliceTypes = ctrl->sliceTypes.Tokenize(",");
+                for(Int_t t = 0; t < sliceTypes->GetEntries(); t++) {
+                    AddTypeBranch(((TObjString*)sliceTypes->At(t))->GetString().Atoi(), cnt);
+                }
+                delete sliceTypes;
             }
 
             // teb->SetMaxTreeSize(1000000000LL); /* Max tree size is 1GB */
@@ -264,13 +317,8 @@ int main(int argc, char *argv[]) {
 
             /* Reset variables needed for unpacking, histogramming, etc. */
             cnt->ResetRunCounters();
-            Bool_t GO_FOR_BUILD = 1;
 
-            Int_t TSerrors = 0;
-            long long int currTS = 0;  long long int lastTS = 0;
-            long long int deltaEvent = 0;
             Int_t siz = 0;
-            Int_t remaining = 0;
             Int_t s800Length = 0;
             Int_t timeToOptimize = 0;
             Int_t atSTARTFile2 = 1; Int_t BonusMode3 = 0;
@@ -282,6 +330,7 @@ int main(int argc, char *argv[]) {
             /********************************************************/
 
             /* Loop over file, reading data, and building events... */
+            StageTimer loopTimer(loopId);
             if(ctrl->pgh == 0) { /* We expect global headers, so read one */
                 siz = fread(&gHeader, sizeof(struct globalHeader), 1, inf);
             }
@@ -290,6 +339,8 @@ int main(int argc, char *argv[]) {
 
                 if (gHeader.type == 1) { mode2Count++; }
 
+                if(gMetrics) { gMetrics->Poll(); }
+
                 if(cnt->TSFirst == 0 && gHeader.timestamp > 0) {cnt->TSFirst = gHeader.timestamp;}
                 cnt->TSLast = gHeader.timestamp;
 
@@ -306,83 +357,8 @@ int main(int argc, char *argv[]) {
                     }
                     ResetEvent(ctrl, cnt);
                     cnt->event = 0.0;
-                } else { /* !ctrl->noEB */
-
-                    /* We are building events (i.e. grouping by timestamp) --
-                       Check against timestamps in file being out of order... */
-
-                    if(gHeader.timestamp < lastTS) {
-                        if(!ctrl->suppressTS) {
-                            std::cout << ALERTTEXT;
-                            printf("Unpack(): TS out of order: lastTS %lld, current %lld\n",
-                                      lastTS, gHeader.timestamp);
-                            std::cout << RESET_COLOR;  fflush(stdout);
-                        }
-                        TSerrors++;
-                    }
-                    lastTS = gHeader.timestamp;
-
-                    if((gHeader.timestamp != 0) && (currTS == 0) ) {
-                        currTS = gHeader.timestamp;
-                    }
-
-                    /* Just throw out stupid events with no valid TS. */
-                    if(gHeader.timestamp != 0 && remaining != 5) {
-                        GO_FOR_BUILD = 1;
-                    } else {GO_FOR_BUILD = 0;}
-
-                    if(GO_FOR_BUILD) {
-
-                        /* Build events based on timestamp differences between the
-                           start of an event and current timestamp. */
-                        deltaEvent = (Float_t)(gHeader.timestamp - currTS);
-
-                        if(abs(deltaEvent) < EB_DIFF_TIME) {
-                            GetData(inf, ctrl, cnt, inlCor, junk);
-                            if(ctrl->superPulse) {
-                                if(gHeader.type == RAW) {
-                                    gret->sp.trLength = gret->g3Temp[0].wf.raw.size();
-                                }
-                            }
-                        } else { /* Time difference is big...old event should be closed. */
-                            builtEvents++;
-
-                            /* We need to be careful of tracelengths in superPulse analysis... */
-                            if(ctrl->superPulse) {
-                                if(gHeader.type == RAW) {
-                                    gret->sp.trLength = gret->g3Temp[0].wf.raw.size();
-                                }
-                            }
-
-                            if(ctrl->gateTree) {
-		                        Int_t pidOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
-		                        if (pidOK) { 
-		                          int evtOK = ProcessEvent(currTS, ctrl, cnt);
-		                          if (evtOK < 0) { raise(SIGINT); }
-		                        }
-                            } else {
-                                Int_t evtOK = ProcessEvent(currTS, ctrl, cnt);
-                                if (evtOK < 0) { raise(SIGINT); }
-                            }
-
-                            /* Check on gate conditions...do we write filtered output? */
-                            if(ctrl->outputON) {
-                        		Int_t writeOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
-                            } // S800 crap
-                            ResetEvent(ctrl, cnt);
-                            cnt->event = 0.0;
-
-                            /* Update timestamp information for beginning of new event,
-                                and start filling new event. */
-                            currTS = gHeader.timestamp;
-                            deltaEvent = (Float_t)(gHeader.timestamp - currTS);
-
-                            GetData(inf, ctrl, cnt, inlCor, junk);
-                        }
-                    } else { /* End of "if (GO_FOR_BUILD)" */
-                        SkipData(inf, junk);
-                        cnt->Increment(gHeader.length);
-                    }
+                } else { /* Group by timestamp into events */
+                    builder->Add(inf, junk);
                 } /* End of !ctrl->noEB */
 
                 if(cnt->bytes_read_since_last_time > 100*1024*1024) { //update every 100 MB
@@ -393,17 +369,14 @@ int main(int argc, char *argv[]) {
                     }
                     cnt->MBread+=2;
                     cnt->bytes_read_since_last_time = 0;
+                    memReport.Sample();
                 }
 
                 siz = fread(&gHeader, sizeof(struct globalHeader), 1, inf);
 
 
             } /* End of "while we still have data and no interrupt signal" */
-
-            if(ctrl->superPulse) {
-                gret->checkSPIntegrity();
-                gret->sp.MakeSuperPulses();
-            }
+            memReport.Sample();
 
             if(ctrl->outputON) {
                 Int_t writeOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
@@ -411,15 +384,25 @@ int main(int argc, char *argv[]) {
                 }
             } // S800 crap
 
-            /* Write the last event... */
-            if(ctrl->gateTree) {
-                Int_t pidOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
-                if (pidOK && ctrl->withTREE) { teb->Fill();  cnt->treeWrites++; }	
-            } else {
-                if(ctrl->withTREE) {teb->Fill();  cnt->treeWrites++;}
+            if(ctrl->noEB || !builder->Close()) {
+                if(ctrl->superPulse) {
+                    gret->checkSPIntegrity();
+                    gret->sp.MakeSuperPulses();
+                }
+
+                /* Write the last event... */
+                if(ctrl->packTraces) { gret->g3out.PackTraces(); }
+                if(ctrl->gateTree) {
+                    Int_t pidOK = CheckS800PIDGates(incomingBeam, outgoingBeam);
+                    if (pidOK && ctrl->withTREE) { teb->Fill();  cnt->treeWrites++; }
+                } else {
+                    if(ctrl->withTREE) {teb->Fill();  cnt->treeWrites++;}
+                }
             }
 
             timer.Stop();
+            loopTimer.SetBytes(cnt->bytes_read);
+            loopTimer.Stop();
 
             std::cout << PrintOutput("\t\tCPU time: ", "yellow") << timer.CpuTime() << PrintOutput("; Real time: ", "yellow") << timer.RealTime() << std::endl;
             std::cout << PrintOutput("\t\tAverage processing speed: ", "yellow") << (cnt->bytes_read/(1024*1024))/timer.RealTime() << PrintOutput("MB/s -- File size was ", "yellow") << cnt->bytes_read/(1024*1024) << PrintOutput("MB\n", "yellow");
@@ -427,6 +410,8 @@ int main(int argc, char *argv[]) {
             // std::cout << " Average processing speed: " << (cnt->bytes_read/(1024*1024))/timer.RealTime()
             //        << "MB/s -- File size was " << cnt->bytes_read/(1024*1024) << " MB \n" << std::endl;
 
+            if(!ctrl->noEB) { builder->PrintStatistics(); }
+
             cnt->PrintRunStatistics(ctrl->pgh, ctrl->withWAVE, ctrl->superPulse, ctrl->analyze2AND3);
 
             // Write stats to unpack log file
@@ -434,11 +419,12 @@ int main(int argc, char *argv[]) {
             logFile << "Mode2 Headers 1:" << '\t' << mode2Count << std::endl;
             logFile << "Mode2 Headers 2:" << '\t' << cnt->headerType[DECOMP] << std::endl;
             logFile << "Tree Writes:" << '\t' << cnt->treeWrites << std::endl;
-            logFile << "Built Events:" << '\t' << builtEvents << std::endl;
+            logFile << "Built Events:" << '\t' << builder->BuiltEvents() << std::endl;
             logFile.close();
 
             cnt->ResetRunCounters();
 
+            StageTimer writeTimer(writeId);
             if(ctrl->withTREE) {
                 std::cout << PrintOutput("\t\tWriting ROOT tree...\n", "blue");
                 teb->Write();
@@ -471,6 +457,10 @@ int main(int argc, char *argv[]) {
         gret->sp.WriteSuperPulses();
     }
 
+    if(ctrl->doTRACK) {
+        gret->track.stat.PrintPermutations(gret->track.perm.nPerm);
+    }
+
     if(ctrl->outputON) {
         std::cout << std::endl;
         std::cout << "Closing output file...";
@@ -482,55 +472,70 @@ int main(int argc, char *argv[]) {
     std::cout << std::endl;
     timer.Delete();
 
+    memReport.Snapshot("end");
+    memReport.Print();
+    memReport.WriteJSON();
+
+    if(gMetrics) { delete gMetrics;  gMetrics = NULL; }
+    if(gTrace) { delete gTrace;  gTrace = NULL; }
+
     return 1;
 }
 
 /****************************************************/
 
+/* Metrics stage names for the GEB types */
+static const char* GEBTypeName(Int_t type) {
+    switch(type) {
+        case DECOMP:      return "GetData.mode2";
+        case RAW:         return "GetData.mode3";
+        case TRACK:       return "GetData.mode1";
+        case BGS:         return "GetData.BGS";
+        case S800:        return "GetData.S800";
+        case S800AUX:     return "GetData.S800AUX";
+        case GRETSCALER:  return "GetData.scaler";
+        case BANK88:      return "GetData.bank88";
+        case S800PHYSICS: return "GetData.S800physics";
+        case S800AUX_TS:  return "GetData.S800AUX_TS";
+        case G4SIM:       return "GetData.G4SIM";
+        case RAWHISTORY:  return "GetData.mode3history";
+        default:          return "GetData.other";
+    }
+}
+
 void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
          INLCorrection *inlCor, UShort_t junk[]) {
 
+    static Int_t typeId[64];
+    static Int_t otherId = -1;
+    if(otherId < 0) {
+        otherId = StageMetrics::Id(GEBTypeName(-1));
+        for(Int_t t = 0; t < 64; t++) { typeId[t] = StageMetrics::Id(GEBTypeName(t)); }
+    }
+    StageTimer getDataTimer((gHeader.type >= 0 && gHeader.type < 64) ? typeId[gHeader.type] : otherId,
+                            sizeof(struct globalHeader) + gHeader.length);
+
     cnt->Increment(sizeof(struct globalHeader));
 
     switch(gHeader.type) {
 
         case DECOMP:
-            if(cnt->headerType[DECOMP] == 0 && ctrl->withTREE) {
-                InitializeTreeMode2();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("g2")->Fill();
-                }
-            }
+            if(cnt->headerType[DECOMP] == 0 && ctrl->withTREE) { AddTypeBranch(DECOMP, cnt); }
             gret->getMode2(inf, gHeader.length, cnt);
             break;
 
         case TRACK:
-            if(cnt->headerType[TRACK] == 0 && ctrl->withTREE) {
-                InitializeTreeMode1();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("g1")->Fill();
-                }
-            }
+            if(cnt->headerType[TRACK] == 0 && ctrl->withTREE) { AddTypeBranch(TRACK, cnt); }
             gret->getMode1(inf, cnt);
             break;
 
         case RAW:
-            if(cnt->headerType[RAW] == 0 && ctrl->withTREE) {
-                InitializeTreeMode3();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("g3")->Fill();
-                }
-            }
+            if(cnt->headerType[RAW] == 0 && ctrl->withTREE) { AddTypeBranch(RAW, cnt); }
             gret->getMode3(inf, gHeader.length, cnt, ctrl);
             break;
 
         case RAWHISTORY:
-            if(cnt->headerType[RAWHISTORY] == 0 && ctrl->withTREE) {
-                InitializeTreeHistory();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("g3H")->Fill();
-                }
-            }
+            if(cnt->headerType[RAWHISTORY] == 0 && ctrl->withTREE) { AddTypeBranch(RAWHISTORY, cnt); }
             gret->getMode3History(inf, gHeader.length, gHeader.timestamp, cnt);
             break;
 
@@ -577,12 +582,7 @@ void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
 
 
         case BANK88:
-            if(cnt->headerType[BANK88] == 0 && ctrl->withTREE) {
-                InitializeTreeBank88();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("b88")->Fill();
-                }
-            }
+            if(cnt->headerType[BANK88] == 0 && ctrl->withTREE) { AddTypeBranch(BANK88, cnt); }
             gret->getBank88(inf, gHeader.length, cnt);  cnt->Increment(gHeader.length);
             break;
 
@@ -591,12 +591,7 @@ void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
             break;
 
         case G4SIM:
-            if(cnt->headerType[G4SIM] == 0 && ctrl->withTREE) {
-                InitializeTreeSimulation();
-                for(Int_t i = 0; i < cnt->treeWrites; i++) {
-                    teb->FindBranch("gSim")->Fill();
-                }
-            }
+            if(cnt->headerType[G4SIM] == 0 && ctrl->withTREE) { AddTypeBranch(G4SIM, cnt); }
             SkipData(inf, junk);  cnt->Increment(gHeader.length);
             break;
 
@@ -654,6 +649,28 @@ void GetData(FILE* inf, controlVariables* ctrl, counterVariables* cnt,
 
 /****************************************************/
 
+/* Tree branch of a GEB type (see TypeBranchName), made on the first header
+   of that type, or up front for -sliceTypes; the entries already written
+   are back-filled */
+void AddTypeBranch(Int_t type, counterVariables* cnt) {
+    const char* name = TypeBranchName(type);
+    if(!name || teb->GetBranch(name)) { return; }
+
+    switch(type) {
+        case DECOMP:      InitializeTreeMode2();       break;
+        case TRACK:       InitializeTreeMode1();       break;
+        case RAW:         InitializeTreeMode3();       break;
+        case RAWHISTORY:  InitializeTreeHistory();     break;
+        case BANK88:      InitializeTreeBank88();      break;
+        case G4SIM:       InitializeTreeSimulation();  break;
+    }
+    for(Int_t i = 0; i < cnt->treeWrites; i++) {
+        teb->GetBranch(name)->Fill();
+    }
+}
+
+/****************************************************/
+
 void ReadMario(FILE* inf) {
     out4Mario mario;
     int _rd = fread(&mario, 1, sizeof(struct out4Mario), inf);
@@ -691,17 +708,34 @@ void PrintHelpInformation() {
     printf("                       -calibrationRun (DISABLE event building, and fill calibration histograms)\n");
     printf("                       -superPulse <lowE> <highE> <detMapFile directory> <XtalkFile>\n");
     printf("                               (turns off tree and histograms, builds superpulse .spn files)\n");
+    printf("                       -screen (flag truncated, saturated and piled-up Mode3 traces as they are\n                                unpacked, and keep them out of the CFD and the superpulses)\n");
+    printf("                       -screenRail <ADC> (digitizer rail for -screen, default 8191)\n");
+    printf("                       -screenEdge <ADC> (second-edge threshold for -screen, default 50;\n                                     0 uses only the FPGA pile-up flag)\n");
+    printf("                       -packTraces (write Mode3 traces to the tree packed, about 2x smaller;\n                                    wf.raw then only reads back through libGRETINA)\n");
     printf("                       -noSeg (DISABLE segment analysis, i.e. segment summing; default is ON \n");
     printf("                       -s800File (define the s800 control file; without default is s800.set\n                                  for S800 parameters, and NO s800 included in ROOT tree)\n");
 
     printf("                       -track (do tracking, such as it is -- options specified in track.chat)\n");
+    printf("                       -trackThreads <n> (threads for tracking the clusters of an event, default\n                                      all cores; 1 tracks serially, same results either way)\n");
     printf("                       -outputON (write output file, with S800Physics, gated on PID)\n");
 
-    printf("                       -zip (compressed data file, will append .gz to filename)\n");
+    printf("                       -zip (compressed data file, will append .gz to filename unless .gz or .gebz;\n                             .gebz archives from GEB_repack are decoded chunk-parallel)\n");
     printf("                       -bzip (compressed data file, will append .bz2 to filename)\n");
     printf("                       -withHistos (turn ON histograms, as defined in Histos.h, default is OFF)\n");
     printf("                       -noTree (turn OFF root tree, default is ON)\n");
-    printf("                       -noHFC (turn OFF HFC presort piping; default is ON)\n");
+    printf("                       -noHFC (turn OFF in-process HFC time ordering; default is ON)\n");
+    printf("                       -hfcMem <MB> (memory cap for the adaptive HFC depth, default 1024;\n                                     0 uses the old fixed depth)\n");
+    printf("                       -index (read through the sidecar GEB index <file>.idx, built if missing,\n                               and skip the payloads of the GEB types that are not unpacked;\n                               their headers still take part in the event building)\n");
+    printf("                       -tsStart <TS> -tsEnd <TS> (only read GEB data inside this timestamp window)\n");
+    printf("                       -ebWindow <TS> (event building window in TS units, default %d)\n", EB_DIFF_TIME);
+    printf("                       -ebLookBack <TS> (hold fragments only this many TS units for time ordering,\n                                   also with -noHFC, and print per-type lateness)\n");
+    printf("                       -metrics <file> (write per-stage counts, time and bytes periodically;\n                                  JSON lines, or Prometheus text if the name ends in .prom)\n");
+    printf("                       -metricsPeriod <s> (seconds between metrics records, default 10)\n");
+    printf("                       -trace <file> (write a Chrome/Perfetto trace JSON of the timed stages,\n                                open in ui.perfetto.dev)\n");
+    printf("                       -memReport <file> (also write the end-of-sort memory report as JSON;\n                                    per-stage allocations need -metrics)\n");
+    printf("                       -slices <N> (with -f: sort N time slices in parallel and merge them with hadd;\n");
+    printf("                                    cuts at header-TS gaps > -ebWindow, same tree as a serial sort when HFC drops nothing)\n");
+    printf("                       -sliceTypes <t1,t2,...> (set by -slices: GEB types whose branches a slice makes up front)\n");
     printf("                       -dopplerSimple (use simple GRETINA decomp position for Doppler correction)\n");
     printf("                       -suppressTS (suppress TS error warnings in analysis)\n");
     /* 2015-04-21 CMC added command-line flag descriptions, as I understand them, feel free to correct or update */
@@ -0,0 +1,64 @@
+#include "Unpack.h"
+
+// Loop through ORRUBA events and for each event, match to the corresponding GRETINA event based on the timestamp
+// The difference of timestamps is to be < timeThreshold which is a lot considering the timestamps between two ORRUBA events
+// are generally on the order of 100,000.
+// Both lists are sorted by timestamp; the GRETINA search starts at the last match.
+// Kept out of Unpack.cpp (which has main) so that goddessBench can time it.
+std::vector<matchedEvents> Unpack::MatchTimeStamps(const std::vector<std::pair<Int_t, Long64_t> >& orrubaTimeStamps_,
+                                                   const std::vector<std::pair<Int_t, Long64_t> >& gretinaTimeStamps_,
+                                                   Long64_t timeThreshold, Long64_t timeNotFoundBreak,
+                                                   Long64_t& nentriesMatched, bool showProgress) {
+    std::vector<matchedEvents> matchedEvents_;
+    nentriesMatched = 0;
+
+    size_t newstart = 0;
+    for(size_t i = 0; i < orrubaTimeStamps_.size(); i++) { // SC: Loop through ORRUBA timestamps
+        size_t found_j = 0;
+        int found_index = 0;
+        Long64_t orrubaTime = orrubaTimeStamps_[i].second;
+        Bool_t found = false;
+
+        size_t best_j;
+        Long64_t closestTime = 100000;
+        Long64_t gretinaTime;
+        for(size_t j = newstart; j < gretinaTimeStamps_.size(); j++) { // SC: Loop through GRETINA timestamps
+            size_t timeDiff = fabs(orrubaTime - gretinaTimeStamps_[j].second); // SC: Find timing difference
+
+            if((timeDiff < timeThreshold) && (timeDiff < closestTime)) { // If this is closest time difference, take it
+                closestTime = fabs(orrubaTime - gretinaTimeStamps_[j].second);
+                gretinaTime = gretinaTimeStamps_[j].second;
+                best_j = gretinaTimeStamps_[j].first;
+                found_index = j;
+                found = true;
+                newstart = found_index;
+            }
+            else if(timeDiff > closestTime && found){
+                break;
+            }
+            if(timeDiff > timeNotFoundBreak && (gretinaTimeStamps_[j].second > orrubaTime)){
+                break; // SC: Looks like this breaks the statement if it seems a match isn't found
+            }
+        }
+
+        // Record ORRUBA + GRETINA timestamps
+        if(found) {
+            matchedEvents hit = {i, best_j, orrubaTime, gretinaTime};
+            matchedEvents_.push_back(hit);
+            nentriesMatched++;
+        }
+        // Record ORRUBA hits that do not have a GRETINA timestamp
+        else {
+            matchedEvents hit = {i, 0, orrubaTime, 0};
+            matchedEvents_.push_back(hit);
+        }
+
+        // Remove the first found_index elements and shift everything else down by found_index indices
+        // This is so that we don't have to loop through GRETINA events that have already been matched
+        // Don't do it for every event as it will slow it down too much. Every 500 seems to work well
+        //if((i % 500 == 0) && found) gretinaTimeStamps_.erase(gretinaTimeStamps_.begin(), gretinaTimeStamps_.begin() + found_index);
+        if(showProgress && i % 10000==0) std::cout << "Progress :" << static_cast<int>(i*100./orrubaTimeStamps_.size()) << " %\r";
+    }
+
+    return matchedEvents_;
+}
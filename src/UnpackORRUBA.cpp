@@ -7,6 +7,8 @@
  */
 
 #include "UnpackORRUBA.h"
+#include "StageMetrics.h"
+#include "MemoryReport.h"
 
 #define BUFFER_LENGTH 8194
 #define BUFFER_LENGTHB 32776
@@ -207,8 +209,24 @@ UnpackORRUBA::UnpackORRUBA(fileListStruct run) {
 
     // Sectors were reversed for dSX3 5,6,11, so use this to correct
 	Int_t sectorSwap[4] = {3,2,1,0};
+
+    static const int bufferId = StageMetrics::Id("ORRUBA.buffer");
+    static const int eventId = StageMetrics::Id("ORRUBA.event");
+    static const int fillId = StageMetrics::Id("ORRUBA.Fill");
+    static const int writeId = StageMetrics::Id("ORRUBA.write");
+    static const int unpackId = StageMetrics::Id("ORRUBA.unpack");
+    StageTimer unpackTimer(unpackId);
+
+    // The event arrays and the read buffer, sampled every 1000 buffers
+    if(gMemReport) {
+        gMemReport->Component("UnpackORRUBA", this, sizeof(UnpackORRUBA));
+        gMemReport->Component("UnpackORRUBA.buffer", buffer, sizeof(buffer));
+    }
+
     //This is the main loop over the ldf file
     while(!file.eof() and !received_sigint){
+        StageTimer bufferTimer(bufferId, BUFFER_LENGTHB);
+        if(gMetrics) gMetrics->Poll();
 
         //Get Buffer
         file.read((char*)buffer, BUFFER_LENGTHB);
@@ -605,18 +623,32 @@ UnpackORRUBA::UnpackORRUBA(fileListStruct run) {
                     fTDCSiliconUpstream = tdcSiliconUpstream;
                     fTimeStamp = timeStamp;
                     fRunNumber = std::stoi(run.runNumber);
-                    treeRaw->Fill();
+                    {
+                        StageTimer fillTimer(fillId);
+                        treeRaw->Fill();
+                    }
+                    if(gMetrics) gMetrics->Count(eventId, 1);
 
                 }
             }
         }
         NumberBuffer++;
-        if(NumberBuffer % 1000 == 0) std::cout << PrintOutput("\r Read through ","red") << (NumberBuffer*BUFFER_LENGTHB)/1.e6 << PrintOutput(" MB ","red") << std::flush;
+        if(NumberBuffer % 1000 == 0) {
+            std::cout << PrintOutput("\r Read through ","red") << (NumberBuffer*BUFFER_LENGTHB)/1.e6 << PrintOutput(" MB ","red") << std::flush;
+            if(gMemReport) gMemReport->Sample();
+        }
     } //End of main loop over file
+    if(gMemReport) {
+        gMemReport->Sample();
+        gMemReport->Component("UnpackORRUBA.buffer", NULL, 0); // on the stack, gone after this
+    }
 
 
-    treeRaw->Write();
-    outputFileRaw->Close();
+    {
+        StageTimer writeTimer(writeId);
+        treeRaw->Write();
+        outputFileRaw->Close();
+    }
 
     file.close();
     int runClock = clock();
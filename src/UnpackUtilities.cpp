@@ -1,5 +1,245 @@
 #include "UnpackUtilities.h"
 
+#include "HFCStream.h"
+#include "GEBZip.h"
+#include "GEBIndex.h"
+#include "StageMetrics.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <map>
+
+FILE* OpenGEBInput(TString fileName, Bool_t compressed, controlVariables* ctrl) {
+    Bool_t selecting = (ctrl->useIndex || ctrl->tsStart >= 0 || ctrl->tsEnd >= 0);
+
+    GEBSelect sel;
+    GEBSelect_init(&sel);
+    if (ctrl->tsStart >= 0) { sel.tsLow = ctrl->tsStart; }
+    if (ctrl->tsEnd >= 0) { sel.tsHigh = ctrl->tsEnd; }
+    if (ctrl->useIndex) {
+        /* Types GetData() only skips anyway: their payload is not read, but
+           the header still comes through (length 0), so they close events
+           in the event building just as without -index */
+        Int_t skipped[] = {BGS, S800AUX, S800PHYSICS, S800AUX_TS, CHICO,
+                           DFMA, PWALL, PWALLAUX, GODDESS, LENDA};
+        for (UInt_t i = 0; i < sizeof(skipped)/sizeof(Int_t); i++) {
+            sel.drop[skipped[i]] = true;
+        }
+        sel.headerOnly = true;
+    }
+
+    if (compressed) {
+        /* .gebz archives only decode the chunks inside the time window */
+        FILE *raw = GEBZip_openRange(fileName.Data(), 0, sel.tsLow, sel.tsHigh);
+        if (raw && selecting) { raw = GEBSelect_filter(raw, &sel); }
+        return raw;
+    }
+
+    if (!selecting) { return fopen(fileName.Data(), "r"); }
+
+    TString idxName = fileName + ".idx";
+    if (!GEBIndex_valid(fileName.Data(), idxName.Data())) {
+        std::cout << PrintOutput("\t\tBuilding GEB index: ", "blue") << idxName.Data() << std::endl;
+        if (GEBIndex_build(fileName.Data(), idxName.Data()) < 0) {
+            std::cout << PrintOutput("\t\tCannot write GEB index, selecting while reading the whole file.\n", "red");
+            FILE *raw = fopen(fileName.Data(), "r");
+            return (raw ? GEBSelect_filter(raw, &sel) : NULL);
+        }
+    }
+
+    std::cout << PrintOutput("\t\tReading selected GEB data through index: ", "blue") << idxName.Data() << std::endl;
+    return GEBIndex_open(fileName.Data(), idxName.Data(), &sel);
+}
+
+const char* TypeBranchName(Int_t type) {
+    switch (type) {
+        case DECOMP:      return "g2";
+        case TRACK:       return "g1";
+        case RAW:         return "g3";
+        case RAWHISTORY:  return "g3H";
+        case BANK88:      return "b88";
+        case G4SIM:       return "gSim";
+    }
+    return NULL;
+}
+
+Int_t RunTimeSlices(int argc, char** argv, controlVariables* ctrl) {
+    if (ctrl->fileType != "f" || ctrl->compressedFile || ctrl->compressedFileB ||
+        ctrl->analyze2AND3 || ctrl->superPulse || ctrl->outputON || ctrl->pgh) {
+        std::cout << PrintOutput("\t\t-slices needs a single plain GEB file (-f), without -zip/-bzip,\n\t\t-analyze2and3, -superPulse, -outputON or pre-GH data.\n", "red");
+        return 2;
+    }
+
+    TString idxName = ctrl->fileName + ".idx";
+    if (!GEBIndex_valid(ctrl->fileName.Data(), idxName.Data())) {
+        std::cout << PrintOutput("\t\tBuilding GEB index: ", "blue") << idxName.Data() << std::endl;
+        if (GEBIndex_build(ctrl->fileName.Data(), idxName.Data()) < 0) {
+            std::cout << PrintOutput("\t\tCannot index: ", "red") << ctrl->fileName.Data() << std::endl;
+            return 2;
+        }
+    }
+
+    /* All timestamps inside the requested window with their place in the
+       file, in time order, and the first (timestamp, index entry) of every
+       type with a tree branch */
+    std::vector<std::pair<long long, size_t> > ts;
+    std::map<Int_t, std::pair<long long, size_t> > firstOfType;
+    GEBIndexReader idx;
+    if (!idx.open(ctrl->fileName.Data(), idxName.Data())) {
+        std::cout << PrintOutput("\t\tCannot read index: ", "red") << idxName.Data() << std::endl;
+        return 2;
+    }
+    ts.reserve(idx.entries());
+    const GEBIndex_entry *entry;
+    while ((entry = idx.next()) != NULL) {
+        if (ctrl->tsStart >= 0 && entry->timestamp < ctrl->tsStart) { continue; }
+        if (ctrl->tsEnd >= 0 && entry->timestamp > ctrl->tsEnd) { continue; }
+        ts.push_back(std::make_pair(entry->timestamp, ts.size()));
+        if (TypeBranchName(entry->type)) {
+            std::pair<long long, size_t> here(entry->timestamp, ts.size());
+            if (!firstOfType.count(entry->type) || here < firstOfType[entry->type]) {
+                firstOfType[entry->type] = here;
+            }
+        }
+    }
+    std::sort(ts.begin(), ts.end());
+
+    /* A serial sort makes these branches as the types turn up in the time
+       ordered data; every slice makes them all up front, in that order */
+    std::vector<std::pair<std::pair<long long, size_t>, Int_t> > typeOrder;
+    for (std::map<Int_t, std::pair<long long, size_t> >::iterator it = firstOfType.begin();
+         it != firstOfType.end(); ++it) {
+        typeOrder.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(typeOrder.begin(), typeOrder.end());
+    TString sliceTypes = "";
+    for (size_t t = 0; t < typeOrder.size(); t++) {
+        sliceTypes += Form("%s%d", (t ? "," : ""), typeOrder[t].second);
+    }
+
+    /* Every header before a cut must also come before every header after
+       it in the file: then a serial HFC has taken in all of the earlier
+       slice before the later one starts, like the slice's own HFC does */
+    std::vector<size_t> firstAfter(ts.size() + 1);
+    firstAfter[ts.size()] = ts.size();
+    for (size_t j = ts.size(); j > 0; j--) {
+        firstAfter[j-1] = std::min(firstAfter[j], ts[j-1].second);
+    }
+
+    /* Cut near equal shares of GEB headers, but only where the gap to the
+       next timestamp is larger than the build window -- no event can be built
+       across such a gap -- and the file is in time order across the cut.
+       The slices then build the events a single pass builds, as long as
+       HFC drops nothing and Mode 3 channels (which HFC stamps with their
+       own timestamps) stay within the build window of their GEB header. */
+    std::vector<Long64_t> lo, hi;
+    lo.push_back(ctrl->tsStart);
+    size_t i = 0, lastBefore = 0;
+    for (Int_t k = 1; k < ctrl->nSlices; k++) {
+        size_t target = ts.size() * k / ctrl->nSlices;
+        if (target < i) { target = i; }
+        for (; i < target; i++) { lastBefore = std::max(lastBefore, ts[i].second); }
+        for (i = target; i + 1 < ts.size(); i++) {
+            lastBefore = std::max(lastBefore, ts[i].second);
+            if (ts[i+1].first - ts[i].first > ctrl->ebWindow && lastBefore < firstAfter[i+1]) { break; }
+        }
+        if (i + 1 >= ts.size()) { break; }
+        hi.push_back(ts[i].first);
+        lo.push_back(ts[i+1].first);
+        i++;
+    }
+    hi.push_back(ctrl->tsEnd);
+
+    Int_t nSlices = lo.size();
+    TString outName = (ctrl->outfileName == "") ? TString("./ROOTFiles/test.root") : ctrl->outfileName;
+    std::cout << PrintOutput("\t\tSorting in ", "blue") << nSlices << PrintOutput(" time slices into ", "blue") << outName.Data() << std::endl;
+
+    /* One unpackGRETINA per slice, same flags, own time window and output */
+    std::vector<pid_t> pids;
+    std::vector<TString> sliceNames;
+    for (Int_t k = 0; k < nSlices; k++) {
+        TString sliceName = outName + Form(".slice%d", k);
+        sliceNames.push_back(sliceName);
+
+        std::vector<TString> args;
+        for (Int_t a = 0; a < argc; a++) {
+            TString arg = argv[a];
+            if (arg == "-slices" || arg == "-rootName" || arg == "-tsStart" || arg == "-tsEnd" || arg == "-trace" ||
+                arg == "-sliceTypes") { a++; continue; }
+            args.push_back(arg);
+        }
+        if (ctrl->traceFile != "") {
+            args.push_back("-trace");
+            args.push_back(SiblingFileName(ctrl->traceFile.Data(), Form("_slice%d", k)).c_str());
+        }
+        if (lo[k] >= 0) { args.push_back("-tsStart"); args.push_back(Form("%lld", lo[k])); }
+        if (hi[k] >= 0) { args.push_back("-tsEnd"); args.push_back(Form("%lld", hi[k])); }
+        if (sliceTypes != "") { args.push_back("-sliceTypes"); args.push_back(sliceTypes); }
+        args.push_back("-rootName");
+        args.push_back(sliceName);
+
+        std::cout << PrintOutput("\t\t  slice ", "blue") << k << ": TS " << lo[k] << " ... " << hi[k]
+                  << PrintOutput(", log in ", "blue") << sliceName.Data() << ".log" << std::endl;
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            FILE *log = freopen((sliceName + ".log").Data(), "w", stdout);
+            if (log) { dup2(fileno(stdout), fileno(stderr)); }
+            std::vector<char*> cargs;
+            for (size_t a = 0; a < args.size(); a++) { cargs.push_back((char*)args[a].Data()); }
+            cargs.push_back(NULL);
+            execv("/proc/self/exe", &cargs[0]);
+            _exit(127);
+        }
+        if (pid < 0) {
+            std::cout << PrintOutput("\t\tCannot start slice ", "red") << k << std::endl;
+            return 2;
+        }
+        pids.push_back(pid);
+    }
+
+    Int_t failed = 0;
+    for (Int_t k = 0; k < (Int_t)pids.size(); k++) {
+        int status = 0;
+        waitpid(pids[k], &status, 0);
+        /* unpackGRETINA ends with return 1 when all went well */
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0 && WEXITSTATUS(status) != 1)) {
+            std::cout << PrintOutput("\t\tSlice failed: ", "red") << k << PrintOutput(", see ", "red") << sliceNames[k].Data() << ".log" << std::endl;
+            failed++;
+        }
+    }
+    if (failed) { return 2; }
+
+    /* hadd appends the trees in the order given, so teb stays in time order */
+    TString command = "hadd -f " + outName;
+    for (Int_t k = 0; k < nSlices; k++) { command += " " + sliceNames[k]; }
+    std::cout << PrintOutput("\t\tMerging slices: ", "blue") << command.Data() << std::endl;
+    if (system(command.Data()) != 0) {
+        std::cout << PrintOutput("\t\tMerging failed, slice files are kept.\n", "red");
+        return 2;
+    }
+    for (Int_t k = 0; k < nSlices; k++) { unlink(sliceNames[k].Data()); }
+
+    return 0;
+}
+
+FILE* OpenHFCStream(TString fileName, Bool_t compressed, controlVariables* ctrl) {
+    FILE *raw = OpenGEBInput(fileName, compressed, ctrl);
+    if (!raw) { return NULL; }
+
+    /* HFC time ordering runs in this process -- ordered GEB items are
+       handed over through memory, not through a pipe from ./GEB_HFC.
+       With -ebLookBack it only holds items for the look-back. */
+    HFCStream *hfc = new HFCStream(raw, false, HFC_GEBDEPTH, ctrl->hfcMemMB, ctrl->ebLookBack);
+    FILE *ordered = hfc->open();
+    if (!ordered) { delete hfc; return NULL; }
+
+    std::cout << PrintOutput("\t\tTime ordering (HFC) in-process for: ", "blue") << fileName.Data() << std::endl;
+    return ordered;
+}
+
+
 Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
 
     if (ctrl->fileType != "f" && ctrl->fileType != "f1" && ctrl->fileType != "f2")  {
@@ -23,27 +263,17 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
             if (ctrl->compressedFile) {
 
                 if (ctrl->noHFC) {
-                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip")) {
+                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip") && !ctrl->fileName.EndsWith(".gebz")) {
                         ctrl->fileName = ctrl->fileName + ".gz";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        fclose(*inf);
-                        ctrl->fileName = "zcat " + ctrl->fileName;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenGEBInput(ctrl->fileName, kTRUE, ctrl);
 
                 } else if (!ctrl->noHFC) {
 
-                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip")) {
+                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip") && !ctrl->fileName.EndsWith(".gebz")) {
                         ctrl->fileName = ctrl->fileName + ".gz";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        fclose(*inf);
-                        ctrl->fileName = "./GEB_HFC -z -p " + ctrl->fileName;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenHFCStream(ctrl->fileName, kTRUE, ctrl);
                 }
 
             } else if (ctrl->compressedFileB) {
@@ -52,36 +282,23 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
                     if (!ctrl->fileName.EndsWith(".bz2")) {
                         ctrl->fileName = ctrl->fileName + ".bz2";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        fclose(*inf);
-                        ctrl->fileName = "bzcat " + ctrl->fileName;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenGEBInput(ctrl->fileName, kTRUE, ctrl);
 
                 } else if (!ctrl->noHFC) {
 
                     if (!ctrl->fileName.EndsWith(".bz2")) {
                         ctrl->fileName = ctrl->fileName + ".bz2";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        ctrl->fileName = "./GEB_HFC -bz -p " + ctrl->fileName;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenHFCStream(ctrl->fileName, kTRUE, ctrl);
                 }
 
             } else if (ctrl->noHFC) {
 
-                *inf = fopen(ctrl->fileName.Data(), "r");
+                *inf = OpenGEBInput(ctrl->fileName, kFALSE, ctrl);
 
             } else {
 
-                *inf = fopen(ctrl->fileName.Data(), "r");
-                if (*inf) {
-                    ctrl->fileName = "./GEB_HFC -p " + ctrl->fileName;
-                    *inf = popen(ctrl->fileName.Data(), "r");
-                }
+                *inf = OpenHFCStream(ctrl->fileName, kFALSE, ctrl);
             }
 
         } else if (ctrl->analyze2AND3) {
@@ -104,27 +321,16 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
 
             if (!ctrl->analyze2AND3) {
                 if (ctrl->noHFC) {
-                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip")) {
+                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip") && !ctrl->fileName.EndsWith(".gebz")) {
                         ctrl->fileName = ctrl->fileName + ".gz";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        fclose(*inf);
-                        ctrl->fileName = "zcat " + ctrl->fileName;
-                        *inf = NULL;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenGEBInput(ctrl->fileName, kTRUE, ctrl);
 
                 } else if (!ctrl->noHFC) {
-                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip")) {
+                    if (!ctrl->fileName.EndsWith(".gz") && !ctrl->fileName.EndsWith(".gzip") && !ctrl->fileName.EndsWith(".gebz")) {
                         ctrl->fileName = ctrl->fileName + ".gz";
                     }
-                    *inf = fopen(ctrl->fileName.Data(), "r");
-                    if (*inf) {
-                        fclose(*inf);
-                        ctrl->fileName = "./GEB_HFC -z -p " + ctrl->fileName;
-                        *inf = popen(ctrl->fileName.Data(), "r");
-                    }
+                    *inf = OpenHFCStream(ctrl->fileName, kTRUE, ctrl);
                 }
             } else {
                 std::cout << "Apologies -- multiple file analysis at present is not possible with compressed files. " << std::endl;
@@ -138,23 +344,14 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
                   if (!ctrl->fileName.EndsWith(".bz2")) {
                     ctrl->fileName = ctrl->fileName + ".bz2";
                   }
-                  *inf = fopen(ctrl->fileName.Data(), "r");
-                  if (*inf) {
-                    fclose(*inf);
-                    ctrl->fileName = "bzcat " + ctrl->fileName;
-                    *inf = popen(ctrl->fileName.Data(), "r");
-                  }
+                  *inf = OpenGEBInput(ctrl->fileName, kTRUE, ctrl);
 
                 } else if (!ctrl->noHFC) {
 
                   if (!ctrl->fileName.EndsWith(".bz2")) {
                     ctrl->fileName = ctrl->fileName + ".bz2";
                   }
-                  *inf = fopen(ctrl->fileName.Data(), "r");
-                  if (*inf) {
-                    ctrl->fileName = "./GEB_HFC -bz -p " + ctrl->fileName;
-                    *inf = popen(ctrl->fileName.Data(), "r");
-                  }
+                  *inf = OpenHFCStream(ctrl->fileName, kTRUE, ctrl);
                 }
             } else {
                 
@@ -165,17 +362,13 @@ Int_t OpenInputFile(FILE** inf, controlVariables* ctrl, TString runNumber) {
         } else if (ctrl->noHFC) {
 
             if (!ctrl->analyze2AND3) {
-                *inf = fopen(ctrl->fileName.Data(), "r");
+                *inf = OpenGEBInput(ctrl->fileName, kFALSE, ctrl);
             }
 
         } else {
 
             if (!ctrl->analyze2AND3) {
-                *inf = fopen(ctrl->fileName.Data(), "r");
-                if (*inf) {
-                    ctrl->fileName = "./GEB_HFC -p " + ctrl->fileName;
-                    *inf = popen(ctrl->fileName.Data(), "r");
-                }
+                *inf = OpenHFCStream(ctrl->fileName, kFALSE, ctrl);
             }
 
         }
@@ -225,6 +418,12 @@ int ProcessEvent(Float_t currTS, controlVariables* ctrl, counterVariables* cnt)
 
   int badCrystal = 0;
 
+  static const Int_t processId = StageMetrics::Id("ProcessEvent");
+  static const Int_t mode3Id = StageMetrics::Id("analyzeMode3");
+  static const Int_t trackId = StageMetrics::Id("tracking");
+  static const Int_t fillId = StageMetrics::Id("Fill");
+  StageTimer processTimer(processId);
+
   /* Go ahead and write out the event, reset for the next one... */
   if (ctrl->superPulse) { /* This is a superpulse analysis -- quite different. */
     gret->checkSPIntegrity();
@@ -234,12 +433,16 @@ int ProcessEvent(Float_t currTS, controlVariables* ctrl, counterVariables* cnt)
     //FillFoldHist(histos, gVar, multTemp, ctrl->xtLowE, ctrl->xtHighE);
   }
 
-  if (gret->g3Temp.size() > 0) { gret->analyzeMode3(ctrl); }
+  if (gret->g3Temp.size() > 0) {
+    StageTimer mode3Timer(mode3Id);
+    gret->analyzeMode3(ctrl);
+  }
 
   if (gret->g2out.crystalMult() > 0) {
     if (ctrl->doTRACK) {
       Int_t error = gret->fillShell2Track();
       if (error != 8) {
+        StageTimer trackTimer(trackId);
         gret->track.findTargetPos();
         Int_t trackStatus;
         trackStatus = gret->track.trackEvent();
@@ -406,7 +609,8 @@ int ProcessEvent(Float_t currTS, controlVariables* ctrl, counterVariables* cnt)
       gret->fillHistos(2);
     }
     if (ctrl->withTREE) {
-      teb->Fill(); cnt->treeWrites++;
+      { StageTimer fillTimer(fillId);  if (ctrl->packTraces) { gret->g3out.PackTraces(); }  teb->Fill(); }
+      cnt->treeWrites++;
 #ifdef WITH_PWALL
       /* Reset Phoswall */
       phosWall->Reset();
@@ -0,0 +1,239 @@
+#include "GEBArchive.h"
+#include <iostream>
+#include <thread>
+#include <limits.h>
+#include <string.h>
+#include <zlib.h>
+
+using namespace std;
+
+// index entries per 'G','I' member, fits the 64 kB extra field
+#define GEBARCH_PERMEMBER 2000
+#define GEBARCH_ENTRYSIZE 32
+
+static void GEBArch_put(BYTE* p, unsigned long long v, int n) {
+  for(int i=0; i<n; i++)
+    p[i] = (BYTE) (v >> (8*i));
+}
+
+static unsigned long long GEBArch_get(const BYTE* p, int n) {
+  unsigned long long v = 0;
+  for(int i=n-1; i>=0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+/****************************************************/
+
+GEBArchWriter::GEBArchWriter(FILE* out, int chunkSize, int level,
+			     int nThreads) {
+  m_out = out;
+  m_chunkSize = (chunkSize > 0) ? chunkSize : GEBARCH_CHUNKSIZE;
+  m_level = level;
+
+  if(nThreads <= 0)
+    nThreads = thread::hardware_concurrency();
+  m_nThreads = (nThreads > 0) ? nThreads : 1;
+
+  m_ok = true;
+  m_offset = 0;
+  m_minTS = LLONG_MAX;
+  m_maxTS = LLONG_MIN;
+  m_buf.reserve(m_chunkSize + 8*16382);
+}
+
+void GEBArchWriter::add(const gebData* geb, const BYTE* data) {
+  const BYTE* h = (const BYTE*) geb;
+  m_buf.insert(m_buf.end(), h, h + sizeof(gebData));
+  m_buf.insert(m_buf.end(), data, data + geb->length);
+
+  if(geb->timestamp < m_minTS)
+    m_minTS = geb->timestamp;
+  if(geb->timestamp > m_maxTS)
+    m_maxTS = geb->timestamp;
+
+  if((int) m_buf.size() >= m_chunkSize)
+    endChunk();
+}
+
+void GEBArchWriter::addRaw(const BYTE* data, int length) {
+  m_buf.insert(m_buf.end(), data, data + length);
+
+  // no timestamps known for these bytes, never skip the chunk
+  m_minTS = LLONG_MIN;
+  m_maxTS = LLONG_MAX;
+}
+
+vector<BYTE> GEBArchWriter::compress(vector<BYTE> data, int level) {
+  vector<BYTE> out;
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if(deflateInit2(&z, level, Z_DEFLATED, 15+16, 8,
+		  Z_DEFAULT_STRATEGY) != Z_OK)
+    return out;
+
+  out.resize(deflateBound(&z, data.size()) + 64);
+  z.next_in = data.empty() ? NULL : &data[0];
+  z.avail_in = data.size();
+  z.next_out = &out[0];
+  z.avail_out = out.size();
+
+  int ret = deflate(&z, Z_FINISH);
+  out.resize((ret == Z_STREAM_END) ? out.size() - z.avail_out : 0);
+  deflateEnd(&z);
+
+  return out;
+}
+
+void GEBArchWriter::endChunk() {
+  if(m_buf.empty())
+    return;
+
+  GEBArch_chunk c;
+  c.offset = 0;
+  c.csize = 0;
+  c.usize = m_buf.size();
+  c.minTS = m_minTS;
+  c.maxTS = m_maxTS;
+
+  if(c.minTS > c.maxTS) {
+    c.minTS = LLONG_MIN;
+    c.maxTS = LLONG_MAX;
+  }
+
+  // compress on a worker, the buffer moves along
+  m_jobs.push_back(async(launch::async, &GEBArchWriter::compress,
+			 std::move(m_buf), m_level));
+  m_pending.push_back(c);
+
+  m_buf.clear();
+  m_buf.reserve(m_chunkSize + 8*16382);
+  m_minTS = LLONG_MAX;
+  m_maxTS = LLONG_MIN;
+
+  while((int) m_jobs.size() > m_nThreads)
+    writeOldest();
+}
+
+void GEBArchWriter::writeOldest() {
+  vector<BYTE> z = m_jobs.front().get();
+  m_jobs.pop_front();
+  GEBArch_chunk c = m_pending.front();
+  m_pending.pop_front();
+
+  if(z.empty()) {
+    cerr << "GEBArchWriter: compression failed" << endl;
+    m_ok = false;
+    return;
+  }
+
+  c.offset = m_offset;
+  c.csize = z.size();
+  if(fwrite(&z[0], 1, z.size(), m_out) != z.size())
+    m_ok = false;
+  m_offset += z.size();
+
+  m_chunks.push_back(c);
+}
+
+void GEBArchWriter::writeMember(const BYTE* extra, int extraLength) {
+  // empty gzip member, the payload is in the extra field:
+  // header with FEXTRA, XLEN, extra, empty final static
+  // deflate block, CRC32 and ISIZE of nothing
+  BYTE hdr[12] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255, 0, 0};
+  GEBArch_put(hdr + 10, extraLength, 2);
+  BYTE tail[10] = {3, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+  if(fwrite(hdr, 1, 12, m_out) != 12 ||
+     fwrite(extra, 1, extraLength, m_out) != (size_t) extraLength ||
+     fwrite(tail, 1, 10, m_out) != 10)
+    m_ok = false;
+  m_offset += 12 + extraLength + 10;
+}
+
+bool GEBArchWriter::close() {
+  endChunk();
+  while(!m_jobs.empty())
+    writeOldest();
+
+  unsigned long long indexOffset = m_offset;
+
+  for(size_t first=0; first<m_chunks.size(); first+=GEBARCH_PERMEMBER) {
+    size_t n = m_chunks.size() - first;
+    if(n > GEBARCH_PERMEMBER)
+      n = GEBARCH_PERMEMBER;
+
+    vector<BYTE> extra(4 + n*GEBARCH_ENTRYSIZE);
+    extra[0] = 'G';
+    extra[1] = 'I';
+    GEBArch_put(&extra[2], n*GEBARCH_ENTRYSIZE, 2);
+    for(size_t i=0; i<n; i++) {
+      const GEBArch_chunk& c = m_chunks[first+i];
+      BYTE* e = &extra[4 + i*GEBARCH_ENTRYSIZE];
+      GEBArch_put(e, c.offset, 8);
+      GEBArch_put(e+8, c.csize, 4);
+      GEBArch_put(e+12, c.usize, 4);
+      GEBArch_put(e+16, c.minTS, 8);
+      GEBArch_put(e+24, c.maxTS, 8);
+    }
+    writeMember(&extra[0], extra.size());
+  }
+
+  BYTE footer[28];
+  footer[0] = 'G';
+  footer[1] = 'F';
+  GEBArch_put(footer+2, 24, 2);
+  GEBArch_put(footer+4, indexOffset, 8);
+  GEBArch_put(footer+12, m_chunks.size(), 8);
+  memcpy(footer+20, GEBARCH_MAGIC, 8);
+  writeMember(footer, sizeof(footer));
+
+  return m_ok;
+}
+
+/****************************************************/
+
+bool GEBArch_readIndex(const BYTE* map, size_t size,
+		       vector<GEBArch_chunk>& chunks) {
+  chunks.clear();
+  if(size < GEBARCH_FOOTERSIZE)
+    return false;
+
+  const BYTE* f = map + size - GEBARCH_FOOTERSIZE;
+  if(f[0] != 0x1f || f[1] != 0x8b || GEBArch_get(f+10, 2) != 28 ||
+     f[12] != 'G' || f[13] != 'F' || memcmp(f+32, GEBARCH_MAGIC, 8))
+    return false;
+
+  unsigned long long pos = GEBArch_get(f+16, 8);
+  unsigned long long n = GEBArch_get(f+24, 8);
+
+  while(chunks.size() < n) {
+    if(pos + 16 > size - GEBARCH_FOOTERSIZE)
+      return false;
+    const BYTE* m = map + pos;
+    size_t xlen = GEBArch_get(m+10, 2);
+    if(m[0] != 0x1f || m[1] != 0x8b || m[12] != 'G' || m[13] != 'I' ||
+       pos + 22 + xlen > size)
+      return false;
+
+    size_t k = GEBArch_get(m+14, 2) / GEBARCH_ENTRYSIZE;
+    if(k == 0)
+      return false;
+    for(size_t i=0; i<k; i++) {
+      const BYTE* e = m + 16 + i*GEBARCH_ENTRYSIZE;
+      GEBArch_chunk c;
+      c.offset = GEBArch_get(e, 8);
+      c.csize = GEBArch_get(e+8, 4);
+      c.usize = GEBArch_get(e+12, 4);
+      c.minTS = (long long) GEBArch_get(e+16, 8);
+      c.maxTS = (long long) GEBArch_get(e+24, 8);
+      if(c.offset + c.csize > size)
+	return false;
+      chunks.push_back(c);
+    }
+    pos += 22 + xlen;
+  }
+
+  return true;
+}
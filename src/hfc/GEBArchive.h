@@ -0,0 +1,103 @@
+#ifndef __GEBARCHIVE_H
+#define __GEBARCHIVE_H
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <future>
+#include "global.h"
+#include "HFC.h"
+
+//
+// Seekable archive format for GEB data (.gebz)
+//
+// The file is a valid multi-member gzip file, so zcat still
+// gives back the original byte stream. Inside it is cut into
+// chunks (default 4 MB of GEB data), each compressed as a gzip
+// member of its own and always ending on a GEB event boundary.
+// After the data the chunk index follows, stored in the extra
+// field of empty gzip members ('G','I' subfields, zcat outputs
+// nothing for them), and a fixed size footer member ('G','F')
+// pointing at the index closes the file.
+//
+// Index entry per chunk: offset and size of the compressed
+// member, decoded size, and the smallest and largest GEB
+// timestamp in the chunk. GEBZip (GEBZip.h) reads the index,
+// decodes chunks in parallel and skips chunks outside a
+// requested time range.
+//
+// User methods:
+//
+// GEBArchWriter(FILE* out, int chunkSize, int level, int nThreads)
+// writes an archive to out; nThreads <= 0 uses all cores
+//
+// void add(const gebData* geb, const BYTE* data);
+// appends one GEB event
+//
+// void addRaw(const BYTE* data, int length);
+// appends bytes that are no GEB event (truncated or broken
+// input), so the round trip stays lossless
+//
+// bool close();
+// writes the last chunk, index and footer
+//
+// bool GEBArch_readIndex(const BYTE* map, size_t size,
+//                        std::vector<GEBArch_chunk>& chunks);
+// fills chunks from a mapped file, false if it is no archive
+//
+
+#define GEBARCH_MAGIC      "GEBARCH1"
+#define GEBARCH_CHUNKSIZE  (4 << 20)
+#define GEBARCH_FOOTERSIZE 50
+
+struct GEBArch_chunk
+{
+  unsigned long long offset; // of the gzip member in the file
+  unsigned int csize;        // compressed member size
+  unsigned int usize;        // decoded size
+  long long minTS;
+  long long maxTS;
+};
+
+class GEBArchWriter
+{
+ private:
+  FILE* m_out;
+  int m_chunkSize;
+  int m_level;
+  int m_nThreads;
+  bool m_ok;
+
+  unsigned long long m_offset;
+  std::vector<GEBArch_chunk> m_chunks;
+
+  // chunk being filled
+  std::vector<BYTE> m_buf;
+  long long m_minTS;
+  long long m_maxTS;
+
+  // chunks being compressed, in file order
+  std::deque<std::future<std::vector<BYTE> > > m_jobs;
+  std::deque<GEBArch_chunk> m_pending;
+
+  void endChunk();
+  void writeOldest();
+  void writeMember(const BYTE* extra, int extraLength);
+
+  static std::vector<BYTE> compress(std::vector<BYTE> data, int level);
+
+ public:
+  GEBArchWriter(FILE* out, int chunkSize, int level, int nThreads);
+
+  void add(const gebData* geb, const BYTE* data);
+  void addRaw(const BYTE* data, int length);
+  bool close();
+
+  int chunks() { return m_chunks.size(); }
+  unsigned long long bytesWritten() { return m_offset; }
+};
+
+bool GEBArch_readIndex(const BYTE* map, size_t size,
+		       std::vector<GEBArch_chunk>& chunks);
+
+#endif
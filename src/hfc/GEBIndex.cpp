@@ -0,0 +1,387 @@
+#include "GEBIndex.h"
+#include <iostream>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// index entries read at a time, and the largest single read
+// of neighbouring selected records
+#define GEBINDEX_BATCH   65536
+#define GEBINDEX_MAXREAD (4 << 20)
+
+// magic, data file size, data file mtime, number of entries
+struct GEBIndex_header
+{
+  char magic[8];
+  unsigned long long fileSize;
+  long long fileTime;
+  unsigned long long entries;
+};
+
+void GEBSelect_init(GEBSelect* sel) {
+  for(int i=0; i<GEBSELECT_NTYPES; i++)
+    sel->drop[i] = false;
+  sel->headerOnly = false;
+  sel->tsLow = LLONG_MIN;
+  sel->tsHigh = LLONG_MAX;
+}
+
+/****************************************************/
+
+long long GEBIndex_build(const char* fileName, const char* idxName) {
+  struct stat st;
+  if(stat(fileName, &st) != 0)
+    return -1;
+
+  FILE* in = fopen(fileName, "rb");
+  if(!in)
+    return -1;
+  FILE* out = fopen(idxName, "wb");
+  if(!out) {
+    fclose(in);
+    return -1;
+  }
+
+  GEBIndex_header h;
+  memcpy(h.magic, GEBINDEX_MAGIC, 8);
+  h.fileSize = st.st_size;
+  h.fileTime = st.st_mtime;
+  h.entries = 0;
+  // entry count is filled in at the end
+  fwrite(&h, sizeof(h), 1, out);
+
+  vector<GEBIndex_entry> batch;
+  batch.reserve(GEBINDEX_BATCH);
+
+  gebData aGeb;
+  unsigned long long pos = 0;
+  bool ok = true;
+
+  while(fread(&aGeb, sizeof(gebData), 1, in) == 1) {
+    if(aGeb.length < 0 ||
+       pos + sizeof(gebData) + aGeb.length > h.fileSize)
+      break; // broken or truncated last record, not indexed
+
+    GEBIndex_entry e;
+    e.offset = pos;
+    e.type = aGeb.type;
+    e.length = aGeb.length;
+    e.timestamp = aGeb.timestamp;
+    batch.push_back(e);
+
+    pos += sizeof(gebData) + aGeb.length;
+    if(fseeko(in, pos, SEEK_SET) != 0)
+      break;
+
+    if(batch.size() == GEBINDEX_BATCH) {
+      if(fwrite(&batch[0], sizeof(GEBIndex_entry), batch.size(), out)
+	 != batch.size())
+	ok = false;
+      h.entries += batch.size();
+      batch.clear();
+    }
+  }
+
+  if(!batch.empty()) {
+    if(fwrite(&batch[0], sizeof(GEBIndex_entry), batch.size(), out)
+       != batch.size())
+      ok = false;
+    h.entries += batch.size();
+  }
+
+  fclose(in);
+  if(fseeko(out, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, out) != 1)
+    ok = false;
+  if(fclose(out) != 0)
+    ok = false;
+
+  if(!ok) {
+    unlink(idxName);
+    return -1;
+  }
+  return h.entries;
+}
+
+GEBIndexReader::GEBIndexReader() {
+  m_idx = NULL;
+  m_entries = 0;
+  m_left = 0;
+  m_pos = 0;
+}
+
+GEBIndexReader::~GEBIndexReader() {
+  if(m_idx)
+    fclose(m_idx);
+}
+
+bool GEBIndexReader::open(const char* fileName, const char* idxName) {
+  struct stat st;
+  if(stat(fileName, &st) != 0)
+    return false;
+  m_idx = fopen(idxName, "rb");
+  if(!m_idx)
+    return false;
+
+  GEBIndex_header h;
+  if(fread(&h, sizeof(h), 1, m_idx) != 1 ||
+     memcmp(h.magic, GEBINDEX_MAGIC, 8) ||
+     h.fileSize != (unsigned long long) st.st_size ||
+     h.fileTime != (long long) st.st_mtime)
+    return false;
+
+  m_entries = h.entries;
+  m_left = h.entries;
+  return true;
+}
+
+const GEBIndex_entry* GEBIndexReader::peek() {
+  if(m_pos == m_batch.size()) {
+    if(m_left == 0)
+      return NULL;
+    size_t n = (m_left < GEBINDEX_BATCH) ? m_left : GEBINDEX_BATCH;
+    m_batch.resize(n);
+    n = fread(&m_batch[0], sizeof(GEBIndex_entry), n, m_idx);
+    m_batch.resize(n);
+    m_left = n ? m_left - n : 0; // a short index ends here
+    m_pos = 0;
+    if(n == 0)
+      return NULL;
+  }
+  return &m_batch[m_pos];
+}
+
+bool GEBIndex_valid(const char* fileName, const char* idxName) {
+  GEBIndexReader r;
+  return r.open(fileName, idxName);
+}
+
+/****************************************************/
+
+// common part of the two selecting streams: an output buffer
+// that is refilled on demand
+class GEBSelectStream
+{
+ protected:
+  GEBSelect m_sel;
+  vector<BYTE> m_out;
+  size_t m_outPos;
+
+  // appends the next piece of selected data to m_out;
+  // false at the end
+  virtual bool refill() = 0;
+
+  static ssize_t cookieRead(void* cookie, char* buf, size_t size);
+  static int cookieClose(void* cookie);
+
+ public:
+  GEBSelectStream(const GEBSelect* sel);
+  virtual ~GEBSelectStream() {}
+
+  FILE* open();
+};
+
+GEBSelectStream::GEBSelectStream(const GEBSelect* sel) {
+  m_sel = *sel;
+  m_outPos = 0;
+}
+
+FILE* GEBSelectStream::open() {
+  cookie_io_functions_t io;
+  io.read = &GEBSelectStream::cookieRead;
+  io.write = NULL;
+  io.seek = NULL;
+  io.close = &GEBSelectStream::cookieClose;
+
+  return fopencookie(this, "r", io);
+}
+
+ssize_t GEBSelectStream::cookieRead(void* cookie, char* buf, size_t size) {
+  GEBSelectStream* s = (GEBSelectStream*) cookie;
+
+  if(s->m_outPos == s->m_out.size()) {
+    s->m_out.clear();
+    s->m_outPos = 0;
+    if(!s->refill())
+      return 0;
+  }
+
+  size_t n = s->m_out.size() - s->m_outPos;
+  if(n > size)
+    n = size;
+  memcpy(buf, &s->m_out[s->m_outPos], n);
+  s->m_outPos += n;
+
+  return n;
+}
+
+int GEBSelectStream::cookieClose(void* cookie) {
+  delete (GEBSelectStream*) cookie;
+  return 0;
+}
+
+/****************************************************/
+
+// selected records of a plain file, found through its index
+class GEBIndexStream : public GEBSelectStream
+{
+ private:
+  int m_fd;
+  GEBIndexReader m_index;
+
+ protected:
+  bool refill();
+
+ public:
+  GEBIndexStream(const GEBSelect* sel);
+  ~GEBIndexStream();
+
+  bool open(const char* fileName, const char* idxName);
+};
+
+GEBIndexStream::GEBIndexStream(const GEBSelect* sel) :
+  GEBSelectStream(sel) {
+  m_fd = -1;
+}
+
+GEBIndexStream::~GEBIndexStream() {
+  if(m_fd >= 0)
+    close(m_fd);
+}
+
+bool GEBIndexStream::open(const char* fileName, const char* idxName) {
+  if(!m_index.open(fileName, idxName))
+    return false;
+
+  m_fd = ::open(fileName, O_RDONLY);
+  return (m_fd >= 0);
+}
+
+bool GEBIndexStream::refill() {
+  const GEBIndex_entry* e;
+  if(m_fd < 0)
+    return false;
+
+  // first selected record; dropped ones may leave their header
+  while((e = m_index.peek()) != NULL) {
+    gebData geb;
+    geb.type = e->type;
+    geb.length = e->length;
+    geb.timestamp = e->timestamp;
+    if(GEBSelect_keep(&m_sel, &geb))
+      break;
+    if(GEBSelect_header(&m_sel, &geb)) {
+      geb.length = 0;
+      size_t at = m_out.size();
+      m_out.resize(at + sizeof(gebData));
+      memcpy(&m_out[at], &geb, sizeof(gebData));
+    }
+    m_index.next();
+    // headers only so far, hand them over before reading on
+    if(m_out.size() >= (256 << 10))
+      return true;
+  }
+  if(!e)
+    return !m_out.empty();
+
+  // and the selected ones right behind it, read in one go
+  unsigned long long start = e->offset;
+  unsigned long long end = start;
+  while((e = m_index.peek()) != NULL) {
+    gebData geb;
+    geb.type = e->type;
+    geb.length = e->length;
+    geb.timestamp = e->timestamp;
+    if(e->offset != end || !GEBSelect_keep(&m_sel, &geb) ||
+       (end > start && end - start + sizeof(gebData) + e->length
+	> GEBINDEX_MAXREAD))
+      break;
+    end += sizeof(gebData) + e->length;
+    m_index.next();
+  }
+
+  size_t at = m_out.size();
+  m_out.resize(at + (end - start));
+  size_t done = 0;
+  while(at + done < m_out.size()) {
+    ssize_t n = pread(m_fd, &m_out[at + done], m_out.size() - at - done, start + done);
+    if(n <= 0) {
+      cerr << "GEBIndex: read failed at byte " << start + done << endl;
+      m_out.resize(at + done);
+      close(m_fd);
+      m_fd = -1;
+      break;
+    }
+    done += n;
+  }
+
+  return !m_out.empty();
+}
+
+FILE* GEBIndex_open(const char* fileName, const char* idxName,
+		    const GEBSelect* sel) {
+  GEBIndexStream* s = new GEBIndexStream(sel);
+  if(!s->open(fileName, idxName)) {
+    delete s;
+    return NULL;
+  }
+
+  FILE* f = s->GEBSelectStream::open();
+  if(!f)
+    delete s;
+  return f;
+}
+
+/****************************************************/
+
+// selected records of a stream that is read in full
+class GEBFilterStream : public GEBSelectStream
+{
+ private:
+  FILE* m_in;
+
+ protected:
+  bool refill();
+
+ public:
+  GEBFilterStream(FILE* in, const GEBSelect* sel) :
+    GEBSelectStream(sel) { m_in = in; }
+  ~GEBFilterStream() { fclose(m_in); }
+};
+
+bool GEBFilterStream::refill() {
+  gebData aGeb;
+
+  // pass on at least one record, or a few hundred kB
+  while(m_out.size() < (256 << 10)) {
+    if(fread(&aGeb, sizeof(gebData), 1, m_in) != 1 || aGeb.length < 0)
+      break;
+
+    size_t at = m_out.size();
+    m_out.resize(at + sizeof(gebData) + aGeb.length);
+    memcpy(&m_out[at], &aGeb, sizeof(gebData));
+    size_t n = fread(&m_out[at + sizeof(gebData)], 1, aGeb.length, m_in);
+
+    if(n == (size_t) aGeb.length && GEBSelect_header(&m_sel, &aGeb)) {
+      aGeb.length = 0;
+      m_out.resize(at + sizeof(gebData));
+      memcpy(&m_out[at], &aGeb, sizeof(gebData));
+    } else if(n != (size_t) aGeb.length || !GEBSelect_keep(&m_sel, &aGeb))
+      m_out.resize(at);
+    if(n != (size_t) aGeb.length)
+      break;
+  }
+
+  return !m_out.empty();
+}
+
+FILE* GEBSelect_filter(FILE* in, const GEBSelect* sel) {
+  GEBFilterStream* s = new GEBFilterStream(in, sel);
+  FILE* f = s->open();
+  if(!f)
+    delete s;
+  return f;
+}
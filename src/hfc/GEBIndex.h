@@ -0,0 +1,132 @@
+#ifndef __GEBINDEX_H
+#define __GEBINDEX_H
+
+#include <stdio.h>
+#include <vector>
+#include "global.h"
+#include "HFC.h"
+
+//
+// Sidecar index for GEB files, and selective reading with it
+//
+// The index (<file>.idx) holds one entry per GEB header: file
+// offset, type, payload length and timestamp. It is built once
+// by GEB_index (or on first use by unpackGRETINA -index), and
+// remembers size and modification time of the data file, so a
+// stale index is noticed and rebuilt.
+//
+// With the index, a GEBSelect (types to drop, time window) is
+// applied before any data is read: only the selected records
+// are read from the file, with runs of neighbouring records
+// merged into one read. The result is served as a read-only
+// FILE* with the usual GEB header + payload layout, so it can
+// be fed to HFCStream or read directly.
+//
+// User methods:
+//
+// void GEBSelect_init(GEBSelect* sel);
+// selects everything
+//
+// bool GEBSelect_keep(const GEBSelect* sel, const gebData* geb);
+// true if the record passes the selection
+//
+// bool GEBSelect_header(const GEBSelect* sel, const gebData* geb);
+// true if the record is dropped for its type only and, with
+// sel->headerOnly, is passed on as its header with length 0:
+// the payload is not read, but the timestamp still reaches
+// the event building
+//
+// long long GEBIndex_build(const char* fileName, const char* idxName);
+// scans a plain GEB file and writes its index; returns the
+// number of entries, -1 on failure
+//
+// bool GEBIndex_valid(const char* fileName, const char* idxName);
+// true if idxName is an index for the current fileName
+//
+// GEBIndexReader
+// reads the entries of an index back; the file layout is known
+// only to GEBIndex.cpp:
+//   bool open(const char* fileName, const char* idxName);
+//     false if idxName can't be read or is not an index for
+//     the current fileName
+//   unsigned long long entries();
+//   const GEBIndex_entry* peek();  the next entry, NULL at the end
+//   const GEBIndex_entry* next();  the same, and moves past it
+// the pointers are valid until the next call
+//
+// FILE* GEBIndex_open(const char* fileName, const char* idxName,
+//                     const GEBSelect* sel);
+// the selected records of fileName as a stream (fopencookie),
+// NULL if file or index can't be used
+//
+// FILE* GEBSelect_filter(FILE* in, const GEBSelect* sel);
+// the same selection without index, for streams that can't
+// seek (compressed input): every record is read, but only
+// the selected ones are passed on. fclose() closes 'in' too,
+// and so does a failure to open.
+//
+
+#define GEBINDEX_MAGIC  "GEBIDX01"
+#define GEBSELECT_NTYPES 256
+
+struct GEBIndex_entry
+{
+  unsigned long long offset; // of the GEB header in the file
+  int type;
+  int length;                // payload in bytes
+  long long timestamp;
+};
+
+struct GEBSelect
+{
+  bool drop[GEBSELECT_NTYPES]; // types outside the table are kept
+  bool headerOnly;             // dropped types still pass their header
+  long long tsLow;
+  long long tsHigh;
+};
+
+void GEBSelect_init(GEBSelect* sel);
+
+inline bool GEBSelect_keep(const GEBSelect* sel, const gebData* geb) {
+  if(geb->type >= 0 && geb->type < GEBSELECT_NTYPES && sel->drop[geb->type])
+    return false;
+  return (geb->timestamp >= sel->tsLow && geb->timestamp <= sel->tsHigh);
+}
+
+inline bool GEBSelect_header(const GEBSelect* sel, const gebData* geb) {
+  return (sel->headerOnly &&
+	  geb->type >= 0 && geb->type < GEBSELECT_NTYPES && sel->drop[geb->type] &&
+	  geb->timestamp >= sel->tsLow && geb->timestamp <= sel->tsHigh);
+}
+
+class GEBIndexReader
+{
+ private:
+  FILE* m_idx;
+  unsigned long long m_entries;
+  unsigned long long m_left; // entries not read from the file yet
+  std::vector<GEBIndex_entry> m_batch;
+  size_t m_pos;
+
+ public:
+  GEBIndexReader();
+  ~GEBIndexReader();
+
+  bool open(const char* fileName, const char* idxName);
+  unsigned long long entries() { return m_entries; }
+  const GEBIndex_entry* peek();
+  const GEBIndex_entry* next() {
+    const GEBIndex_entry* e = peek();
+    if(e)
+      m_pos++;
+    return e;
+  }
+};
+
+long long GEBIndex_build(const char* fileName, const char* idxName);
+bool GEBIndex_valid(const char* fileName, const char* idxName);
+FILE* GEBIndex_open(const char* fileName, const char* idxName,
+		    const GEBSelect* sel);
+FILE* GEBSelect_filter(FILE* in, const GEBSelect* sel);
+
+#endif
@@ -0,0 +1,532 @@
+#include "GEBZip.h"
+#include <iostream>
+#include <thread>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bzlib.h>
+
+using namespace std;
+
+// bzip2 block and end-of-stream magics, 48 bit each
+#define BZ_BLOCKMAGIC 0x314159265359ULL
+#define BZ_EOSMAGIC   0x177245385090ULL
+#define BZ_MAGICMASK  0xFFFFFFFFFFFFULL
+
+// decoded piece size of the sequential gzip job, and how
+// much compressed data one BGZF job takes at least
+#define GEBZIP_GZCHUNK   (4 << 20)
+#define GEBZIP_BGZFCHUNK (1 << 20)
+
+GEBZip::GEBZip(int nThreads) {
+  m_fd = -1;
+  m_map = NULL;
+  m_size = 0;
+  m_format = 0;
+
+  if(nThreads <= 0)
+    nThreads = thread::hardware_concurrency();
+  m_nThreads = (nThreads > 0) ? nThreads : 1;
+
+  m_nextBlock = -1;
+  m_nextMember = 0;
+  m_done = false;
+  m_zInit = false;
+  m_nextChunk = 0;
+  m_tsLow = LLONG_MIN;
+  m_tsHigh = LLONG_MAX;
+  m_cur.ok = true;
+  m_curPos = 0;
+}
+
+GEBZip::~GEBZip() {
+  // workers still read the mapping
+  while(!m_jobs.empty()) {
+    m_jobs.front().wait();
+    m_jobs.pop_front();
+  }
+
+  if(m_zInit)
+    inflateEnd(&m_z);
+  if(m_map)
+    munmap((void*) m_map, m_size);
+  if(m_fd >= 0)
+    close(m_fd);
+}
+
+/****************************************************/
+
+// BGZF member size from the gzip extra field, 0 if the
+// member at pos is not BGZF
+static size_t GEBZip_bgzfSize(const BYTE* map, size_t size, size_t pos) {
+  if(size - pos < 18 || map[pos] != 0x1f || map[pos+1] != 0x8b ||
+     !(map[pos+3] & 4))
+    return 0;
+
+  size_t xlen = map[pos+10] | (map[pos+11] << 8);
+  size_t p = pos + 12;
+  size_t xend = p + xlen;
+  if(xend > size)
+    return 0;
+
+  while(p + 4 <= xend) {
+    size_t slen = map[p+2] | (map[p+3] << 8);
+    if(map[p] == 'B' && map[p+1] == 'C' && slen == 2 && p + 6 <= xend) {
+      size_t bsize = (map[p+4] | (map[p+5] << 8)) + 1;
+      return (pos + bsize <= size) ? bsize : 0;
+    }
+    p += 4 + slen;
+  }
+  return 0;
+}
+
+bool GEBZip::open(const char* fileName) {
+  m_fd = ::open(fileName, O_RDONLY);
+  if(m_fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(m_fd, &st) != 0 || st.st_size < 4)
+    return false;
+  m_size = st.st_size;
+
+  void* map = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if(map == MAP_FAILED)
+    return false;
+  m_map = (const BYTE*) map;
+  madvise(map, m_size, MADV_SEQUENTIAL);
+
+  if(m_map[0] == 'B' && m_map[1] == 'Z' && m_map[2] == 'h') {
+    m_format = GEBZIP_BZ2;
+    bool eos = true;
+    m_nextBlock = 32;
+    while(m_nextBlock >= 0 && eos)
+      m_nextBlock = findMarker(m_nextBlock, &eos);
+    return true;
+  }
+
+  if(m_map[0] == 0x1f && m_map[1] == 0x8b) {
+    if(GEBArch_readIndex(m_map, m_size, m_chunks)) {
+      m_format = GEBZIP_ARCH;
+      return true;
+    }
+    if(GEBZip_bgzfSize(m_map, m_size, 0)) {
+      m_format = GEBZIP_BGZF;
+      return true;
+    }
+    m_format = GEBZIP_GZ;
+    memset(&m_z, 0, sizeof(m_z));
+    if(inflateInit2(&m_z, 15+16) != Z_OK)
+      return false;
+    m_zInit = true;
+    return true;
+  }
+
+  return false;
+}
+
+void GEBZip::setRange(long long tsLow, long long tsHigh) {
+  m_tsLow = tsLow;
+  m_tsHigh = tsHigh;
+}
+
+FILE* GEBZip::stream() {
+  cookie_io_functions_t io;
+  io.read = &GEBZip::cookieRead;
+  io.write = NULL;
+  io.seek = NULL;
+  io.close = &GEBZip::cookieClose;
+
+  return fopencookie(this, "r", io);
+}
+
+/****************************************************/
+
+long long GEBZip::findMarker(long long fromBit, bool* isEOS) {
+  // byte-wise window, the magics can start at any bit
+  size_t b0 = fromBit / 8;
+  unsigned long long v = 0;
+
+  for(size_t i=b0; i<m_size; i++) {
+    v = (v << 8) | m_map[i];
+    if(i < b0 + 5)
+      continue;
+
+    for(int s=7; s>=0; s--) {
+      unsigned long long w = (v >> s) & BZ_MAGICMASK;
+      if(w != BZ_BLOCKMAGIC && w != BZ_EOSMAGIC)
+	continue;
+      long long start = (long long) (i+1)*8 - s - 48;
+      if(start < fromBit || start < (long long) b0*8)
+	continue;
+      *isEOS = (w == BZ_EOSMAGIC);
+      return start;
+    }
+  }
+
+  return -1;
+}
+
+bool GEBZip::nextBlockRange(long long* start, long long* end) {
+  if(m_nextBlock < 0)
+    return false;
+
+  bool eos = false;
+  long long e = findMarker(m_nextBlock + 48, &eos);
+
+  *start = m_nextBlock;
+  if(e < 0) {
+    // truncated file, the decoder will tell
+    *end = (long long) m_size*8;
+    m_nextBlock = -1;
+    return true;
+  }
+  *end = e;
+
+  // skip end-of-stream marker and the header of
+  // a following stream
+  while(e >= 0 && eos)
+    e = findMarker(e + 48, &eos);
+  m_nextBlock = e;
+
+  return true;
+}
+
+bool GEBZip::nextMemberRange(size_t* start, size_t* end) {
+  if(m_nextMember >= m_size)
+    return false;
+
+  size_t pos = m_nextMember;
+  while(pos < m_size && pos - m_nextMember < GEBZIP_BGZFCHUNK) {
+    size_t bsize = GEBZip_bgzfSize(m_map, m_size, pos);
+    if(!bsize)
+      break;
+    pos += bsize;
+  }
+
+  if(pos == m_nextMember) {
+    // not BGZF from here on, inflate the rest in order
+    m_format = GEBZIP_GZ;
+    memset(&m_z, 0, sizeof(m_z));
+    if(inflateInit2(&m_z, 15+16) == Z_OK)
+      m_zInit = true;
+    else
+      m_done = true;
+    return false;
+  }
+
+  *start = m_nextMember;
+  *end = pos;
+  m_nextMember = pos;
+  return true;
+}
+
+bool GEBZip::nextArchiveRange(size_t* start, size_t* end) {
+  while(m_nextChunk < m_chunks.size()) {
+    const GEBArch_chunk& c = m_chunks[m_nextChunk++];
+    if(c.maxTS < m_tsLow || c.minTS > m_tsHigh)
+      continue;
+    *start = c.offset;
+    *end = c.offset + c.csize;
+    return true;
+  }
+  return false;
+}
+
+/****************************************************/
+
+static unsigned int GEBZip_bits(const BYTE* map, long long pos, int n) {
+  unsigned int v = 0;
+  for(int i=0; i<n; i++, pos++)
+    v = (v << 1) | ((map[pos/8] >> (7 - pos%8)) & 1);
+  return v;
+}
+
+GEBZip_chunk GEBZip::decodeBlock(const BYTE* map, long long start,
+				 long long end) {
+  GEBZip_chunk c;
+  c.ok = false;
+
+  // wrap the block into a stream of its own: header, the block
+  // bits, end-of-stream magic and the stream CRC, which for a
+  // single block is the block CRC
+  long long nbits = end - start;
+  size_t nbytes = nbits / 8;
+  int rest = nbits % 8;
+
+  vector<BYTE> in(4 + nbytes + 12);
+  memcpy(&in[0], "BZh9", 4);
+
+  const BYTE* src = map + start/8;
+  int sh = start % 8;
+  BYTE* dst = &in[4];
+  if(sh == 0) {
+    memcpy(dst, src, nbytes);
+  } else {
+    for(size_t k=0; k<nbytes; k++)
+      dst[k] = (BYTE) ((src[k] << sh) | (src[k+1] >> (8 - sh)));
+  }
+
+  unsigned long long acc = 0;
+  int nacc = 0;
+  size_t out = 4 + nbytes;
+  if(rest) {
+    acc = GEBZip_bits(map, start + 8*nbytes, rest);
+    nacc = rest;
+  }
+
+  unsigned long long tail[2];
+  tail[0] = BZ_EOSMAGIC;
+  tail[1] = GEBZip_bits(map, start + 48, 32);
+  int tailbits[2] = {48, 32};
+  for(int t=0; t<2; t++) {
+    for(int i=tailbits[t]-1; i>=0; i--) {
+      acc = (acc << 1) | ((tail[t] >> i) & 1);
+      if(++nacc == 8) {
+	in[out++] = (BYTE) acc;
+	acc = 0;
+	nacc = 0;
+      }
+    }
+  }
+  if(nacc)
+    in[out++] = (BYTE) (acc << (8 - nacc));
+
+  bz_stream bz;
+  memset(&bz, 0, sizeof(bz));
+  if(BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK)
+    return c;
+
+  bz.next_in = (char*) &in[0];
+  bz.avail_in = out;
+
+  c.data.resize(4*nbytes + 4096);
+  size_t have = 0;
+  int ret = BZ_OK;
+  while(ret == BZ_OK) {
+    if(have == c.data.size())
+      c.data.resize(2*c.data.size());
+    bz.next_out = (char*) &c.data[have];
+    bz.avail_out = c.data.size() - have;
+    ret = BZ2_bzDecompress(&bz);
+    have = c.data.size() - bz.avail_out;
+    if(ret == BZ_OK && bz.avail_in == 0 && bz.avail_out > 0)
+      break; // block ended early
+  }
+  BZ2_bzDecompressEnd(&bz);
+
+  c.data.resize(have);
+  c.ok = (ret == BZ_STREAM_END);
+  return c;
+}
+
+GEBZip_chunk GEBZip::inflateMembers(const BYTE* map, size_t start,
+				    size_t end) {
+  GEBZip_chunk c;
+  c.ok = false;
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if(inflateInit2(&z, 15+16) != Z_OK)
+    return c;
+
+  z.next_in = (Bytef*) map + start;
+  z.avail_in = end - start;
+
+  c.data.resize(4*(end - start) + 4096);
+  size_t have = 0;
+  for(;;) {
+    if(have == c.data.size())
+      c.data.resize(2*c.data.size());
+    z.next_out = &c.data[have];
+    z.avail_out = c.data.size() - have;
+    int ret = inflate(&z, Z_NO_FLUSH);
+    have = c.data.size() - z.avail_out;
+
+    if(ret == Z_STREAM_END) {
+      if(z.avail_in == 0) {
+	c.ok = true;
+	break;
+      }
+      inflateReset(&z);
+    } else if(ret != Z_OK || (z.avail_in == 0 && z.avail_out > 0)) {
+      break;
+    }
+  }
+  inflateEnd(&z);
+
+  c.data.resize(have);
+  return c;
+}
+
+GEBZip_chunk GEBZip::inflateSequential() {
+  GEBZip_chunk c;
+  c.ok = true;
+  c.data.resize(GEBZIP_GZCHUNK);
+
+  m_z.next_out = &c.data[0];
+  m_z.avail_out = c.data.size();
+
+  while(m_z.avail_out > 0) {
+    if(m_z.avail_in == 0) {
+      if(m_nextMember >= m_size) {
+	m_done = true;
+	break;
+      }
+      // avail_in is 32 bit, large files are fed in pieces
+      size_t n = m_size - m_nextMember;
+      if(n > (1u << 30))
+	n = 1u << 30;
+      m_z.next_in = (Bytef*) m_map + m_nextMember;
+      m_z.avail_in = n;
+      m_nextMember += n;
+    }
+
+    int ret = inflate(&m_z, Z_NO_FLUSH);
+    if(ret == Z_STREAM_END) {
+      if(m_z.avail_in == 0 && m_nextMember >= m_size) {
+	m_done = true;
+	break;
+      }
+      // next member of a multi-member file
+      inflateReset(&m_z);
+    } else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+      c.ok = false;
+      m_done = true;
+      break;
+    }
+  }
+
+  c.data.resize(c.data.size() - m_z.avail_out);
+  return c;
+}
+
+/****************************************************/
+
+void GEBZip::launch() {
+  if(m_format == GEBZIP_GZ) {
+    // one stream, so one job at a time, running ahead of the reader
+    if(m_jobs.empty() && !m_done && m_zInit)
+      m_jobs.push_back(async(launch::async, &GEBZip::inflateSequential,
+			     this));
+    return;
+  }
+
+  while((int) m_jobs.size() < m_nThreads) {
+    if(m_format == GEBZIP_BZ2) {
+      long long s, e;
+      if(!nextBlockRange(&s, &e))
+	break;
+      m_jobs.push_back(async(launch::async, &GEBZip::decodeBlock,
+			     m_map, s, e));
+      m_ranges.push_back(make_pair(s, e));
+    } else {
+      size_t s, e;
+      if(m_format == GEBZIP_ARCH ? !nextArchiveRange(&s, &e)
+	 : !nextMemberRange(&s, &e))
+	break;
+      m_jobs.push_back(async(launch::async, &GEBZip::inflateMembers,
+			     m_map, s, e));
+    }
+  }
+}
+
+bool GEBZip::nextChunk() {
+  launch();
+  if(m_jobs.empty())
+    return false;
+
+  GEBZip_chunk c = m_jobs.front().get();
+  m_jobs.pop_front();
+
+  if(m_format == GEBZIP_BZ2) {
+    pair<long long, long long> r = m_ranges.front();
+    m_ranges.pop_front();
+
+    // the magic can show up by chance inside compressed data;
+    // such a piece fails its CRC, glue it to the next one
+    while(!c.ok) {
+      long long s, e;
+      if(!m_ranges.empty()) {
+	m_jobs.front().wait();
+	m_jobs.pop_front();
+	e = m_ranges.front().second;
+	m_ranges.pop_front();
+      } else if(!nextBlockRange(&s, &e)) {
+	break;
+      }
+      r.second = e;
+      c = decodeBlock(m_map, r.first, r.second);
+    }
+  }
+
+  if(!c.ok) {
+    cerr << "GEBZip: corrupt compressed data, stopping here" << endl;
+    while(!m_jobs.empty()) {
+      m_jobs.front().wait();
+      m_jobs.pop_front();
+    }
+    m_ranges.clear();
+    m_nextBlock = -1;
+    m_nextMember = m_size;
+    m_done = true;
+    if(m_zInit) {
+      inflateEnd(&m_z);
+      m_zInit = false;
+    }
+  }
+
+  m_cur.data.swap(c.data);
+  m_curPos = 0;
+
+  launch();
+  return true;
+}
+
+ssize_t GEBZip::cookieRead(void* cookie, char* buf, size_t size) {
+  GEBZip* z = (GEBZip*) cookie;
+
+  size_t n = 0;
+  while(n < size) {
+    if(z->m_curPos == z->m_cur.data.size() && !z->nextChunk())
+      break;
+
+    size_t k = z->m_cur.data.size() - z->m_curPos;
+    if(k > size - n)
+      k = size - n;
+    memcpy(buf + n, &z->m_cur.data[z->m_curPos], k);
+    z->m_curPos += k;
+    n += k;
+  }
+
+  return n;
+}
+
+int GEBZip::cookieClose(void* cookie) {
+  delete (GEBZip*) cookie;
+  return 0;
+}
+
+/****************************************************/
+
+FILE* GEBZip_open(const char* fileName, int nThreads) {
+  return GEBZip_openRange(fileName, nThreads, LLONG_MIN, LLONG_MAX);
+}
+
+FILE* GEBZip_openRange(const char* fileName, int nThreads,
+		       long long tsLow, long long tsHigh) {
+  GEBZip* z = new GEBZip(nThreads);
+  if(!z->open(fileName)) {
+    delete z;
+    return NULL;
+  }
+  z->setRange(tsLow, tsHigh);
+
+  FILE* f = z->stream();
+  if(!f)
+    delete z;
+  return f;
+}
@@ -0,0 +1,130 @@
+#ifndef __GEBZIP_H
+#define __GEBZIP_H
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <future>
+#include <zlib.h>
+#include "global.h"
+#include "GEBArchive.h"
+
+//
+// GEBZip decompresses .gz and .bz2 GEB files inside the
+// process, instead of reading from a popen'ed zcat/bzcat.
+//
+// The compressed file is mmap'ed and cut into pieces that can
+// be decoded on their own, which are handed to worker threads;
+// the decoded pieces are served back in file order.
+//
+// bzip2: every block starts with a 48 bit magic (not byte
+// aligned) and carries its own CRC, so each block is wrapped
+// into a single-block stream and decoded separately. This
+// works for plain bzip2 output as well as for multi-stream
+// files (pbzip2, cat'ed .bz2).
+//
+// gzip: members written by bgzip (BGZF, block size in the
+// header) are decoded in parallel. Any other gzip file has no
+// known restart points and is inflated by one thread, ahead of
+// the reader, like zcat was. Multi-member files work in both
+// cases.
+//
+// .gebz archives (GEBArchive.h): chunks are taken from the index
+// and decoded in parallel; with a time range only chunks that
+// can hold timestamps in [tsLow, tsHigh] are decoded. Chunks end
+// on GEB event boundaries, so the output is still a GEB stream,
+// though events outside the range within a chunk are kept.
+//
+// User methods:
+//
+// FILE* GEBZip_open(const char* fileName, int nThreads);
+// returns a read-only FILE* with the decompressed content
+// (glibc fopencookie), NULL if the file can't be opened or
+// is neither gzip nor bzip2. nThreads <= 0 uses all cores.
+// fclose() on it unmaps the file and joins the workers.
+//
+// FILE* GEBZip_openRange(const char* fileName, int nThreads,
+//                        long long tsLow, long long tsHigh);
+// same, but for .gebz archives only the chunks overlapping
+// [tsLow, tsHigh] are read. Other formats are read in full.
+//
+
+#define GEBZIP_BZ2  1
+#define GEBZIP_GZ   2 // one inflate stream, decoded in order
+#define GEBZIP_BGZF 3 // independent gzip members
+#define GEBZIP_ARCH 4 // .gebz archive with chunk index
+
+// one decoded piece
+struct GEBZip_chunk
+{
+  bool ok;
+  std::vector<BYTE> data;
+};
+
+class GEBZip
+{
+ private:
+  int m_fd;
+  const BYTE* m_map;
+  size_t m_size;
+
+  int m_format;
+  int m_nThreads;
+
+  // bz2: bit position of the next block magic, or -1
+  long long m_nextBlock;
+  // gz: byte position of the next undecoded member
+  size_t m_nextMember;
+  bool m_done;
+
+  z_stream m_z;   // GEBZIP_GZ only
+  bool m_zInit;
+
+  // GEBZIP_ARCH: index, next chunk and time range
+  std::vector<GEBArch_chunk> m_chunks;
+  size_t m_nextChunk;
+  long long m_tsLow;
+  long long m_tsHigh;
+
+  // jobs in flight, in file order; for bz2 also their bit range,
+  // so a block can be redone if a fake magic cut it in two
+  std::deque<std::future<GEBZip_chunk> > m_jobs;
+  std::deque<std::pair<long long, long long> > m_ranges;
+
+  GEBZip_chunk m_cur;
+  size_t m_curPos;
+
+  long long findMarker(long long fromBit, bool* isEOS);
+  bool nextBlockRange(long long* start, long long* end);
+  bool nextMemberRange(size_t* start, size_t* end);
+  bool nextArchiveRange(size_t* start, size_t* end);
+
+  // starts jobs until m_nThreads are in flight
+  void launch();
+  // makes the next decoded piece current; false at the end
+  bool nextChunk();
+
+  GEBZip_chunk inflateSequential();
+
+  static GEBZip_chunk decodeBlock(const BYTE* map, long long start,
+				  long long end);
+  static GEBZip_chunk inflateMembers(const BYTE* map, size_t start,
+				     size_t end);
+
+  static ssize_t cookieRead(void* cookie, char* buf, size_t size);
+  static int cookieClose(void* cookie);
+
+ public:
+  GEBZip(int nThreads);
+  ~GEBZip();
+
+  bool open(const char* fileName);
+  void setRange(long long tsLow, long long tsHigh);
+  FILE* stream();
+};
+
+FILE* GEBZip_open(const char* fileName, int nThreads);
+FILE* GEBZip_openRange(const char* fileName, int nThreads,
+		       long long tsLow, long long tsHigh);
+
+#endif
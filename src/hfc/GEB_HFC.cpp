@@ -11,6 +11,8 @@
 
 #include "global.h"
 #include "HFC.h"
+#include "HFCStream.h"
+#include "GEBZip.h"
 
 #define SQR(x)  ((x)*(x))
 
@@ -151,33 +153,6 @@ void BrowseData(gebData header) {
 }
 
 
-int HFC_mode3(BYTE* cBuf, HFC* hfc_list) {
-  /* Return value: processed data in bytes */
-
-  long long mode3_ts;
-  int mode3_len;
-
-  // 15th and 16th byte is ts high (and endian)
-  mode3_ts = ((long long) cBuf[14]) << 40;
-  mode3_ts += ((long long) cBuf[15]) << 32;
-  // 9th, 10th ts middle
-  mode3_ts += ((long long) cBuf[8]) << 24;
-  mode3_ts += ((long long) cBuf[9]) << 16;
-  // 11th, 12th ts 'low'
-  mode3_ts += ((long long) cBuf[10]) << 8;
-  mode3_ts += ((long long) cBuf[11]);
-
-  // 5th, 6th is length, in 32bit units
-  mode3_len = ((int)(cBuf[4])) << 8;
-  mode3_len += ((int)cBuf[5]);
-  mode3_len &= 0x7ff;
-  mode3_len *= 4; // convert into bytes
-
-  hfc_list->add(mode3_ts, 2, mode3_len+4, cBuf);
-
-  return (mode3_len + 4); // 0xaaaa 0xaaaa not counted in mode3_len
-}
-
 int main(int argc, char** argv) {
 
   gotsignal = 0;
@@ -187,13 +162,18 @@ int main(int argc, char** argv) {
   if(argc==1) {
     cerr << argv[0] << " <flag: -p (pipeout) or -z (.gz input file)> <Input file>" << endl
 	 << "brings GRETINA Mode3 event file" << endl
-	 << "in proper sequence" << endl;
+	 << "in proper sequence" << endl
+	 << "  -mem <MB> memory cap for the adaptive depth (default "
+	 << HFC_MEMCAP_MB << ")" << endl
+	 << "  -fixed    only the fixed depth of " << HFC_GEBDEPTH
+	 << " events, with no window and no cap" << endl;
     exit(0);
   }
 
   bool pipeflag = false;
   bool zipflag = false;
   bool bzipflag = false;
+  int memCapMB = HFC_MEMCAP_MB;
   FILE *in = NULL;
   FILE *out = NULL;
 
@@ -208,6 +188,12 @@ int main(int argc, char** argv) {
     } else if (!(strcmp(argv[1], "-bz"))) {
       argc--; argv++;
       bzipflag = true;
+    } else if (!(strcmp(argv[1], "-mem")) && argc > 2) {
+      memCapMB = atoi(argv[2]);
+      argc-=2; argv+=2;
+    } else if (!(strcmp(argv[1], "-fixed"))) {
+      argc--; argv++;
+      memCapMB = 0;
     } else {
       filename = argv[1];
       argc--; argv++;
@@ -232,29 +218,17 @@ int main(int argc, char** argv) {
 	cout << "HFC: opened file " << filename.c_str() << endl;
       }
     }
-  } else if (zipflag && !bzipflag) {
-    string zfilename = "zcat " + filename;
-    in = popen(zfilename.c_str(), "r");
-    if (!in) {
-      if (!pipeflag) {
-	cerr << "HFC: cannot open file " << zfilename.c_str() << endl;
-      }
-      return 1;
-    } else {
-      if (!pipeflag)
-	cout << "HFC: opened file " << zfilename.c_str() << endl;
-    }
-  } else if (bzipflag && !zipflag) {
-    string zfilename = "bzcat " + filename;
-    in = popen(zfilename.c_str(), "r");
+  } else {
+    // .gz or .bz2, decompressed in-process on all cores
+    in = GEBZip_open(filename.c_str(), 0);
     if (!in) {
       if (!pipeflag) {
-	cerr << "HFC: cannot open file " << zfilename.c_str() << endl;
+	cerr << "HFC: cannot open file " << filename.c_str() << endl;
       }
       return 1;
     } else {
       if (!pipeflag)
-	cout << "HFC: opened file " << zfilename.c_str() << endl;
+	cout << "HFC: opened compressed file " << filename.c_str() << endl;
     }
   }
 
@@ -263,8 +237,9 @@ int main(int argc, char** argv) {
   int EvtCount=0;
   BYTE cBuf[8*16382];
   gebData aGeb;
-  HFC hfc_list(50*8192, out);
-  // 972: strange mode 2 with mem depth 40*8192 needed
+  HFC hfc_list(HFC_GEBDEPTH, out);
+  if (memCapMB > 0)
+    hfc_list.setAdaptive((size_t) memCapMB*1024*1024, HFC_MINWINDOW);
 
   bool success=true;
 
@@ -301,166 +276,9 @@ int main(int argc, char** argv) {
 	 << endl;
 #endif
 
-    switch(aGeb.type) {
-    case 1: // Mode 2, so far always GEB, 1 event, GEB, 1 event,....
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	  }
-      }
-      break;
-
-    case 2: // Mode 3 (raw)
-      {
-	int nBytes = aGeb.length;
-	BYTE *data;
-	data=cBuf;
-	while(nBytes) {
-	  int nread;
-	  nread = HFC_mode3(data, &hfc_list);
-
-	  data+=nread;
-	  nBytes -=nread;
-
-	  if(nBytes < 0) {
-	    if (!pipeflag) {
-	      cerr << "HFC: nBytes negative!!"
-		   << endl;
-	    }
-	    exit(0);
-	    break;
-	  }
-	}
-      }
-      break;
-
-    case 3: // Mode 1
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 4: // BGS
-      break;
-
-    case 5: // S800 event
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 6: // S800 scaler etc.
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 7: // GRETINA scaler data - not yet implemented
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 8: // card 29
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 9: // S800 physics event
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 10: // S800 timestamped non-event (i.e. scaler) data
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 11: // Simulated GRETINA data
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 0x2B: // Contrived clover for coincidence
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 12: // CHICO
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 16: // DFMA
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 17: // PHOSWALL
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
-      }
-      break;
-
-    case 19: // GODDESS
-      if(!hfc_list.add(aGeb, cBuf) && success) {
+    switch(HFC_addGEB(aGeb, cBuf, &hfc_list)) {
+    case HFC_ADD_TOOOLD:
+      if(success) {
 	success = false;
 	if (!pipeflag) {
 	  cerr << "HFC: adding event in HFC failed"
@@ -469,36 +287,23 @@ int main(int argc, char** argv) {
       }
       break;
 
-
-    case 18: // PHOSWALLAUX
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
+    case HFC_ADD_BADMODE3:
+      if (!pipeflag) {
+	cerr << "HFC: nBytes negative!!"
+	     << endl;
       }
+      exit(0);
       break;
 
-    case 21: // LENDA
-      if(!hfc_list.add(aGeb, cBuf) && success) {
-	success = false;
-	if (!pipeflag) {
-	  cerr << "HFC: adding event in HFC failed"
-	       << endl;
-	}
+    case HFC_ADD_UNKNOWN:
+      if (!pipeflag) {
+	cerr << "HFC: Unknown packet type " << aGeb.type
+	     << " ... HFC: skipping that one" << endl;
       }
       break;
 
     default:
-      {
-	if (!pipeflag) {
-	  cerr << "HFC: Unknown packet type " << aGeb.type
-	       << " ... HFC: skipping that one" << endl;
-	}
-      }
       break;
-
     }
 
   }
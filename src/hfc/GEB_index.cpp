@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <iostream>
+#include <map>
+
+#include "global.h"
+#include "HFC.h"
+#include "GEBIndex.h"
+
+using namespace std;
+
+//
+// GEB_index: writes the sidecar index <file>.idx of a plain
+// (uncompressed) GEB file, see GEBIndex.h
+//
+
+int main(int argc, char** argv) {
+
+  if(argc < 2) {
+    cerr << argv[0] << " <Input file> [Index file]" << endl
+	 << "writes the GEB header index of a plain GEB file" << endl
+	 << "(default: <Input file>.idx)" << endl;
+    exit(0);
+  }
+
+  string filename = argv[1];
+  string idxname = (argc > 2) ? argv[2] : filename + ".idx";
+
+  long long n = GEBIndex_build(filename.c_str(), idxname.c_str());
+  if (n < 0) {
+    cerr << "GEB_index: cannot index " << filename
+	 << " into " << idxname << endl;
+    return 1;
+  }
+
+  // short summary per type, read back from the index
+  map<int, long long> count;
+  map<int, long long> bytes;
+  long long tsMin = 0, tsMax = 0;
+
+  GEBIndexReader idx;
+  if (!idx.open(filename.c_str(), idxname.c_str())) {
+    cerr << "GEB_index: cannot read back " << idxname << endl;
+    return 1;
+  }
+  const GEBIndex_entry *e;
+  for (long long i=0; (e = idx.next()) != NULL; i++) {
+    count[e->type]++;
+    bytes[e->type] += e->length;
+    if (i == 0 || e->timestamp < tsMin) tsMin = e->timestamp;
+    if (i == 0 || e->timestamp > tsMax) tsMax = e->timestamp;
+  }
+
+  cerr << "GEB_index: " << n << " headers indexed in " << idxname << endl
+       << "  timestamps " << tsMin << " ... " << tsMax << endl;
+  for (map<int, long long>::iterator it = count.begin(); it != count.end(); ++it)
+    cerr << "  type " << it->first << ": " << it->second << " headers, "
+	 << bytes[it->first]/1000000 << " Mb" << endl;
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#include "global.h"
+#include "HFC.h"
+#include "GEBZip.h"
+#include "GEBArchive.h"
+
+using namespace std;
+
+//
+// GEB_repack: converts a GEB file (plain, .gz or .bz2) into the
+// seekable .gebz archive format, see GEBArchive.h.
+// zcat on the archive gives back the input byte for byte.
+//
+
+// larger payloads are taken as a broken header
+#define REPACK_MAXPAYLOAD (64 << 20)
+
+int main(int argc, char** argv) {
+
+  if(argc < 3) {
+    cerr << argv[0] << " [-chunk <MB>] [-level <1-9>] [-t <threads>]"
+	 << " <Input file> <Output file>" << endl
+	 << "repacks a GEB file (plain, .gz or .bz2) into a" << endl
+	 << "seekable chunked archive (.gebz)" << endl;
+    exit(0);
+  }
+
+  int chunkSize = GEBARCH_CHUNKSIZE;
+  int level = 6;
+  int nThreads = 0;
+  string inName, outName;
+
+  while (argc > 1) {
+    if (!(strcmp(argv[1], "-chunk")) && argc > 2) {
+      chunkSize = atoi(argv[2]) << 20;
+      argc-=2; argv+=2;
+    } else if (!(strcmp(argv[1], "-level")) && argc > 2) {
+      level = atoi(argv[2]);
+      argc-=2; argv+=2;
+    } else if (!(strcmp(argv[1], "-t")) && argc > 2) {
+      nThreads = atoi(argv[2]);
+      argc-=2; argv+=2;
+    } else if (inName.empty()) {
+      inName = argv[1];
+      argc--; argv++;
+    } else {
+      outName = argv[1];
+      argc--; argv++;
+    }
+  }
+
+  // compressed input is recognized by its magic
+  FILE *in = GEBZip_open(inName.c_str(), nThreads);
+  if (!in)
+    in = fopen(inName.c_str(), "rb");
+  if (!in) {
+    cerr << "GEB_repack: cannot open file " << inName << endl;
+    return 1;
+  }
+
+  FILE *out = fopen(outName.c_str(), "wb");
+  if (!out) {
+    cerr << "GEB_repack: cannot open file " << outName << endl;
+    return 1;
+  }
+
+  GEBArchWriter arch(out, chunkSize, level, nThreads);
+
+  vector<BYTE> cBuf(8*16382);
+  gebData aGeb;
+  long long EvtCount = 0;
+  long long totread = 0;
+  long long rawBytes = 0;
+  size_t n;
+
+  while ((n = fread(&aGeb, 1, sizeof(gebData), in)) == sizeof(gebData)) {
+
+    if (aGeb.length < 0 || aGeb.length > REPACK_MAXPAYLOAD) {
+      // lost the event boundaries, keep the rest as it is
+      cerr << "GEB_repack: bad GEB header at byte " << totread
+	   << ", copying the rest unchanged" << endl;
+      arch.addRaw((BYTE*) &aGeb, sizeof(gebData));
+      rawBytes += sizeof(gebData);
+      n = 0;
+      break;
+    }
+
+    if ((int) cBuf.size() < aGeb.length)
+      cBuf.resize(aGeb.length);
+
+    size_t read = fread(&cBuf[0], 1, aGeb.length, in);
+    if ((int) read != aGeb.length) {
+      cerr << "GEB_repack: " << aGeb.length << " bytes expected but "
+	   << read << " bytes read at the end of the input" << endl;
+      arch.addRaw((BYTE*) &aGeb, sizeof(gebData));
+      arch.addRaw(&cBuf[0], read);
+      rawBytes += sizeof(gebData) + read;
+      n = 0;
+      break;
+    }
+
+    arch.add(&aGeb, &cBuf[0]);
+    totread += sizeof(gebData) + read;
+    EvtCount++;
+
+    if ((EvtCount % 100000) == 0) {
+      cerr << "Event " << EvtCount
+	   << " total read:" << totread/1000000
+	   << " Mb \r";
+      cerr.flush();
+    }
+  }
+
+  // a partial header at the end, or whatever follows a bad one
+  if (n > 0) {
+    arch.addRaw((BYTE*) &aGeb, n);
+    rawBytes += n;
+  }
+  while ((n = fread(&cBuf[0], 1, cBuf.size(), in)) > 0) {
+    arch.addRaw(&cBuf[0], n);
+    rawBytes += n;
+  }
+
+  bool ok = arch.close();
+  fclose(in);
+  if (fclose(out) != 0)
+    ok = false;
+
+  cerr << "GEB_repack: " << EvtCount << " events, "
+       << (totread + rawBytes)/1000000 << " Mb in, "
+       << arch.bytesWritten()/1000000 << " Mb out, "
+       << arch.chunks() << " chunks" << endl;
+  if (rawBytes)
+    cerr << "GEB_repack: " << rawBytes
+	 << " bytes outside GEB events kept as they are" << endl;
+
+  if (!ok) {
+    cerr << "GEB_repack: writing " << outName << " failed" << endl;
+    return 1;
+  }
+  return 0;
+}
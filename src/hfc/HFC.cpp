@@ -1,10 +1,15 @@
 #include "HFC.h"
 #include "stdio.h"
 #include "string.h"
+#include <algorithm>
 
 
 #define HFC_DEFAULTNUM 8192
 
+// adaptive mode: the window follows twice the largest lateness,
+// and may shrink (at most halving) once per period of items
+#define HFC_ADAPTPERIOD 65536
+
 HFC::HFC() {
   init(HFC_DEFAULTNUM, NULL);
 }
@@ -24,6 +29,8 @@ HFC::HFC(int num, FILE* out) {
 void HFC::init(int num, FILE* out) {
   m_evt=0;
   m_file = out;
+  m_writer = NULL;
+  m_writerArg = NULL;
 
   if(num > 200)
     m_memdepth = num;
@@ -31,79 +38,158 @@ void HFC::init(int num, FILE* out) {
     m_memdepth = 200;
 
   m_discarded=0;
+
+  m_adaptive = false;
+  m_fixedWindow = false;
+  m_memCap = 0;
+  m_minWindow = 0;
+  m_window = 0;
+  m_newestTS = 0;
+  m_periodLate = 0;
+  m_periodEvt = 0;
+  m_capWrites = 0;
+
+  m_written = false;
+  m_lastWrittenTS = 0;
+
+  m_bytes = 0;
+  m_peakBytes = 0;
+  m_peakDepth = 0;
+  m_peakWindow = 0;
+}
+
+void HFC::setAdaptive(size_t memCap, long long minWindow) {
+  m_adaptive = true;
+  m_memCap = memCap;
+  m_minWindow = (minWindow > 0) ? minWindow : 0;
+  // the disorder is not known before the first period is
+  // over, until then only the memory cap limits the window
+  m_window = -1;
+  m_peakWindow = 0;
+}
+
+void HFC::setLookBack(long long lookBack, size_t memCap) {
+  m_adaptive = true;
+  m_fixedWindow = true;
+  m_memCap = memCap;
+  m_minWindow = (lookBack > 0) ? lookBack : 0;
+  m_window = m_minWindow;
+  m_peakWindow = m_window;
+  // the window alone decides, there is no fixed depth to fill
+  m_memdepth = 1;
+}
+
+/****************************************************/
+
+HFC_slab::HFC_slab() {
+  m_pagePos = NULL;
+  m_pageLeft = 0;
+}
+
+HFC_slab::~HFC_slab() {
+  for(size_t i=0; i<m_pages.size(); i++)
+    delete [] m_pages[i];
+}
+
+int HFC_slab::sizeClass(int length) {
+  int k = (length + BLOCKSTEP - 1) / BLOCKSTEP;
+  return (k > 0) ? k : 1;
 }
 
-// We assume that the latest item to be added is actually
-// pretty late according its timestamp.
-
-bool HFC::insert(HFC_item* hfc) {
-#define HFCITEMISDEEP 100
-  int cts=0;
-
-  list<HFC_item*>::iterator HFC_it = m_HFClist.end();
-  list<HFC_item*>::iterator HFC_it2 = m_HFClist.begin();
-
-  HFC_it--;
-
-  while(HFC_it != m_HFClist.begin() &&
-	(*HFC_it)->geb.timestamp >=
-	hfc->geb.timestamp ) {
-    HFC_it--;
-    cts++;
-    if((cts == HFCITEMISDEEP) &&
-       (m_HFClast_it != m_HFClist.begin()))
-      {
-	// It can happen that a chunck of data comes
-	// with very 'old' timestamps. For first item of
-	// those chunks we need to dig through the list,
-	// but for the other the location in the list
-	// where this one was put might be a much better
-	// starting point.
-	cts++;
-	if((*m_HFClast_it)->geb.timestamp < hfc->geb.timestamp) {
-	  if((hfc->geb.timestamp-(*m_HFClast_it)->geb.timestamp) <
-	     ((*HFC_it)->geb.timestamp - hfc->geb.timestamp)) {
-	    // our iterator for last event is closer to current
-	    // event AND last iterator TS is < hfc.TS.
-	    // We need to go up in list.
-	    HFC_it=m_HFClast_it;
-	    while((*HFC_it)->geb.timestamp <
-		  hfc->geb.timestamp) {
-	      HFC_it++;
-	      cts++;
-	    }
-	    HFC_it--; // as we do HFC_it++ after loop.
-	    break;
-	  } else {
-	    // no luck this time, we need to iterate through
-	    // the hole thing (list)
-	  }
-	} else {
-	  if(((*m_HFClast_it)->geb.timestamp - hfc->geb.timestamp) <
-	     ((*HFC_it)->geb.timestamp - hfc->geb.timestamp)) {
-	    // again last event's iterator is closer and its
-	    // TS is larger. we can just move on with that one.
-	    HFC_it=m_HFClast_it;
-	  } else {
-	    // no luck.....
-	  }
-	}
-      }
-  } /* while */
-
-  HFC_it++;
-
-  if (((*HFC_it2)->geb.timestamp) > hfc->geb.timestamp) {
-    m_HFClist.push_front(hfc);
+BYTE* HFC_slab::alloc(int length) {
+  int k = sizeClass(length);
+
+  if(k >= NCLASS) {
+    // larger than any class, not recycled
+    return new BYTE [length];
+  }
+
+  if(!m_free[k].empty()) {
+    BYTE* b = m_free[k].back();
+    m_free[k].pop_back();
+    return b;
+  }
+
+  size_t block = (size_t) k * BLOCKSTEP;
+  if(m_pageLeft < block) {
+    m_pagePos = new BYTE [PAGESIZE];
+    m_pageLeft = PAGESIZE;
+    m_pages.push_back(m_pagePos);
+  }
+
+  BYTE* b = m_pagePos;
+  m_pagePos += block;
+  m_pageLeft -= block;
+  return b;
+}
+
+void HFC_slab::release(BYTE* block, int length) {
+  int k = sizeClass(length);
+  if(k >= NCLASS) {
+    delete [] block;
+    return;
+  }
+  m_free[k].push_back(block);
+}
+
+/****************************************************/
+
+// heap order: the 'later' item sinks, so the front of
+// m_heap is the oldest timestamp (first to arrive on ties)
+static bool HFC_later(const HFC_item& a, const HFC_item& b) {
+  if(a.geb.timestamp != b.geb.timestamp)
+    return a.geb.timestamp > b.geb.timestamp;
+  return a.seq > b.seq;
+}
+
+const HFC_item* HFC::oldest() {
+  if(m_heap.empty())
+    return m_run.empty() ? NULL : &m_run.front();
+  if(m_run.empty() || HFC_later(m_run.front(), m_heap.front()))
+    return &m_heap.front();
+  return &m_run.front();
+}
+
+bool HFC::insert(const HFC_item& hfc) {
+  // data usually comes nearly in order, so most items
+  // just extend the run
+  if(m_run.empty() ||
+     m_run.back().geb.timestamp <= hfc.geb.timestamp) {
+    m_run.push_back(hfc);
   } else {
-    m_HFClast_it=m_HFClist.insert(HFC_it, hfc);
+    m_heap.push_back(hfc);
+    push_heap(m_heap.begin(), m_heap.end(), HFC_later);
   }
 
-  // m_HFClast_it=m_HFClist.insert(HFC_it, hfc);
+  m_bytes += sizeof(HFC_item) + hfc.geb.length;
+  if(m_bytes > m_peakBytes)
+    m_peakBytes = m_bytes;
+  if(pending() > m_peakDepth)
+    m_peakDepth = pending();
 
   return true;
 }
 
+void HFC::writeOldest() {
+  const HFC_item* o = oldest();
+  HFC_item item = *o;
+
+  if(!m_heap.empty() && o == &m_heap.front()) {
+    pop_heap(m_heap.begin(), m_heap.end(), HFC_later);
+    m_heap.pop_back();
+  } else {
+    m_run.pop_front();
+  }
+
+  m_bytes -= sizeof(HFC_item) + item.geb.length;
+  m_written = true;
+  m_lastWrittenTS = item.geb.timestamp;
+
+  writeItem(&item);
+  // recycle our private copy of the data
+  m_slab.release(item.data, item.geb.length);
+}
+
 
 bool HFC::add(long long TS, int type, int length, BYTE* data) {
   gebData geb;
@@ -118,66 +204,99 @@ bool HFC::add(gebData aGeb, BYTE* data) {
   m_evt++;
 
   // first we make our 'private' copy
-  HFC_item* hfc;
-  hfc = (HFC_item*) new HFC_item;
-  hfc->geb = aGeb;
+  HFC_item hfc;
+  hfc.geb = aGeb;
+  hfc.seq = m_evt;
 
-  hfc->data = (BYTE*) new BYTE [hfc->geb.length * sizeof(BYTE)];
-  memcpy(hfc->data, data, hfc->geb.length * sizeof(BYTE));
+  if(m_adaptive)
+    return addAdaptive(hfc, data);
 
-  // now storing the pointer in HFC_list
+  // we hold at most m_memdepth-1 items
+  bool full = ((int) pending() >= m_memdepth - 1);
 
-  // You DON'T want to use
-  // (m_HFClist.size() >= m_memdepth)
-  // as it performs O(n)
+  if(full && pending() > 0 &&
+     oldest()->geb.timestamp > hfc.geb.timestamp) {
+    // too old, we don't even copy the data
+    m_discarded++;
+    return false;
+  }
 
-  // cout << hfc->geb.timestamp << endl;
+  hfc.data = m_slab.alloc(hfc.geb.length);
+  memcpy(hfc.data, data, hfc.geb.length * sizeof(BYTE));
 
-  if(m_evt >= m_memdepth) {
+  if(full)
     return addToFullList(hfc);
-  } else if(m_HFClist.empty()) {
-    m_HFClist.push_back(hfc);
-    return true;
-  } else {
-    return insert(hfc);
-  }
+  return insert(hfc);
 }
 
-bool HFC::addToFullList(HFC_item* hfc) {
-  list<HFC_item*>::iterator HFC_it = m_HFClist.begin();
+void HFC::noteLateness(long long late) {
+  if(late > m_periodLate)
+    m_periodLate = late;
 
-  if(((*HFC_it)->geb).timestamp > (hfc->geb).timestamp) {
-    m_discarded++;
+  // grow at once, so the next item this late fits
+  if(m_window >= 0 && 2*late > m_window) {
+    m_window = 2*late;
+    if(m_window > m_peakWindow)
+      m_peakWindow = m_window;
+  }
+}
 
-    // cout << "Start of list " << ((*HFC_it)->geb).timestamp;
-    // HFC_it = m_HFClist.end();
-    // cout << ", end of list " << ((*HFC_it)->geb).timestamp << endl;
-    // HFC_it = m_HFClist.begin();
-
-    if(0) {
-      cerr << "HFC::addToFullList has major problem"
-	   << endl
-	   << "current timestamp item "
-	   << dec << hfc->geb.timestamp << endl
-	   << "oldest timestamp in list "
-	   << (*HFC_it)->geb.timestamp << dec << endl
-	   << "discarding this item, you should increase memory depth"
-	   << endl << endl;
-      cin.get();
-    }
+bool HFC::addAdaptive(HFC_item hfc, BYTE* data) {
+  long long ts = hfc.geb.timestamp;
+
+  if(m_evt == 1 || ts > m_newestTS)
+    m_newestTS = ts;
+  else if(!m_fixedWindow)
+    noteLateness(m_newestTS - ts);
+
+  // once per period the window may shrink towards what the last
+  // period really needed -- but a shorter window only saves memory
+  // and loses any later item, so only while memory is getting tight
+  if(!m_fixedWindow && ++m_periodEvt >= HFC_ADAPTPERIOD) {
+    long long target = 2*m_periodLate;
+    if(target < m_minWindow)
+      target = m_minWindow;
+    if(m_window < 0 || target > m_window)
+      m_window = target;
+    else if(m_bytes > m_memCap/2)
+      m_window = (target > m_window/2) ? target : m_window/2;
+    if(m_window > m_peakWindow)
+      m_peakWindow = m_window;
+    m_periodLate = 0;
+    m_periodEvt = 0;
+  }
 
+  if(m_written && ts < m_lastWrittenTS) {
+    // younger items are out already
+    m_discarded++;
     return false;
   }
 
+  hfc.data = m_slab.alloc(hfc.geb.length);
+  memcpy(hfc.data, data, hfc.geb.length * sizeof(BYTE));
+  insert(hfc);
+
+  // beyond the fixed depth, write what is outside the window (all of
+  // it before the first period), and whatever it takes to stay below
+  // the memory cap; so nothing is dropped that the fixed depth kept
+  while(pending() > 0) {
+    if(m_bytes > m_memCap) {
+      m_capWrites++;
+    } else if((int) pending() < m_memdepth ||
+	      (m_window >= 0 &&
+	       oldest()->geb.timestamp >= m_newestTS - m_window)) {
+      break;
+    }
+    writeOldest();
+  }
 
+  return true;
+}
 
-  // okay, write 'oldest' event from list and get rid of it
-  writeItem(*HFC_it);
-  // destroy data in our private copy
-  delete (*HFC_it)->data;
-  delete (*HFC_it);
-  // and remove the pointer from list
-  HFC_it = m_HFClist.erase(HFC_it);
+bool HFC::addToFullList(const HFC_item& hfc) {
+  // okay, write 'oldest' event and get rid of it
+  if(pending() > 0)
+    writeOldest();
 
   // and now we add the new item
   insert(hfc);
@@ -185,36 +304,58 @@ bool HFC::addToFullList(HFC_item* hfc) {
   return true;
 }
 
+void HFC::setWriter(HFC_writer fn, void* arg) {
+  m_writer = fn;
+  m_writerArg = arg;
+}
+
 bool HFC::writeItem(HFC_item* hfc) {
-  if(m_file) {
+  if(m_writer) {
+    m_writer(&(hfc->geb), hfc->data, m_writerArg);
+  } else if(m_file) {
+    // no fflush here, the stream is flushed when it is closed
     fwrite(&(hfc->geb), sizeof(gebData), 1, m_file);
     fwrite(hfc->data, sizeof(BYTE), hfc->geb.length, m_file);
-    fflush(stdout);
   }
 
   return true;
 }
 
 void HFC::flush() {
-  list<HFC_item*>::iterator HFC_it = m_HFClist.begin();
-
-  while(HFC_it != m_HFClist.end()) {
-    writeItem(*HFC_it);
-    delete (*HFC_it)->data;
-    delete *HFC_it;
-    HFC_it = m_HFClist.erase(HFC_it);
-  }
+  while(pending() > 0)
+    writeOldest();
 }
 
 void HFC::printstatus() {
   cerr << "\t\tStatus of HFC object:"
+       << endl;
+  if(m_fixedWindow)
+    cerr << "\t\tLook-back: " << m_window << " TS units, memory cap: "
+	 << m_memCap/(1024*1024) << " MB"
+	 << endl;
+  else if(m_adaptive)
+    cerr << "\t\tAdaptive memory, cap: " << m_memCap/(1024*1024) << " MB"
+	 << endl
+	 << "\t\tTime window (final/peak): "
+	 << ((m_window < 0) ? m_peakWindow : m_window)
+	 << " / " << m_peakWindow
+	 << endl;
+  else
+    cerr << "\t\tEvent memory depth: " << m_memdepth
+	 << endl;
+  cerr << "\t\tEvents processed:   " << m_evt
        << endl
-       << "\t\tEvent memory depth: " << m_memdepth
-       << endl
-       << "\t\tEvents processed:   " << m_evt
+       << "\t\tPeak depth:         " << m_peakDepth
+       << " events, " << m_peakBytes/1024 << " kB"
        << endl;
+  if(m_adaptive && m_capWrites)
+    cerr << "\t\tWritten at the cap: " << m_capWrites
+	 << endl;
   if(m_discarded)
     cerr << "\t\tEvents discarded:   " << m_discarded
-    	 << "  (increase mem depth!)"
+    	 << (!m_adaptive ? "  (increase mem depth!)"
+	     : m_capWrites ? "  (memory cap reached, raise -mem / -hfcMem!)"
+	     : m_fixedWindow ? "  (later than the look-back)"
+	     : "  (later than the depth and the time window)")
     	 << endl;
 }
@@ -2,7 +2,8 @@
 #define __HFC_H
 
 #include <iostream>
-#include <list>
+#include <vector>
+#include <deque>
 #include "global.h"
 
 using namespace std;
@@ -21,6 +22,15 @@ using namespace std;
 // number of events in memory for performing re-ordering.
 // If memory is too small, events which do not fit will
 // be dicarded.
+//
+// Pending items are ordered on (timestamp, arrival order);
+// items with equal timestamps leave in the order they came in.
+// An item that is not older than the newest pending one is
+// appended to an in-order run (O(1)); anything else goes into
+// a binary min-heap (O(log n)), however far out of order it is.
+// The oldest item is the older of the run front and heap top.
+// Payload copies live in an HFC_slab and are recycled
+// once the item has been written.
 //  
 // User methods:
 //
@@ -51,6 +61,32 @@ using namespace std;
 // void printstatus();
 // prints statistics 
 //
+// void setWriter(HFC_writer fn, void* arg);
+// instead of writing to a file, time-ordered items are
+// handed to fn (header, payload, arg). Used to run HFC
+// in-process, see HFCStream.h
+//
+// void setAdaptive(size_t memCap, long long minWindow);
+// lets the memory depth grow past the fixed one when the data
+// needs it. Beyond the fixed depth, items are held until they
+// are older than the newest TS seen minus a time window; the
+// window follows the observed disorder (twice the largest
+// lateness seen, growing at once), but never below minWindow.
+// It shrinks towards what the last 65536 items needed only
+// while the pending payload is above half of memCap, and until
+// the first 65536 items have been seen it is not used, so
+// nothing is held for less than the fixed depth would hold it.
+// The pending payload is kept below memCap bytes, whatever the
+// window says. An item is discarded only if it is older than
+// what has already been written.
+//
+// void setLookBack(long long lookBack, size_t memCap);
+// like setAdaptive, but with a fixed time window and no fixed
+// depth: an item is written as soon as it is more than lookBack
+// TS units older than the newest TS seen (or memCap is reached).
+// Anything later than that is discarded. This is the bounded
+// look-back of unpackGRETINA -ebLookBack.
+//
 
 struct gebData
 {
@@ -64,8 +100,37 @@ struct HFC_item
 {
   gebData geb;
   BYTE*  data;
+  unsigned long long seq; // arrival order, breaks timestamp ties
+};
+
+// Payload storage for HFC. Blocks come in size classes of
+// 64 byte steps carved out of large pages; a freed block goes
+// on the free list of its class and is handed out again, so
+// steady state running does no malloc/free per item.
+class HFC_slab
+{
+ private:
+  static const int BLOCKSTEP = 64;
+  static const int NCLASS = 2049; // up to 128 kB payloads
+  static const int PAGESIZE = 1 << 20;
+
+  vector<BYTE*> m_free[NCLASS];
+  vector<BYTE*> m_pages;
+  BYTE* m_pagePos;
+  size_t m_pageLeft;
+
+  int sizeClass(int length);
+
+ public:
+  HFC_slab();
+  ~HFC_slab();
+
+  BYTE* alloc(int length);
+  void release(BYTE* block, int length);
 };
 
+typedef void (*HFC_writer)(const gebData* geb, const BYTE* data, void* arg);
+
 
 
 class HFC
@@ -73,25 +138,61 @@ class HFC
  private:
   int m_memdepth;
   FILE *m_file;
-  int m_evt;
+  HFC_writer m_writer;
+  void* m_writerArg;
+  unsigned long long m_evt; // items added, gives HFC_item::seq
 
-  list<HFC_item*> m_HFClist;
-  list<HFC_item*>::iterator m_HFClast_it;
+  // in-order run, and min-heap (oldest at m_heap.front())
+  // for everything that arrived out of order
+  deque<HFC_item> m_run;
+  vector<HFC_item> m_heap;
+  HFC_slab m_slab;
 
   int m_discarded;
+
+  // adaptive depth, see setAdaptive(); a fixed window
+  // is the look-back of setLookBack()
+  bool m_adaptive;
+  bool m_fixedWindow;
+  size_t m_memCap;
+  long long m_minWindow;
+  long long m_window;
+  long long m_newestTS;
+  long long m_periodLate; // largest lateness this period
+  int m_periodEvt;
+  long long m_capWrites;  // items written early to stay below the cap
+
+  // what left last, to tell which items are too old
+  bool m_written;
+  long long m_lastWrittenTS;
+
+  // bookkeeping for printstatus()
+  size_t m_bytes;
+  size_t m_peakBytes;
+  size_t m_peakDepth;
+  long long m_peakWindow;
     
   void init(int num, FILE* out);
 
-  // we won't expand list, but discard one
+  bool addAdaptive(HFC_item hfc, BYTE* data);
+  void noteLateness(long long late);
+
+  size_t pending() { return m_run.size() + m_heap.size(); }
+  const HFC_item* oldest();
+
+  // we won't expand the buffer, but discard one
   // item by writing it.
-  bool addToFullList(HFC_item* hfc);
+  bool addToFullList(const HFC_item& hfc);
   
   // Well, this actually does the writing
   bool writeItem(HFC_item* hfc);
 
-  // An item gets inserted at 'right' 
-  // position in list, list gets expanded
-  bool insert(HFC_item* hfc);
+  // An item gets inserted at 'right'
+  // position in the run or heap
+  bool insert(const HFC_item& hfc);
+
+  // write the oldest item and drop it
+  void writeOldest();
 
  public:
   HFC();
@@ -99,13 +200,26 @@ class HFC
   HFC(FILE* out);
   HFC(int num, FILE* out);
 
-  // 'user' method for adding event to list
+  // 'user' method for adding event to HFC
   // data will be copied, so user can free/
   // change data block she/he is pointing to.
   bool add(gebData aGeb, BYTE* data);
   bool add(long long TS, int type, int length, BYTE* data);
 
-  // 'user' method for writing all list items
+  // hand ordered items to a function instead of a file
+  void setWriter(HFC_writer fn, void* arg);
+
+  // size the window from the observed disorder,
+  // within memCap bytes of pending items
+  void setAdaptive(size_t memCap, long long minWindow);
+
+  // hold items for a fixed time window only
+  void setLookBack(long long lookBack, size_t memCap);
+
+  int discarded() { return m_discarded; }
+  size_t peakDepth() { return m_peakDepth; }
+
+  // 'user' method for writing all items
   // stored in memory
   void flush();
 
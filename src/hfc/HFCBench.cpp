@@ -0,0 +1,306 @@
+//
+// HFC_bench: compares the HFC reorder buffer (min-heap + slab)
+// with the std::list based HFC it replaced, on synthetic streams.
+//
+// make bench (in src/hfc), then
+// ../../HFC_bench [items] [payload bytes]
+//
+// Streams:
+//   in-order      timestamps strictly increasing
+//   mild shuffle  every item displaced by up to ~100 positions
+//   late blocks   blocks of 2000 items arrive ~50000 positions late
+//   bad shuffle   every item displaced by up to ~20000 positions
+//   late burst    in order, but 200 items 200000 ticks late
+//
+// For each, ns/item for add()+flush() and the number of items
+// discarded as 'too old' are printed for the list, the heap with
+// the fixed depth and the heap with the adaptive depth (as
+// GEB_HFC and unpackGRETINA run it); the output of all is checked
+// to be in time order. HFC_bench exits with 1 if any output is out
+// of order, or if the adaptive depth drops an item the fixed depth
+// kept -- make check runs it on 300000 items.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <iostream>
+#include <list>
+#include <vector>
+#include <algorithm>
+
+#include "global.h"
+#include "HFC.h"
+#include "HFCStream.h"
+
+using namespace std;
+
+// The pre-heap HFC, kept here only as the reference for the
+// benchmark: sorted std::list, new+memcpy per item, backward
+// insertion walk with the HFCITEMISDEEP shortcut.
+class HFCList
+{
+ private:
+  int m_memdepth;
+  int m_evt;
+  int m_discarded;
+  HFC_writer m_writer;
+  void* m_writerArg;
+
+  list<HFC_item*> m_HFClist;
+  list<HFC_item*>::iterator m_HFClast_it;
+
+  bool insert(HFC_item* hfc);
+
+  void writeItem(HFC_item* hfc) {
+    m_writer(&(hfc->geb), hfc->data, m_writerArg);
+  }
+
+ public:
+  HFCList(int num, HFC_writer fn, void* arg) {
+    m_memdepth = num; m_evt = 0; m_discarded = 0;
+    m_writer = fn; m_writerArg = arg;
+  }
+
+  int discarded() { return m_discarded; }
+
+  bool add(gebData aGeb, BYTE* data) {
+    m_evt++;
+    HFC_item* hfc = new HFC_item;
+    hfc->geb = aGeb;
+    hfc->data = new BYTE [hfc->geb.length];
+    memcpy(hfc->data, data, hfc->geb.length);
+
+    if(m_evt >= m_memdepth) {
+      list<HFC_item*>::iterator HFC_it = m_HFClist.begin();
+      if((*HFC_it)->geb.timestamp > hfc->geb.timestamp) {
+	m_discarded++;
+	delete [] hfc->data;
+	delete hfc;
+	return false;
+      }
+      writeItem(*HFC_it);
+      delete [] (*HFC_it)->data;
+      delete (*HFC_it);
+      m_HFClist.erase(HFC_it);
+      insert(hfc);
+      return true;
+    } else if(m_HFClist.empty()) {
+      m_HFClist.push_back(hfc);
+      m_HFClast_it = m_HFClist.begin();
+      return true;
+    } else {
+      return insert(hfc);
+    }
+  }
+
+  void flush() {
+    list<HFC_item*>::iterator HFC_it = m_HFClist.begin();
+    while(HFC_it != m_HFClist.end()) {
+      writeItem(*HFC_it);
+      delete [] (*HFC_it)->data;
+      delete *HFC_it;
+      HFC_it = m_HFClist.erase(HFC_it);
+    }
+  }
+};
+
+bool HFCList::insert(HFC_item* hfc) {
+#define HFCITEMISDEEP 100
+  int cts=0;
+
+  list<HFC_item*>::iterator HFC_it = m_HFClist.end();
+  list<HFC_item*>::iterator HFC_it2 = m_HFClist.begin();
+
+  HFC_it--;
+
+  while(HFC_it != m_HFClist.begin() &&
+	(*HFC_it)->geb.timestamp >=
+	hfc->geb.timestamp ) {
+    HFC_it--;
+    cts++;
+    if((cts == HFCITEMISDEEP) &&
+       (m_HFClast_it != m_HFClist.begin()))
+      {
+	// It can happen that a chunck of data comes
+	// with very 'old' timestamps. For first item of
+	// those chunks we need to dig through the list,
+	// but for the other the location in the list
+	// where this one was put might be a much better
+	// starting point.
+	cts++;
+	if((*m_HFClast_it)->geb.timestamp < hfc->geb.timestamp) {
+	  if((hfc->geb.timestamp-(*m_HFClast_it)->geb.timestamp) <
+	     ((*HFC_it)->geb.timestamp - hfc->geb.timestamp)) {
+	    // our iterator for last event is closer to current
+	    // event AND last iterator TS is < hfc.TS.
+	    // We need to go up in list.
+	    HFC_it=m_HFClast_it;
+	    while((*HFC_it)->geb.timestamp <
+		  hfc->geb.timestamp) {
+	      HFC_it++;
+	      cts++;
+	    }
+	    HFC_it--; // as we do HFC_it++ after loop.
+	    break;
+	  } else {
+	    // no luck this time, we need to iterate through
+	    // the hole thing (list)
+	  }
+	} else {
+	  if(((*m_HFClast_it)->geb.timestamp - hfc->geb.timestamp) <
+	     ((*HFC_it)->geb.timestamp - hfc->geb.timestamp)) {
+	    // again last event's iterator is closer and its
+	    // TS is larger. we can just move on with that one.
+	    HFC_it=m_HFClast_it;
+	  } else {
+	    // no luck.....
+	  }
+	}
+      }
+  } /* while */
+
+  HFC_it++;
+
+  if (((*HFC_it2)->geb.timestamp) > hfc->geb.timestamp) {
+    m_HFClist.push_front(hfc);
+  } else {
+    m_HFClast_it=m_HFClist.insert(HFC_it, hfc);
+  }
+
+  // m_HFClast_it=m_HFClist.insert(HFC_it, hfc);
+
+  return true;
+}
+
+/****************************************************/
+
+struct benchSink
+{
+  long long lastTS;
+  long long nItems;
+  long long nBytes;
+  long long nOutOfOrder;
+};
+
+static void benchCollect(const gebData* geb, const BYTE* /* data */, void* arg) {
+  benchSink* s = (benchSink*) arg;
+  if(geb->timestamp < s->lastTS)
+    s->nOutOfOrder++;
+  s->lastTS = geb->timestamp;
+  s->nItems++;
+  s->nBytes += geb->length;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+// timestamps for 'n' items; the item at position i nominally has TS 10*i
+static void makeStream(vector<long long>& ts, int n, int mode) {
+  ts.resize(n);
+  for(int i=0; i<n; i++)
+    ts[i] = 1000 + 10LL*i;
+
+  srand(12345);
+  if(mode == 1) {
+    // mild: swap with a neighbour up to 100 positions away
+    for(int i=0; i<n; i++) {
+      int j = i + rand()%100;
+      if(j < n) swap(ts[i], ts[j]);
+    }
+  } else if(mode == 2) {
+    // blocks of 2000 items show up 50000 items late
+    for(int b=0; b+52000 < n; b+=100000)
+      rotate(ts.begin()+b, ts.begin()+b+2000, ts.begin()+b+52000);
+  } else if(mode == 3) {
+    // bad: swap with any item up to 20000 positions away
+    for(int i=0; i<n; i++) {
+      int j = i + (int) (((long long) rand() * 20000) / RAND_MAX);
+      if(j < n) swap(ts[i], ts[j]);
+    }
+  } else if(mode == 4) {
+    // a burst of 200 items 200000 ticks late in calm data,
+    // after the adaptive window has seen a calm period
+    for(int i=n/2; i<n/2+200 && i<n; i++)
+      ts[i] -= 200000;
+  }
+}
+
+template <class T>
+static void runOne(T& buf, vector<long long>& ts, BYTE* payload, int len,
+		   double& sec) {
+  gebData geb;
+  geb.type = 1;
+  geb.length = len;
+
+  double t0 = now();
+  for(size_t i=0; i<ts.size(); i++) {
+    geb.timestamp = ts[i];
+    buf.add(geb, payload);
+  }
+  buf.flush();
+  sec = now() - t0;
+}
+
+int main(int argc, char** argv) {
+  int n = (argc > 1) ? atoi(argv[1]) : 2000000;
+  int len = (argc > 2) ? atoi(argv[2]) : 344;  // ~ one mode2 payload
+
+  const char* names[5] = {"in-order", "mild shuffle", "late blocks",
+			  "bad shuffle", "late burst"};
+  vector<BYTE> payload(len > 0 ? len : 1, 0);
+  vector<long long> ts;
+
+  printf("HFC_bench: %d items, %d byte payloads, depth %d\n",
+	 n, len, HFC_GEBDEPTH);
+  printf("%-14s %-6s %12s %12s %12s\n",
+	 "stream", "buffer", "ns/item", "discarded", "misordered");
+
+  int failed = 0;
+  for(int mode=0; mode<5; mode++) {
+    if(mode == 3 && getenv("HFC_BENCH_NOBAD"))
+      continue;
+    makeStream(ts, n, mode);
+
+    double sec;
+    benchSink sL = {0, 0, 0, 0};
+    {
+      HFCList l(HFC_GEBDEPTH, benchCollect, &sL);
+      runOne(l, ts, &payload[0], len, sec);
+      printf("%-14s %-6s %12.1f %12d %12lld\n", names[mode], "list",
+	     1e9*sec/n, l.discarded(), sL.nOutOfOrder);
+      fflush(stdout);
+    }
+
+    benchSink sH = {0, 0, 0, 0};
+    {
+      HFC h(HFC_GEBDEPTH);
+      h.setWriter(benchCollect, &sH);
+      runOne(h, ts, &payload[0], len, sec);
+      printf("%-14s %-6s %12.1f %12lld %12lld\n", names[mode], "heap",
+	     1e9*sec/n, (long long) n - sH.nItems, sH.nOutOfOrder);
+    }
+
+    benchSink sA = {0, 0, 0, 0};
+    {
+      HFC h(HFC_GEBDEPTH);
+      h.setWriter(benchCollect, &sA);
+      h.setAdaptive((size_t) HFC_MEMCAP_MB*1024*1024, HFC_MINWINDOW);
+      runOne(h, ts, &payload[0], len, sec);
+      printf("%-14s %-6s %12.1f %12lld %12lld\n", names[mode], "adapt",
+	     1e9*sec/n, (long long) n - sA.nItems, sA.nOutOfOrder);
+    }
+
+    if(sH.nOutOfOrder || sA.nOutOfOrder || sA.nItems < sH.nItems) {
+      printf("%-14s FAILED\n", names[mode]);
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
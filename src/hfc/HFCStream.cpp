@@ -0,0 +1,234 @@
+#include "HFCStream.h"
+#include "stdio.h"
+#include "string.h"
+#include <limits.h>
+
+#define HFCSTREAM_BUFSIZE (8*16382)
+
+int HFC_mode3(BYTE* cBuf, HFC* hfc_list) {
+  /* Return value: processed data in bytes */
+
+  long long mode3_ts;
+  int mode3_len;
+
+  // 15th and 16th byte is ts high (and endian)
+  mode3_ts = ((long long) cBuf[14]) << 40;
+  mode3_ts += ((long long) cBuf[15]) << 32;
+  // 9th, 10th ts middle
+  mode3_ts += ((long long) cBuf[8]) << 24;
+  mode3_ts += ((long long) cBuf[9]) << 16;
+  // 11th, 12th ts 'low'
+  mode3_ts += ((long long) cBuf[10]) << 8;
+  mode3_ts += ((long long) cBuf[11]);
+
+  // 5th, 6th is length, in 32bit units
+  mode3_len = ((int)(cBuf[4])) << 8;
+  mode3_len += ((int)cBuf[5]);
+  mode3_len &= 0x7ff;
+  mode3_len *= 4; // convert into bytes
+
+  hfc_list->add(mode3_ts, 2, mode3_len+4, cBuf);
+
+  return (mode3_len + 4); // 0xaaaa 0xaaaa not counted in mode3_len
+}
+
+int HFC_addGEB(gebData aGeb, BYTE* cBuf, HFC* hfc) {
+  switch(aGeb.type) {
+  case 2: // Mode 3 (raw)
+    {
+      // several digitizer channels in one payload,
+      // every channel becomes its own item
+      int nBytes = aGeb.length;
+      BYTE *data = cBuf;
+      while(nBytes > 0) {
+	int nread = HFC_mode3(data, hfc);
+	data += nread;
+	nBytes -= nread;
+      }
+      if(nBytes < 0)
+	return HFC_ADD_BADMODE3;
+    }
+    return HFC_ADD_OK;
+
+  case 4: // BGS
+    return HFC_ADD_SKIPPED;
+
+  case 1:    // Mode 2, so far always GEB, 1 event, GEB, 1 event,....
+  case 3:    // Mode 1
+  case 5:    // S800 event
+  case 6:    // S800 scaler etc.
+  case 7:    // GRETINA scaler data
+  case 8:    // card 29
+  case 9:    // S800 physics event
+  case 10:   // S800 timestamped non-event (i.e. scaler) data
+  case 11:   // Simulated GRETINA data
+  case 0x2B: // Contrived clover for coincidence
+  case 12:   // CHICO
+  case 16:   // DFMA
+  case 17:   // PHOSWALL
+  case 18:   // PHOSWALLAUX
+  case 19:   // GODDESS
+  case 21:   // LENDA
+    if(!hfc->add(aGeb, cBuf))
+      return HFC_ADD_TOOOLD;
+    return HFC_ADD_OK;
+
+  default:
+    return HFC_ADD_UNKNOWN;
+  }
+}
+
+/****************************************************/
+
+HFCStream::HFCStream(FILE* in, bool inIsPipe, int num, int memCapMB,
+		     long long lookBack) : m_hfc(num) {
+  m_in = in;
+  m_inIsPipe = inIsPipe;
+  m_eof = false;
+  m_outPos = 0;
+  m_failReported = false;
+
+  m_lookBack = (lookBack > 0) ? lookBack : 0;
+  m_newestTS = LLONG_MIN;
+  memset(m_type, 0, sizeof(m_type));
+
+  m_buf = new BYTE[HFCSTREAM_BUFSIZE];
+  m_out.reserve(2*HFCSTREAM_BUFSIZE);
+
+  m_hfc.setWriter(&HFCStream::collect, this);
+  if(m_lookBack > 0)
+    m_hfc.setLookBack(m_lookBack, (size_t) ((memCapMB > 0) ? memCapMB : HFC_MEMCAP_MB)*1024*1024);
+  else if(memCapMB > 0)
+    m_hfc.setAdaptive((size_t) memCapMB*1024*1024, HFC_MINWINDOW);
+}
+
+HFCStream::~HFCStream() {
+  if(m_in) {
+    if(m_inIsPipe)
+      pclose(m_in);
+    else
+      fclose(m_in);
+  }
+  delete [] m_buf;
+}
+
+FILE* HFCStream::open() {
+  cookie_io_functions_t io;
+  io.read = &HFCStream::cookieRead;
+  io.write = NULL;
+  io.seek = NULL;
+  io.close = &HFCStream::cookieClose;
+
+  return fopencookie(this, "r", io);
+}
+
+void HFCStream::collect(const gebData* geb, const BYTE* data, void* arg) {
+  HFCStream* s = (HFCStream*) arg;
+
+  s->m_out.insert(s->m_out.end(), (const BYTE*) geb,
+		  (const BYTE*) geb + sizeof(gebData));
+  s->m_out.insert(s->m_out.end(), data, data + geb->length);
+}
+
+bool HFCStream::readOne() {
+  gebData aGeb;
+
+  if(fread(&aGeb, sizeof(gebData), 1, m_in) != 1)
+    return false;
+
+  if(aGeb.length < 0 || aGeb.length > HFCSTREAM_BUFSIZE) {
+    cerr << "HFCStream: GEB payload of " << aGeb.length
+	 << " bytes does not fit the read buffer. Bailing out" << endl;
+    return false;
+  }
+
+  int read = fread(m_buf, sizeof(BYTE), aGeb.length, m_in);
+  if(read != aGeb.length) {
+    cerr << "HFCStream: " << aGeb.length << " bytes expected but "
+	 << read << " bytes read. Bailing out" << endl;
+    return false;
+  }
+
+  int st = HFC_addGEB(aGeb, m_buf, &m_hfc);
+  if(m_lookBack > 0)
+    noteType(aGeb, st);
+  if(st == HFC_ADD_TOOOLD && !m_failReported) {
+    m_failReported = true;
+    cerr << "HFCStream: adding event in HFC failed" << endl;
+  } else if(st == HFC_ADD_BADMODE3) {
+    cerr << "HFCStream: nBytes negative!!" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+void HFCStream::noteType(const gebData& aGeb, int st) {
+  int t = aGeb.type;
+  if(t < 0 || t >= HFCSTREAM_NTYPES)
+    t = HFCSTREAM_NTYPES - 1;
+  HFCStream_typeStats& s = m_type[t];
+  s.n++;
+  if(st == HFC_ADD_TOOOLD)
+    s.missed++;
+
+  // no valid timestamp (skipped by the sort anyway): no lateness
+  if(aGeb.timestamp <= 0)
+    return;
+  if(aGeb.timestamp >= m_newestTS) {
+    m_newestTS = aGeb.timestamp;
+    return;
+  }
+  long long late = m_newestTS - aGeb.timestamp;
+  s.late++;
+  s.sumLate += late;
+  if(late > s.maxLate)
+    s.maxLate = late;
+}
+
+void HFCStream::printTypes() {
+  cerr << "\t\t  type    headers       late     missed   mean late    max late"
+       << endl;
+  for(int t=0; t<HFCSTREAM_NTYPES; t++) {
+    const HFCStream_typeStats& s = m_type[t];
+    if(s.n == 0)
+      continue;
+    char line[128];
+    snprintf(line, sizeof(line), "\t\t  %4d %10lld %10lld %10lld %11.1f %11lld",
+	     t, s.n, s.late, s.missed,
+	     s.late ? (double) s.sumLate / s.late : 0., s.maxLate);
+    cerr << line << endl;
+  }
+}
+
+ssize_t HFCStream::cookieRead(void* cookie, char* buf, size_t size) {
+  HFCStream* s = (HFCStream*) cookie;
+
+  // refill until the reader can be served or the input is done
+  while(s->m_out.size() - s->m_outPos < size && !s->m_eof) {
+    if(s->m_outPos > 0) {
+      s->m_out.erase(s->m_out.begin(), s->m_out.begin() + s->m_outPos);
+      s->m_outPos = 0;
+    }
+    if(!s->readOne()) {
+      s->m_eof = true;
+      s->m_hfc.flush();
+      s->m_hfc.printstatus();
+      if(s->m_lookBack > 0)
+	s->printTypes();
+    }
+  }
+
+  size_t n = s->m_out.size() - s->m_outPos;
+  if(n > size)
+    n = size;
+  memcpy(buf, &s->m_out[s->m_outPos], n);
+  s->m_outPos += n;
+
+  return n;
+}
+
+int HFCStream::cookieClose(void* cookie) {
+  delete (HFCStream*) cookie;
+  return 0;
+}
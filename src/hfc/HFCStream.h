@@ -0,0 +1,112 @@
+#ifndef __HFCSTREAM_H
+#define __HFCSTREAM_H
+
+#include <stdio.h>
+#include <vector>
+#include "global.h"
+#include "HFC.h"
+
+//
+// HFCStream runs the HFC time ordering inside the process
+// that consumes the data, instead of piping everything through
+// a separate "GEB_HFC -p" process.
+//
+// The unordered GEB stream is read from 'in', fed into an HFC
+// object, and the time-ordered items HFC writes out are
+// collected in a memory buffer. open() returns a read-only
+// FILE* on top of that buffer (glibc fopencookie), so readers
+// using fread() on GEB headers and payloads work unchanged.
+// Input is only pulled when the reader asks for more bytes.
+//
+// User methods:
+//
+// HFCStream(FILE* in, bool inIsPipe, int num, int memCapMB, long long lookBack)
+// in is the raw GEB input (fopen'ed file, GEBZip_open'ed compressed
+// file, or a popen'ed command when inIsPipe), num is the HFC memory depth. With memCapMB > 0
+// HFC sizes its window from the observed disorder instead,
+// holding at most memCapMB MB (see HFC::setAdaptive). With
+// lookBack > 0 items are only held for that many TS units
+// (HFC::setLookBack), and per GEB type the stream counts the
+// headers that came after a newer one, how late they were and
+// how many were too late; printed with the HFC status
+//
+// FILE* open();
+// returns the ordered stream. fclose() on it closes 'in' and
+// destroys the HFCStream object.
+//
+// int HFC_addGEB(gebData aGeb, BYTE* cBuf, HFC* hfc);
+// the per-type dispatch shared with GEB_HFC: splits Mode 3
+// payloads into single channels and adds everything HFC
+// knows about. Returns one of the HFC_ADD_* codes.
+//
+
+// memory depth used for GEB files, both by GEB_HFC and in-process
+// 972: strange mode 2 with mem depth 40*8192 needed
+#define HFC_GEBDEPTH (50*8192)
+
+// adaptive depth: default memory cap, and the smallest time
+// window (TS units, 10 ns) held even for perfectly ordered data
+#define HFC_MEMCAP_MB 1024
+#define HFC_MINWINDOW 1000
+
+#define HFC_ADD_OK       0
+#define HFC_ADD_TOOOLD   1  // at least one item was too old and dropped
+#define HFC_ADD_SKIPPED  2  // type is deliberately not passed on (BGS)
+#define HFC_ADD_UNKNOWN  3  // unknown GEB type, not passed on
+#define HFC_ADD_BADMODE3 -1 // inconsistent Mode 3 payload
+
+// per-type lateness statistics; larger types share the last slot
+#define HFCSTREAM_NTYPES 64
+
+struct HFCStream_typeStats
+{
+  long long n;
+  long long late;     // arrived after a newer timestamp
+  long long missed;   // later than the look-back, dropped
+  long long sumLate;  // TS units, for the mean
+  long long maxLate;
+};
+
+int HFC_mode3(BYTE* cBuf, HFC* hfc_list);
+int HFC_addGEB(gebData aGeb, BYTE* cBuf, HFC* hfc);
+
+class HFCStream
+{
+ private:
+  FILE* m_in;
+  bool m_inIsPipe;
+  bool m_eof;
+
+  HFC m_hfc;
+  BYTE* m_buf;
+
+  // ordered output, m_outPos is the read position
+  std::vector<BYTE> m_out;
+  size_t m_outPos;
+
+  bool m_failReported;
+
+  long long m_lookBack;
+  long long m_newestTS;
+  HFCStream_typeStats m_type[HFCSTREAM_NTYPES];
+
+  void noteType(const gebData& aGeb, int st);
+  void printTypes();
+
+  // pulls one GEB item from the input into HFC;
+  // false at end of input
+  bool readOne();
+
+  static void collect(const gebData* geb, const BYTE* data, void* arg);
+  static ssize_t cookieRead(void* cookie, char* buf, size_t size);
+  static int cookieClose(void* cookie);
+
+ public:
+  HFCStream(FILE* in, bool inIsPipe, int num, int memCapMB = 0,
+	    long long lookBack = 0);
+  ~HFCStream();
+
+  FILE* open();
+};
+
+#endif